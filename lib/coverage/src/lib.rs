@@ -1,14 +1,18 @@
 extern crate lazy_static;
 use lazy_static::lazy_static;
 
-use std::collections::HashSet;
+use std::collections::{HashMap, HashSet};
 use std::ffi::{CStr, CString};
-use std::fs::{File, OpenOptions};
-use std::io::Write;
+use std::fmt::Write as FmtWrite;
+use std::fs::{self, OpenOptions};
+use std::io::{self, Write};
 use std::os::raw::{c_char, c_int};
+use std::process;
+use std::ptr;
+use std::sync::atomic::{AtomicBool, AtomicPtr, AtomicU64, AtomicUsize, Ordering};
 use std::sync::Mutex;
 
-#[derive(Eq, PartialEq, Hash)]
+#[derive(Clone, Eq, PartialEq, Hash)]
 struct Span {
     sail_file: CString,
     line1: i32,
@@ -24,6 +28,198 @@ lazy_static! {
     static ref OUTPUT_FILE: Mutex<String> = Mutex::new("sail_coverage".to_string());
 }
 
+/// A source location in the static tables emitted by the Sail C
+/// backend, matching `struct sail_coverage_span` in sail_coverage.h.
+#[repr(C)]
+pub struct CSpan {
+    sail_file: *const c_char,
+    l1: c_int,
+    c1: c_int,
+    l2: c_int,
+    c2: c_int,
+}
+
+/// One of the static span tables, together with a record of which of
+/// its entries have been hit. Normally this is a bitmap, but when
+/// counting hits it is instead a 64-bit counter per entry. Updating
+/// these is the only thing that happens on the hot path, the spans
+/// themselves are only looked at when we write the coverage file.
+struct Table {
+    spans: AtomicPtr<CSpan>,
+    words: AtomicPtr<AtomicU64>,
+    len: AtomicUsize,
+    counting: AtomicBool,
+}
+
+impl Table {
+    const fn new() -> Self {
+        Table {
+            spans: AtomicPtr::new(ptr::null_mut()),
+            words: AtomicPtr::new(ptr::null_mut()),
+            len: AtomicUsize::new(0),
+            counting: AtomicBool::new(false),
+        }
+    }
+
+    fn init(&self, spans: *const CSpan, len: c_int, counting: bool) {
+        if spans.is_null() || len <= 0 || self.len.load(Ordering::Acquire) != 0 {
+            return;
+        }
+        let len = len as usize;
+        let words = if counting { len } else { (len + 63) / 64 };
+        let words: Box<[AtomicU64]> = (0..words).map(|_| AtomicU64::new(0)).collect();
+        self.spans.store(spans as *mut CSpan, Ordering::Relaxed);
+        self.words
+            .store(Box::into_raw(words) as *mut AtomicU64, Ordering::Relaxed);
+        self.counting.store(counting, Ordering::Relaxed);
+        // Publish the length last, so anyone who sees it also sees the tables
+        self.len.store(len, Ordering::Release);
+    }
+
+    #[inline]
+    fn word(&self, i: usize) -> &AtomicU64 {
+        unsafe { &*self.words.load(Ordering::Relaxed).add(i) }
+    }
+
+    #[inline]
+    fn set(&self, id: c_int) {
+        let id = id as usize;
+        let len = self.len.load(Ordering::Acquire);
+        if id < len {
+            if self.counting.load(Ordering::Relaxed) {
+                // Models are single threaded, so a separate load and
+                // store avoids the cost of an atomic increment
+                let counter = self.word(id);
+                counter.store(
+                    counter.load(Ordering::Relaxed).wrapping_add(1),
+                    Ordering::Relaxed,
+                );
+                return;
+            }
+            let word = self.word(id / 64);
+            let mask = 1 << (id % 64);
+            // Most locations are hit many times, so avoid the read-modify-write once the bit is set
+            if word.load(Ordering::Relaxed) & mask == 0 {
+                word.fetch_or(mask, Ordering::Relaxed);
+            }
+        } else if len == 0 {
+            UNREGISTERED.store(true, Ordering::Relaxed);
+        }
+    }
+
+    fn hits(&self, id: usize) -> u64 {
+        if self.counting.load(Ordering::Relaxed) {
+            self.word(id).load(Ordering::Relaxed)
+        } else {
+            (self.word(id / 64).load(Ordering::Relaxed) >> (id % 64)) & 1
+        }
+    }
+
+    fn words_len(&self) -> usize {
+        let len = self.len.load(Ordering::Acquire);
+        if self.counting.load(Ordering::Relaxed) {
+            len
+        } else {
+            (len + 63) / 64
+        }
+    }
+
+    /// Hash the span table, so tools reading binary coverage files can
+    /// check they were produced by the model they are looking at.
+    fn hash(&self, hash: &mut u64) {
+        let len = self.len.load(Ordering::Acquire);
+        fnv1a(hash, &(len as u64).to_le_bytes());
+        for id in 0..len {
+            let span = unsafe { &*self.spans.load(Ordering::Relaxed).add(id) };
+            fnv1a(hash, unsafe { CStr::from_ptr(span.sail_file) }.to_bytes());
+            fnv1a(hash, &[0]);
+            for n in [span.l1, span.c1, span.l2, span.c2].iter() {
+                fnv1a(hash, &(*n as i32).to_le_bytes());
+            }
+        }
+    }
+
+    fn write_binary(&self, buf: &mut Vec<u8>) {
+        buf.extend_from_slice(&(self.len.load(Ordering::Acquire) as u64).to_le_bytes());
+        for i in 0..self.words_len() {
+            buf.extend_from_slice(&self.word(i).load(Ordering::Relaxed).to_le_bytes());
+        }
+    }
+
+    /// Add the spans for every id we have seen to a set of spans
+    /// recorded by the older, non-table based interface. When
+    /// counting, also return the total hits for each span.
+    fn collect(&self, spans: &Mutex<HashSet<Span>>) -> HashMap<Span, u64> {
+        let len = self.len.load(Ordering::Acquire);
+        let counting = self.counting.load(Ordering::Relaxed);
+        let mut spans = spans.lock().unwrap();
+        let mut counts = HashMap::new();
+        for id in 0..len {
+            let hits = self.hits(id);
+            if hits != 0 {
+                let span = unsafe { &*self.spans.load(Ordering::Relaxed).add(id) };
+                let span = Span {
+                    sail_file: unsafe { CStr::from_ptr(span.sail_file) }.into(),
+                    line1: span.l1 as i32,
+                    char1: span.c1 as i32,
+                    line2: span.l2 as i32,
+                    char2: span.c2 as i32,
+                };
+                if counting {
+                    *counts.entry(span.clone()).or_insert(0) += hits;
+                }
+                spans.insert(span);
+            }
+        }
+        counts
+    }
+}
+
+static FUNCTION_TABLE: Table = Table::new();
+static BRANCH_TABLE: Table = Table::new();
+static BRANCH_TARGET_TABLE: Table = Table::new();
+
+static BINARY: AtomicBool = AtomicBool::new(false);
+
+/// Set if an `_id` function is called before its table is registered,
+/// in which case the hit cannot be recorded.
+static UNREGISTERED: AtomicBool = AtomicBool::new(false);
+
+fn fnv1a(hash: &mut u64, bytes: &[u8]) {
+    for byte in bytes {
+        *hash ^= *byte as u64;
+        *hash = hash.wrapping_mul(0x100000001b3);
+    }
+}
+
+/// The binary format is a header containing the magic bytes, flags
+/// (bit 0 is set if the file contains counts rather than bitmaps),
+/// and a hash of the span tables, followed by the function, branch,
+/// and branch target tables. Each table is its length in ids followed
+/// by the bitmap or counter words. Everything is little-endian.
+const BINARY_MAGIC: &[u8; 8] = b"SAILCOV1";
+
+fn write_binary(path: &str) -> io::Result<()> {
+    let tables = [&FUNCTION_TABLE, &BRANCH_TABLE, &BRANCH_TARGET_TABLE];
+    let counting = tables.iter().any(|t| t.counting.load(Ordering::Relaxed));
+    let mut hash: u64 = 0xcbf29ce484222325;
+    for table in tables.iter() {
+        table.hash(&mut hash)
+    }
+    let mut buf = Vec::new();
+    buf.extend_from_slice(BINARY_MAGIC);
+    buf.extend_from_slice(&(counting as u32).to_le_bytes());
+    buf.extend_from_slice(&0u32.to_le_bytes());
+    buf.extend_from_slice(&hash.to_le_bytes());
+    for table in tables.iter() {
+        table.write_binary(&mut buf)
+    }
+    // Write to a temporary file and rename it, so other processes never see a partial file
+    let tmp = format!("{}.tmp.{}", path, process::id());
+    fs::write(&tmp, &buf)?;
+    fs::rename(&tmp, path)
+}
+
 fn function_entry(_function_id: i32, _function_name: &CStr, span: Span) {
     FUNCTIONS.lock().unwrap().insert(span);
 }
@@ -36,45 +232,63 @@ fn branch_target_taken(_branch_id: i32, _branch_target_id: i32, span: Span) {
     BRANCH_TARGETS.lock().unwrap().insert(span);
 }
 
-fn write_locations(file: &mut File, kind: char, spans: &Mutex<HashSet<Span>>) -> bool {
+/// Write each span, followed by its hit count if we have one.
+fn write_locations(
+    buf: &mut String,
+    kind: char,
+    spans: &Mutex<HashSet<Span>>,
+    counts: &HashMap<Span, u64>,
+) {
     for span in spans.lock().unwrap().iter() {
-        let res = writeln!(
-            file,
-            "{} \"{}\", {}, {}, {}, {}",
+        let count = match counts.get(span) {
+            Some(count) => format!(", {}", count),
+            None => String::new(),
+        };
+        let _ = writeln!(
+            buf,
+            "{} \"{}\", {}, {}, {}, {}{}",
             kind,
             span.sail_file.to_string_lossy(),
             span.line1,
             span.char1,
             span.line2,
             span.char2,
+            count,
         );
-        if res.is_err() {
-            return false;
-        }
     }
-    true
 }
 
 #[no_mangle]
 pub extern "C" fn sail_coverage_exit() -> c_int {
-    if let Ok(mut file) = OpenOptions::new()
-        .create(true)
-        .append(true)
-        .open(&*OUTPUT_FILE.lock().unwrap())
-    {
-        if !write_locations(&mut file, 'B', &BRANCH_REACHED) {
-            return 1;
-        }
-        if !write_locations(&mut file, 'F', &FUNCTIONS) {
-            return 1;
-        }
-        if !write_locations(&mut file, 'T', &BRANCH_TARGETS) {
-            return 1;
+    // A %p in the file name is replaced by the process id, so parallel runs can write separate files
+    let path = OUTPUT_FILE
+        .lock()
+        .unwrap()
+        .replace("%p", &process::id().to_string());
+    if UNREGISTERED.load(Ordering::Relaxed) {
+        eprintln!(
+            "sail_coverage: warning: coverage was recorded before sail_coverage_init \
+             registered the span tables, so {} is incomplete",
+            path
+        );
+    }
+    if BINARY.load(Ordering::Relaxed) {
+        return if write_binary(&path).is_ok() { 0 } else { 1 };
+    }
+    let function_counts = FUNCTION_TABLE.collect(&FUNCTIONS);
+    let branch_counts = BRANCH_TABLE.collect(&BRANCH_REACHED);
+    let branch_target_counts = BRANCH_TARGET_TABLE.collect(&BRANCH_TARGETS);
+    let mut buf = String::new();
+    write_locations(&mut buf, 'B', &BRANCH_REACHED, &branch_counts);
+    write_locations(&mut buf, 'F', &FUNCTIONS, &function_counts);
+    write_locations(&mut buf, 'T', &BRANCH_TARGETS, &branch_target_counts);
+    // Append everything with a single write, so output from concurrent processes is not interleaved
+    if let Ok(mut file) = OpenOptions::new().create(true).append(true).open(&path) {
+        if file.write_all(buf.as_bytes()).is_ok() {
+            return 0;
         }
-        0
-    } else {
-        1
     }
+    1
 }
 
 #[no_mangle]
@@ -82,6 +296,15 @@ pub unsafe extern "C" fn sail_set_coverage_file(output_file: *const c_char) {
     *OUTPUT_FILE.lock().unwrap() = CStr::from_ptr(output_file).to_string_lossy().to_string()
 }
 
+/// Like `sail_set_coverage_file`, but write the compact binary format
+/// described above. This only records locations reached via the `_id`
+/// functions.
+#[no_mangle]
+pub unsafe extern "C" fn sail_set_coverage_binary_file(output_file: *const c_char) {
+    sail_set_coverage_file(output_file);
+    BINARY.store(true, Ordering::Relaxed)
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn sail_function_entry(
     function_id: c_int,
@@ -148,3 +371,51 @@ pub unsafe extern "C" fn sail_branch_target_taken(
         },
     )
 }
+
+/// Register the static span tables generated by the Sail C backend.
+/// Each table is indexed by the ids passed to the `_id` functions
+/// below, which are ignored until this has been called.
+#[no_mangle]
+pub extern "C" fn sail_coverage_init(
+    functions: *const CSpan,
+    function_count: c_int,
+    branches: *const CSpan,
+    branch_count: c_int,
+    branch_targets: *const CSpan,
+    branch_target_count: c_int,
+) {
+    FUNCTION_TABLE.init(functions, function_count, false);
+    BRANCH_TABLE.init(branches, branch_count, false);
+    BRANCH_TARGET_TABLE.init(branch_targets, branch_target_count, false);
+}
+
+/// Like `sail_coverage_init`, but count how many times each id is
+/// reached. The counts are appended to each line of the coverage file.
+#[no_mangle]
+pub extern "C" fn sail_coverage_init_counts(
+    functions: *const CSpan,
+    function_count: c_int,
+    branches: *const CSpan,
+    branch_count: c_int,
+    branch_targets: *const CSpan,
+    branch_target_count: c_int,
+) {
+    FUNCTION_TABLE.init(functions, function_count, true);
+    BRANCH_TABLE.init(branches, branch_count, true);
+    BRANCH_TARGET_TABLE.init(branch_targets, branch_target_count, true);
+}
+
+#[no_mangle]
+pub extern "C" fn sail_function_entry_id(function_id: c_int) {
+    FUNCTION_TABLE.set(function_id)
+}
+
+#[no_mangle]
+pub extern "C" fn sail_branch_reached_id(branch_id: c_int) {
+    BRANCH_TABLE.set(branch_id)
+}
+
+#[no_mangle]
+pub extern "C" fn sail_branch_target_taken_id(_branch_id: c_int, branch_target_id: c_int) {
+    BRANCH_TARGET_TABLE.set(branch_target_id)
+}
@@ -10,7 +10,7 @@
  * This function should be called whenever a pattern match failure
  * occurs. Pattern match failures are always fatal.
  */
-void sail_match_failure(const_sail_string msg);
+void sail_match_failure(const_sail_string msg) __attribute__((noreturn, cold));
 
 /*
  * sail_assert implements the assert construct in Sail. If any
@@ -513,6 +513,15 @@ fbits safe_rshift(const fbits x, const fbits n)
   }
 }
 
+fbits safe_lshift(const fbits x, const fbits n)
+{
+  if (n >= 64) {
+    return 0ul;
+  } else {
+    return x << n;
+  }
+}
+
 void normalize_lbits(lbits *rop)
 {
   mpz_t tmp;
@@ -594,6 +603,73 @@ void not_bits(lbits *rop, const lbits op)
   }
 }
 
+/*
+ * The lane-wise kernels compute each lane independently, by clearing
+ * the top bit of every lane before the add or subtract, so no carry or
+ * borrow crosses a lane boundary, and then fixing up the top bits.
+ */
+static void lane_high_bits(mpz_t rop, const uint64_t len, const uint64_t lane)
+{
+  mpz_set_ui(rop, 0);
+  for (uint64_t i = lane - 1; i < len; i += lane) {
+    mpz_setbit(rop, i);
+  }
+}
+
+void add_lanes(lbits *rop, const lbits op1, const lbits op2, const mach_int lane)
+{
+  assert(op1.len == op2.len);
+  mpz_t high, tmp1, tmp2;
+  mpz_init(high);
+  mpz_init(tmp1);
+  mpz_init(tmp2);
+
+  lane_high_bits(high, op1.len, (uint64_t) lane);
+  // (op1 & ~high) + (op2 & ~high)
+  mpz_and(tmp1, *op1.bits, high);
+  mpz_xor(tmp1, tmp1, *op1.bits);
+  mpz_and(tmp2, *op2.bits, high);
+  mpz_xor(tmp2, tmp2, *op2.bits);
+  mpz_add(tmp1, tmp1, tmp2);
+  // ^ ((op1 ^ op2) & high)
+  mpz_xor(tmp2, *op1.bits, *op2.bits);
+  mpz_and(tmp2, tmp2, high);
+  rop->len = op1.len;
+  mpz_xor(*rop->bits, tmp1, tmp2);
+  normalize_lbits(rop);
+
+  mpz_clear(high);
+  mpz_clear(tmp1);
+  mpz_clear(tmp2);
+}
+
+void sub_lanes(lbits *rop, const lbits op1, const lbits op2, const mach_int lane)
+{
+  assert(op1.len == op2.len);
+  mpz_t high, tmp1, tmp2;
+  mpz_init(high);
+  mpz_init(tmp1);
+  mpz_init(tmp2);
+
+  lane_high_bits(high, op1.len, (uint64_t) lane);
+  // (op1 | high) - (op2 & ~high)
+  mpz_ior(tmp1, *op1.bits, high);
+  mpz_and(tmp2, *op2.bits, high);
+  mpz_xor(tmp2, tmp2, *op2.bits);
+  mpz_sub(tmp1, tmp1, tmp2);
+  // ^ ((op1 ^ ~op2) & high)
+  mpz_xor(tmp2, *op1.bits, *op2.bits);
+  mpz_and(tmp2, tmp2, high);
+  mpz_xor(tmp2, tmp2, high);
+  rop->len = op1.len;
+  mpz_xor(*rop->bits, tmp1, tmp2);
+  normalize_lbits(rop);
+
+  mpz_clear(high);
+  mpz_clear(tmp1);
+  mpz_clear(tmp2);
+}
+
 void mults_vec(lbits *rop, const lbits op1, const lbits op2)
 {
   return;
@@ -818,21 +894,48 @@ sbits append_ss(const sbits op1, const sbits op2)
 void replicate_bits(lbits *rop, const lbits op1, const sail_int op2)
 {
   uint64_t op2_ui = (uint64_t) op2;
-  rop->len = op1.len * op2_ui;
-  mpz_set_ui(*rop->bits, 0);
-  for (int i = 0; i < op2_ui; i++) {
-    mpz_mul_2exp(*rop->bits, *rop->bits, op1.len);
-    mpz_ior(*rop->bits, *rop->bits, *op1.bits);
+  uint64_t len = op1.len * op2_ui;
+
+  if (len <= 64) {
+    rop->len = len;
+    mpz_set_ui(*rop->bits, fast_replicate_bits(op1.len, mpz_get_ui(*op1.bits), op2_ui));
+    return;
+  }
+
+  mpz_t acc;
+  mpz_t tmp;
+  mpz_init(acc);
+  mpz_init(tmp);
+
+  // Double the number of copies each time, so we only need
+  // O(log(op2)) GMP operations. The low copied bits are always a whole
+  // number of copies of op1, so they can be appended as-is.
+  mpz_set(acc, *op1.bits);
+  uint64_t copied = op1.len;
+  while (copied < len) {
+    uint64_t n = copied < len - copied ? copied : len - copied;
+    mpz_fdiv_r_2exp(tmp, acc, n);
+    mpz_mul_2exp(tmp, tmp, copied);
+    mpz_ior(acc, acc, tmp);
+    copied += n;
   }
+  rop->len = len;
+  mpz_set(*rop->bits, acc);
+
+  mpz_clear(acc);
+  mpz_clear(tmp);
 }
 
 uint64_t fast_replicate_bits(const uint64_t shift, const uint64_t v, const int64_t times)
 {
+  // Double the number of copies each iteration, then mask away any
+  // copies beyond the result length.
+  uint64_t len = shift * times;
   uint64_t r = v;
-  for (int i = 1; i < times; ++i) {
-    r |= (r << shift);
+  for (uint64_t copied = shift; copied < len; copied *= 2) {
+    r |= r << copied;
   }
-  return r;
+  return r & safe_rshift(UINT64_MAX, 64 - len);
 }
 
 // Takes a slice of the (two's complement) binary representation of
@@ -1016,43 +1119,45 @@ void shiftr(lbits *rop, const lbits op1, const sail_int op2)
   mpz_tdiv_q_2exp(*rop->bits, *op1.bits, (uint64_t) op2);
 }
 
+fbits fast_reverse_endianness(const fbits op, const uint64_t len)
+{
+  uint64_t x = op;
+  x = (x & 0xFFFFFFFF00000000) >> 32 | (x & 0x00000000FFFFFFFF) << 32;
+  x = (x & 0xFFFF0000FFFF0000) >> 16 | (x & 0x0000FFFF0000FFFF) << 16;
+  x = (x & 0xFF00FF00FF00FF00) >> 8  | (x & 0x00FF00FF00FF00FF) << 8;
+  return safe_rshift(x, 64 - len);
+}
+
 void reverse_endianness(lbits *rop, const lbits op)
 {
-  rop->len = op.len;
-  if (rop->len == 64ul) {
-    uint64_t x = mpz_get_ui(*op.bits);
-    x = (x & 0xFFFFFFFF00000000) >> 32 | (x & 0x00000000FFFFFFFF) << 32;
-    x = (x & 0xFFFF0000FFFF0000) >> 16 | (x & 0x0000FFFF0000FFFF) << 16;
-    x = (x & 0xFF00FF00FF00FF00) >> 8  | (x & 0x00FF00FF00FF00FF) << 8;
-    mpz_set_ui(*rop->bits, x);
-  } else if (rop->len == 32ul) {
-    uint64_t x = mpz_get_ui(*op.bits);
-    x = (x & 0xFFFF0000FFFF0000) >> 16 | (x & 0x0000FFFF0000FFFF) << 16;
-    x = (x & 0xFF00FF00FF00FF00) >> 8  | (x & 0x00FF00FF00FF00FF) << 8;
-    mpz_set_ui(*rop->bits, x);
-  } else if (rop->len == 16ul) {
-    uint64_t x = mpz_get_ui(*op.bits);
-    x = (x & 0xFF00FF00FF00FF00) >> 8  | (x & 0x00FF00FF00FF00FF) << 8;
-    mpz_set_ui(*rop->bits, x);
-  } else if (rop->len == 8ul) {
-    mpz_set(*rop->bits, *op.bits);
-  } else {
-    mpz_t tmp1;
-    mpz_t tmp2;
-    mpz_init(tmp1);
-    mpz_init(tmp2);
-    
-    /* For other numbers of bytes we reverse the bytes.
-     * XXX could use mpz_import/export for this. */
-    mpz_set_ui(tmp1, 0xff); // byte mask
-    mpz_set_ui(*rop->bits, 0); // reset accumulator for result
-    for(mp_bitcnt_t byte = 0; byte < op.len; byte+=8) {
-      mpz_tdiv_q_2exp(tmp2, *op.bits, byte); // shift byte to bottom
-      mpz_and(tmp2, tmp2, tmp1); // and with mask
-      mpz_mul_2exp(*rop->bits, *rop->bits, 8); // shift result left 8
-      mpz_ior(*rop->bits, *rop->bits, tmp2); // or byte into result
+  uint64_t len = op.len;
+
+  if (len <= 64 && len % 8 == 0) {
+    mpz_set_ui(*rop->bits, fast_reverse_endianness(mpz_get_ui(*op.bits), len));
+  } else if (len <= 128 && len % 8 == 0) {
+    // Reverse each word and swap them, then shift the result down
+    // to remove the zero bytes that were above the length.
+    uint64_t in[2] = { 0, 0 };
+    mpz_export(in, NULL, -1, sizeof(uint64_t), 0, 0, *op.bits);
+    uint64_t words[2] = { fast_reverse_endianness(in[1], 64),
+                          fast_reverse_endianness(in[0], 64) };
+    uint64_t shift = 128 - len;
+    if (shift != 0) {
+      words[0] = (words[0] >> shift) | (words[1] << (64 - shift));
+      words[1] = words[1] >> shift;
     }
+    mpz_import(*rop->bits, 2, -1, sizeof(uint64_t), 0, 0, words);
+  } else {
+    // Export the bytes least significant first, then import them
+    // most significant first.
+    size_t bytes = (len + 7) / 8;
+    unsigned char *buf = (unsigned char *)malloc(bytes);
+    memset(buf, 0, bytes);
+    mpz_export(buf, NULL, -1, 1, 0, 0, *op.bits);
+    mpz_import(*rop->bits, bytes, 1, 1, 0, 0, buf);
+    free(buf);
   }
+  rop->len = len;
 }
 
 bool eq_sbits(const sbits op1, const sbits op2)
@@ -1116,6 +1221,149 @@ sbits sub_sbits(const sbits op1, const sbits op2)
   return rop;
 }
 
+/* ***** Sail 128-bit bitvectors ***** */
+
+static void mpz_set_fbits128(mpz_t rop, const fbits128 op)
+{
+  uint64_t words[2] = { (uint64_t) op, (uint64_t) (op >> 64) };
+  mpz_import(rop, 2, -1, sizeof(uint64_t), 0, 0, words);
+}
+
+static fbits128 fbits128_of_mpz(const mpz_t op)
+{
+#if GMP_NUMB_BITS == 64
+  return FBITS128_C(mpz_getlimbn(op, 1), mpz_getlimbn(op, 0));
+#else
+  uint64_t words[2] = { 0, 0 };
+  mpz_export(words, NULL, -1, sizeof(uint64_t), 0, 0, op);
+  return FBITS128_C(words[1], words[0]);
+#endif
+}
+
+bool EQUAL(fbits128)(const fbits128 op1, const fbits128 op2)
+{
+  return op1 == op2;
+}
+
+bool EQUAL(ref_fbits128)(const fbits128 *op1, const fbits128 *op2)
+{
+  return *op1 == *op2;
+}
+
+void CREATE_OF(lbits, fbits128)(lbits *rop, const fbits128 op, const uint64_t len, const bool direction)
+{
+  rop->bits = malloc(sizeof(mpz_t));
+  rop->len = len;
+  mpz_init(*rop->bits);
+  mpz_set_fbits128(*rop->bits, op);
+}
+
+void RECREATE_OF(lbits, fbits128)(lbits *rop, const fbits128 op, const uint64_t len, const bool direction)
+{
+  rop->len = len;
+  mpz_set_fbits128(*rop->bits, op);
+}
+
+fbits128 CREATE_OF(fbits128, lbits)(const lbits op, const bool direction)
+{
+  return fbits128_of_mpz(*op.bits);
+}
+
+fbits128 CONVERT_OF(fbits128, lbits)(const lbits op, const bool direction)
+{
+  return fbits128_of_mpz(*op.bits);
+}
+
+void CONVERT_OF(lbits, fbits128)(lbits *rop, const fbits128 op, const uint64_t len, const bool direction)
+{
+  rop->len = len;
+  mpz_set_fbits128(*rop->bits, op & safe_rshift128(FBITS128_MAX, 128 - len));
+}
+
+fbits128 UNDEFINED(fbits128)(const unit u) { return 0; }
+
+fbits128 safe_rshift128(const fbits128 x, const fbits128 n)
+{
+  if (n >= 128) {
+    return 0;
+  } else {
+    return x >> n;
+  }
+}
+
+fbits128 safe_lshift128(const fbits128 x, const fbits128 n)
+{
+  if (n >= 128) {
+    return 0;
+  } else {
+    return x << n;
+  }
+}
+
+fbits128 fast_sign_extend128(const fbits128 op, const uint64_t n, const uint64_t m)
+{
+  fbits128 rop = op;
+  if ((op >> (n - 1)) & 1) {
+    rop |= safe_rshift128(FBITS128_MAX, 128 - m) & ~safe_rshift128(FBITS128_MAX, 128 - n);
+  }
+  return rop;
+}
+
+fbits128 update_fbits128(const fbits128 op, const uint64_t n, const fbits bit)
+{
+  if ((bit & 1) == 1) {
+    return op | ((fbits128) 1 << n);
+  } else {
+    return op & ~((fbits128) 1 << n);
+  }
+}
+
+__attribute__((target ("bmi2")))
+sbits sslice128(const fbits128 op, const mach_int start, const mach_int len)
+{
+  sbits rop;
+  rop.bits = _bzhi_u64((uint64_t) safe_rshift128(op, start), (uint64_t) len);
+  rop.len = (uint64_t) len;
+  return rop;
+}
+
+fbits128 fast_replicate_bits128(const uint64_t shift, const fbits128 v, const int64_t times)
+{
+  uint64_t len = shift * times;
+  fbits128 r = v;
+  for (uint64_t copied = shift; copied < len; copied *= 2) {
+    r |= r << copied;
+  }
+  return r & safe_rshift128(FBITS128_MAX, 128 - len);
+}
+
+void string_of_fbits128(sail_string *str, const fbits128 op)
+{
+  free(*str);
+  uint64_t hi = (uint64_t) (op >> 64);
+  uint64_t lo = (uint64_t) op;
+  int bytes;
+  if (hi == 0) {
+    bytes = asprintf(str, "0x%" PRIx64, lo);
+  } else {
+    bytes = asprintf(str, "0x%" PRIx64 "%016" PRIx64, hi, lo);
+  }
+  if (bytes == -1) {
+    fprintf(stderr, "Could not print bits 0x%" PRIx64 "%016" PRIx64 "\n", hi, lo);
+  }
+}
+
+void decimal_string_of_fbits128(sail_string *str, const fbits128 op)
+{
+  free(*str);
+  mpz_t n;
+  mpz_init(n);
+  mpz_set_fbits128(n, op);
+  gmp_asprintf(str, "%Zd", n);
+  mpz_clear(n);
+}
+
+
 /* ***** Sail Reals ***** */
 
 void CREATE(real)(real *rop)
@@ -29,11 +29,14 @@ void cleanup_library(void);
 #define UNDEFINED(type) undefined_ ## type
 #define EQUAL(type) eq_ ## type
 
-#define SAIL_BUILTIN_TYPE(type)\
+#define SAIL_BUILTIN_TYPE_IMPL(type, const_type)\
   void create_ ## type(type *);\
   void recreate_ ## type(type *);\
-  void copy_ ## type(type *, const type);\
+  void copy_ ## type(type *, const_type);\
   void kill_ ## type(type *);
+#define SAIL_BUILTIN_TYPE(type) SAIL_BUILTIN_TYPE_IMPL(type, const type)
+
+#include "../sail_hints.h"
 
 /* ***** Sail unit type ***** */
 
@@ -69,7 +72,7 @@ bool UNDEFINED(bool)(const unit);
 typedef char *sail_string;
 typedef const char *const_sail_string;
 
-SAIL_BUILTIN_TYPE(sail_string);
+SAIL_BUILTIN_TYPE_IMPL(sail_string, const_sail_string);
 
 void undefined_string(sail_string *str, const unit u);
 
@@ -220,9 +223,10 @@ sbits undefined_sbits(void);
 
 /*
  * Wrapper around >> operator to avoid UB when shift amount is greater
- * than or equal to 64.
+ * than or equal to 64, and likewise for <<.
  */
 fbits safe_rshift(const fbits, const fbits);
+fbits safe_lshift(const fbits, const fbits);
 
 /*
  * Used internally to construct large bitvector literals.
@@ -240,6 +244,13 @@ void or_bits(lbits *rop, const lbits op1, const lbits op2);
 void xor_bits(lbits *rop, const lbits op1, const lbits op2);
 void not_bits(lbits *rop, const lbits op);
 
+/*
+ * Add or subtract each lane of the given width independently. The
+ * lane width must be 8, 16, 32 or 64.
+ */
+void add_lanes(lbits *rop, const lbits op1, const lbits op2, const mach_int lane);
+void sub_lanes(lbits *rop, const lbits op1, const lbits op2, const mach_int lane);
+
 void mults_vec(lbits *rop, const lbits op1, const lbits op2);
 void mult_vec(lbits *rop, const lbits op1, const lbits op2);
 
@@ -320,6 +331,12 @@ void shiftr(lbits *rop, const lbits op1, const sail_int op2);
 
 void reverse_endianness(lbits*, lbits);
 
+/*
+ * Reverse the bytes of a len bit bitvector, where len is a multiple
+ * of 8 no greater than 64.
+ */
+fbits fast_reverse_endianness(const fbits op, const uint64_t len);
+
 bool eq_sbits(const sbits op1, const sbits op2);
 bool neq_sbits(const sbits op1, const sbits op2);
 sbits not_sbits(const sbits op);
@@ -329,6 +346,52 @@ sbits and_sbits(const sbits op1, const sbits op2);
 sbits add_sbits(const sbits op1, const sbits op2);
 sbits sub_sbits(const sbits op1, const sbits op2);
 
+/* ***** Sail 128-bit bitvectors ***** */
+
+/*
+ * When compiling with -Ofbits128, bitvectors with a statically known
+ * length between 65 and 128 bits are represented as an unsigned
+ * __int128, rather than using lbits.
+ */
+typedef unsigned __int128 fbits128;
+
+#define FBITS128_C(hi, lo) ((((fbits128) (hi)) << 64) | ((fbits128) (lo)))
+#define FBITS128_MAX (~((fbits128) 0))
+
+bool EQUAL(fbits128)(const fbits128, const fbits128);
+bool EQUAL(ref_fbits128)(const fbits128*, const fbits128*);
+
+void CREATE_OF(lbits, fbits128)(lbits *,
+				const fbits128 op,
+				const uint64_t len,
+				const bool direction);
+
+void RECREATE_OF(lbits, fbits128)(lbits *,
+				  const fbits128 op,
+				  const uint64_t len,
+				  const bool direction);
+
+fbits128 CREATE_OF(fbits128, lbits)(const lbits op, const bool direction);
+
+fbits128 CONVERT_OF(fbits128, lbits)(const lbits, const bool);
+void CONVERT_OF(lbits, fbits128)(lbits *, const fbits128, const uint64_t, const bool);
+
+fbits128 UNDEFINED(fbits128)(const unit);
+
+fbits128 safe_rshift128(const fbits128, const fbits128);
+fbits128 safe_lshift128(const fbits128, const fbits128);
+
+fbits128 fast_sign_extend128(const fbits128 op, const uint64_t n, const uint64_t m);
+
+fbits128 update_fbits128(const fbits128 op, const uint64_t n, const fbits bit);
+
+sbits sslice128(const fbits128 op, const mach_int start, const mach_int len);
+
+fbits128 fast_replicate_bits128(const fbits shift, const fbits128 v, const mach_int times);
+
+void string_of_fbits128(sail_string *str, const fbits128 op);
+void decimal_string_of_fbits128(sail_string *str, const fbits128 op);
+
 /* ***** Sail reals ***** */
 
 typedef mpq_t real;
@@ -371,7 +434,7 @@ void random_real(real *rop, unit);
 
 /* ***** String utilities ***** */
 
-SAIL_INT_FUNCTION(string_length, sail_int, sail_string);
+SAIL_INT_FUNCTION(string_length, sail_int, const_sail_string);
 void string_drop(sail_string *dst, const_sail_string s, sail_int len);
 void string_take(sail_string *dst, const_sail_string s, sail_int len);
 
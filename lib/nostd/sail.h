@@ -41,11 +41,14 @@ static inline uint64_t sail_bzhi_u64(uint64_t op1, uint64_t op2)
  * live on the stack, and need some kind of setup and teardown
  * routines, as Sail won't use these otherwise.
  */
-#define SAIL_BUILTIN_TYPE(type)\
+#define SAIL_BUILTIN_TYPE_IMPL(type, const_type)\
   void create_ ## type(type *);\
   void recreate_ ## type(type *);\
-  void copy_ ## type(type *, const type);\
+  void copy_ ## type(type *, const_type);\
   void kill_ ## type(type *);
+#define SAIL_BUILTIN_TYPE(type) SAIL_BUILTIN_TYPE_IMPL(type, const type)
+
+#include "../sail_hints.h"
 
 /* ********************************************************************** */
 /* Sail unit type                                                         */
@@ -101,7 +104,7 @@ static inline bool UNDEFINED(bool)(const unit u)
 typedef char *sail_string;
 typedef const char *const_sail_string;
 
-SAIL_BUILTIN_TYPE(sail_string)
+SAIL_BUILTIN_TYPE_IMPL(sail_string, const_sail_string)
 
 void undefined_string(sail_string *str, const unit u);
 
@@ -252,6 +255,15 @@ static inline fbits safe_rshift(const fbits x, const fbits n)
      }
 }
 
+static inline fbits safe_lshift(const fbits x, const fbits n)
+{
+     if (n >= 64) {
+          return 0;
+     } else {
+          return x << n;
+     }
+}
+
 /*
  * For backwards compatibility with older Sail C libraries
  */
@@ -12,7 +12,7 @@ void sail_failure(char *message);
 /*
  * Called for pattern match failures
  */
-void sail_match_failure(char *message);
+void sail_match_failure(char *message) __attribute__((cold));
 
 /*
  * Implements the Sail assert construct
@@ -69,21 +69,51 @@
 #include <getopt.h>
 #include <inttypes.h>
 #include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <zlib.h>
 
 #include "sail.h"
 #include "rts.h"
 #include "elf.h"
+#include "sail_trace.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 extern void (*sail_rts_set_coverage_file)(const char *);
+extern void (*sail_rts_set_coverage_binary_file)(const char *);
 
 static uint64_t g_elf_entry;
 uint64_t g_cycle_count = 0;
 static uint64_t g_cycle_limit;
 
+/*
+ * cycle_limit_reached (see rts.h) counts down sail_cycle_budget and
+ * only calls sail_cycle_deadline when it reaches zero. The budget is
+ * refilled there with the number of cycles until the next cycle
+ * limit, periodic statistics report, or time limit poll, whichever
+ * comes first. g_cycle_count is only brought up to date by
+ * sync_cycle_count.
+ */
+#define CYCLE_POLL_INTERVAL (UINT64_C(1) << 20)
+
+uint64_t sail_cycle_budget = CYCLE_POLL_INTERVAL;
+static uint64_t g_cycle_epoch = 0;
+static uint64_t g_cycle_refill = CYCLE_POLL_INTERVAL;
+
+static void sync_cycle_count(void)
+{
+  g_cycle_count = g_cycle_epoch + (g_cycle_refill - sail_cycle_budget);
+}
+
+static uint64_t g_time_limit = 0;
+static volatile sig_atomic_t g_time_limit_reached = 0;
+
 extern void model_pre_exit();
 
 unit sail_exit(unit u)
@@ -278,32 +308,6 @@ void kill_mem()
 
 // ***** Memory builtins *****
 
-bool write_ram(const mpz_t addr_size,     // Either 32 or 64
-	       const mpz_t data_size_mpz, // Number of bytes
-	       const lbits hex_ram,       // Currently unused
-	       const lbits addr_bv,
-	       const lbits data)
-{
-  uint64_t addr = mpz_get_ui(*addr_bv.bits);
-  uint64_t data_size = mpz_get_ui(data_size_mpz);
-
-  mpz_t buf;
-  mpz_init_set(buf, *data.bits);
-
-  uint64_t byte;
-  for(uint64_t i = 0; i < data_size; ++i) {
-    // Take the 8 low bits of buf and write to addr.
-    byte = mpz_get_ui(buf) & 0xFF;
-    write_mem(addr + i, byte);
-
-    // Then shift buf 8 bits right.
-    mpz_fdiv_q_2exp(buf, buf, 8);
-  }
-
-  mpz_clear(buf);
-  return true;
-}
-
 sbits fast_read_ram(const int64_t data_size,
 		    const uint64_t addr)
 {
@@ -319,58 +323,77 @@ sbits fast_read_ram(const int64_t data_size,
   return res;
 }
 
+/*
+ * These helpers only use the generic lbits interface, so they work
+ * for both the GMP and limb representations of lbits. Memory is read
+ * and written a 64-bit word at a time.
+ */
+static void write_ram_at(const uint64_t addr, const uint64_t data_size, const lbits data)
+{
+  for(uint64_t i = 0; i < data_size; ++i) {
+    uint64_t word = get_lbits_word(data, i / 8);
+    write_mem(addr + i, (word >> (8 * (i % 8))) & 0xFF);
+  }
+}
+
+static void read_ram_at(lbits *data, const uint64_t addr, const uint64_t data_size)
+{
+  // Read any partial chunk at the top first, then append full 64-bit
+  // chunks from the highest address down.
+  uint64_t top = data_size % 8;
+  sbits chunk = fast_read_ram(top, addr + (data_size - top));
+  RECREATE_OF(lbits, sbits)(data, chunk, true);
+  for(uint64_t i = data_size - top; i > 0; i -= 8) {
+    append_64(data, *data, fast_read_ram(8, addr + (i - 8)).bits);
+  }
+}
+
+bool write_ram(const sail_int addr_size,     // Either 32 or 64
+	       const sail_int data_size_mpz, // Number of bytes
+	       const lbits hex_ram,          // Currently unused
+	       const lbits addr_bv,
+	       const lbits data)
+{
+  uint64_t addr = CONVERT_OF(fbits, lbits)(addr_bv, true);
+  uint64_t data_size = sail_int_get_ui(data_size_mpz);
+
+  write_ram_at(addr, data_size, data);
+  return true;
+}
+
 void read_ram(lbits *data,
-	      const mpz_t addr_size,
-	      const mpz_t data_size_mpz,
+	      const sail_int addr_size,
+	      const sail_int data_size_mpz,
 	      const lbits hex_ram,
 	      const lbits addr_bv)
 {
-  uint64_t addr = mpz_get_ui(*addr_bv.bits);
-  uint64_t data_size = mpz_get_ui(data_size_mpz);
-
-  mpz_set_ui(*data->bits, 0);
-  data->len = data_size * 8;
+  uint64_t addr = CONVERT_OF(fbits, lbits)(addr_bv, true);
+  uint64_t data_size = sail_int_get_ui(data_size_mpz);
 
-  mpz_t byte;
-  mpz_init(byte);
-  for(uint64_t i = data_size; i > 0; --i) {
-    mpz_set_ui(byte, read_mem(addr + (i - 1)));
-    mpz_mul_2exp(*data->bits, *data->bits, 8);
-    mpz_add(*data->bits, *data->bits, byte);
-  }
-
-  mpz_clear(byte);
+  read_ram_at(data, addr, data_size);
 }
 
 void platform_read_mem(lbits *data,
                        const int read_kind,
                        const uint64_t addr_size,
                        const sbits addr,
-                       const mpz_t n)
+                       const sail_int n)
 {
   sbits sdata;
-  uint64_t len = mpz_get_ui(n); /* Sail type says always >0 */
+  uint64_t len = sail_int_get_ui(n); /* Sail type says always >0 */
   if (len <= 8) {
     /* fast path for small reads */
     sdata = fast_read_ram(len, addr.bits);
     RECREATE_OF(lbits, sbits)(data, sdata, true);
   } else {
-    mpz_t mpz_addr_size;
-    mpz_init(mpz_addr_size);
-    mpz_set_ui(mpz_addr_size, addr_size);
-    mpz_t addr_bv;
-    mpz_init(addr_bv);
-    mpz_set_ui(addr_bv, addr.bits);
-    read_ram(data, mpz_addr_size, n, (lbits){.len=0, .bits=NULL}, (lbits){.len=addr.len, .bits=&addr_bv});
-    mpz_clear(mpz_addr_size);
-    mpz_clear(addr_bv);
+    read_ram_at(data, addr.bits, len);
   }
 }
 
 unit platform_write_mem_ea(const int write_kind,
                            const uint64_t addr_size,
                            const sbits addr,
-                           const mpz_t n)
+                           const sail_int n)
 {
     return UNIT;
 }
@@ -378,19 +401,11 @@ unit platform_write_mem_ea(const int write_kind,
 bool platform_write_mem(const int write_kind,
                         const uint64_t addr_size,
                         const sbits addr,
-                        const mpz_t n,
+                        const sail_int n,
                         const lbits data)
 {
-    mpz_t mpz_addr_size;
-    mpz_init(mpz_addr_size);
-    mpz_set_ui(mpz_addr_size, addr_size);
-    mpz_t addr_bv;
-    mpz_init(addr_bv);
-    mpz_set_ui(addr_bv, addr.bits);
-    bool res = write_ram(mpz_addr_size, n, (lbits){.len=0, .bits=NULL}, (lbits){.len=addr.len, .bits=&addr_bv}, data);
-    mpz_clear(mpz_addr_size);
-    mpz_clear(addr_bv);
-    return res;
+    write_ram_at(addr.bits, sail_int_get_ui(n), data);
+    return true;
 }
 
 bool platform_excl_res(const unit unit)
@@ -406,7 +421,7 @@ unit platform_barrier()
 void emulator_read_mem(lbits *data,
                        const uint64_t addr_size,
                        const sbits addr,
-                       const mpz_t n)
+                       const sail_int n)
 {
   platform_read_mem(data, 0, addr_size, addr, n);
 }
@@ -414,7 +429,7 @@ void emulator_read_mem(lbits *data,
 void emulator_read_mem_ifetch(lbits *data,
                               const uint64_t addr_size,
                               const sbits addr,
-                              const mpz_t n)
+                              const sail_int n)
 {
   platform_read_mem(data, 0, addr_size, addr, n);
 }
@@ -422,14 +437,14 @@ void emulator_read_mem_ifetch(lbits *data,
 void emulator_read_mem_exclusive(lbits *data,
                                  const uint64_t addr_size,
                                  const sbits addr,
-                                 const mpz_t n)
+                                 const sail_int n)
 {
   platform_read_mem(data, 0, addr_size, addr, n);
 }
 
 bool emulator_write_mem(const uint64_t addr_size,
                         const sbits addr,
-                        const mpz_t n,
+                        const sail_int n,
                         const lbits data)
 {
   return platform_write_mem(0, addr_size, addr, n, data);
@@ -437,7 +452,7 @@ bool emulator_write_mem(const uint64_t addr_size,
 
 bool emulator_write_mem_exclusive(const uint64_t addr_size,
                                   const sbits addr,
-                                  const mpz_t n,
+                                  const sail_int n,
                                   const lbits data)
 {
   return platform_write_mem(0, addr_size, addr, n, data);
@@ -502,6 +517,225 @@ static int64_t g_trace_depth;
 //static int64_t g_trace_max_depth;
 static bool g_trace_enabled;
 
+/*
+ * When a trace file is given, rather than printing text to stderr we
+ * append variable length records to a buffer which is written out in
+ * large chunks. Function names are sent once, and referred to by id
+ * after that. See sail_trace.h for the format. If the file name ends
+ * in .gz the trace is compressed as it is written.
+ *
+ * The START and END records hold a count of the values that follow
+ * them, which is incremented in place as each value is traced. A
+ * record that is still being counted is never written out, so when the
+ * buffer fills up we only flush the bytes before it.
+ */
+#define TRACE_BUFFER_SIZE (1 << 20)
+#define TRACE_RECORD_MAX 32
+#define TRACE_NO_RECORD SIZE_MAX
+
+static gzFile g_trace_file = NULL;
+static uint8_t *g_trace_buffer = NULL;
+static size_t g_trace_buffer_size = 0;
+static size_t g_trace_buffer_len = 0;
+
+/* The start of the open START or END record, and its value count */
+static size_t g_trace_record = TRACE_NO_RECORD;
+static size_t g_trace_count = TRACE_NO_RECORD;
+
+static void trace_flush(void)
+{
+  if (g_trace_file != NULL && g_trace_buffer_len > 0) {
+    gzwrite(g_trace_file, g_trace_buffer, g_trace_buffer_len);
+    g_trace_buffer_len = 0;
+  }
+  g_trace_record = TRACE_NO_RECORD;
+  g_trace_count = TRACE_NO_RECORD;
+}
+
+/*
+ * Make room for n more bytes in the buffer, keeping any open record.
+ */
+static void trace_reserve(size_t n)
+{
+  if (g_trace_buffer_len + n <= g_trace_buffer_size) return;
+
+  if (g_trace_record == TRACE_NO_RECORD) {
+    trace_flush();
+  } else if (g_trace_record > 0) {
+    size_t start = g_trace_record;
+    gzwrite(g_trace_file, g_trace_buffer, start);
+    memmove(g_trace_buffer, g_trace_buffer + start, g_trace_buffer_len - start);
+    g_trace_buffer_len -= start;
+    g_trace_record -= start;
+    g_trace_count -= start;
+  }
+
+  if (g_trace_buffer_len + n > g_trace_buffer_size) {
+    while (g_trace_buffer_len + n > g_trace_buffer_size) g_trace_buffer_size *= 2;
+    g_trace_buffer = (uint8_t *)realloc(g_trace_buffer, g_trace_buffer_size);
+  }
+}
+
+static void trace_close(void)
+{
+  if (g_trace_file != NULL) {
+    trace_flush();
+    gzclose(g_trace_file);
+    g_trace_file = NULL;
+  }
+}
+
+/*
+ * Open a file for one of the binary traces, compressing it if the
+ * name ends in .gz.
+ */
+static gzFile open_trace_file(const char *filename)
+{
+  size_t len = strlen(filename);
+  bool compress = len >= 3 && strcmp(filename + len - 3, ".gz") == 0;
+  gzFile file = gzopen(filename, compress ? "wb1" : "wbT");
+  if (file == NULL) {
+    fprintf(stderr, "Could not open trace file %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  return file;
+}
+
+static void trace_reset_names(void);
+
+static void trace_open(const char *filename)
+{
+  trace_close();
+  g_trace_file = open_trace_file(filename);
+  if (g_trace_buffer == NULL) {
+    g_trace_buffer_size = TRACE_BUFFER_SIZE;
+    g_trace_buffer = (uint8_t *)malloc(g_trace_buffer_size);
+    atexit(trace_close);
+  }
+  // Each file must contain the names it refers to
+  trace_reset_names();
+  memcpy(g_trace_buffer, SAIL_TRACE_MAGIC, 8);
+  g_trace_buffer_len = 8;
+}
+
+static inline void trace_byte(uint8_t byte)
+{
+  g_trace_buffer[g_trace_buffer_len++] = byte;
+}
+
+static inline void trace_varint(uint64_t value)
+{
+  while (value >= 0x80) {
+    trace_byte((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  trace_byte((uint8_t)value);
+}
+
+static void trace_bytes(const char *str, size_t len)
+{
+  trace_reserve(len);
+  memcpy(g_trace_buffer + g_trace_buffer_len, str, len);
+  g_trace_buffer_len += len;
+}
+
+/*
+ * Begin a value record with the given tag, counting it in the open
+ * START or END record. Returns false if there is no open record, in
+ * which case the value is dropped, as happens when tracing is enabled
+ * part way through a call.
+ */
+static bool trace_value(uint8_t tag)
+{
+  if (g_trace_count == TRACE_NO_RECORD) return false;
+  trace_reserve(TRACE_RECORD_MAX);
+  if (g_trace_buffer[g_trace_count] == UINT8_MAX) {
+    fprintf(stderr, "Too many values in trace record\n");
+    exit(EXIT_FAILURE);
+  }
+  g_trace_buffer[g_trace_count]++;
+  trace_byte(tag);
+  return true;
+}
+
+static void trace_value_string(const char *str)
+{
+  size_t len = strlen(str);
+  if (trace_value(SAIL_TRACE_STRING)) {
+    trace_varint(len);
+    trace_bytes(str, len);
+  }
+}
+
+/*
+ * An open addressing hash table from function names to ids. We hash
+ * the names rather than their addresses, as nothing requires the
+ * argument to trace_start to be a string literal.
+ */
+static char **g_trace_names = NULL;
+static uint32_t *g_trace_name_ids = NULL;
+static uint32_t g_trace_names_size = 0;
+static uint32_t g_trace_names_count = 0;
+
+static void trace_reset_names(void)
+{
+  for (uint32_t i = 0; i < g_trace_names_size; ++i) {
+    free(g_trace_names[i]);
+  }
+  free(g_trace_names);
+  free(g_trace_name_ids);
+  g_trace_names = NULL;
+  g_trace_name_ids = NULL;
+  g_trace_names_size = 0;
+  g_trace_names_count = 0;
+}
+
+static uint32_t trace_name_hash(const char *name)
+{
+  uint32_t hash = 2166136261u;
+  for (; *name; name++) {
+    hash = (hash ^ (uint8_t)*name) * 16777619u;
+  }
+  return hash;
+}
+
+static uint32_t trace_name_id(const char *name)
+{
+  if (2 * (g_trace_names_count + 1) > g_trace_names_size) {
+    uint32_t old_size = g_trace_names_size;
+    char **old_names = g_trace_names;
+    uint32_t *old_ids = g_trace_name_ids;
+    g_trace_names_size = old_size == 0 ? 256 : 2 * old_size;
+    g_trace_names = (char **)calloc(g_trace_names_size, sizeof(char *));
+    g_trace_name_ids = (uint32_t *)calloc(g_trace_names_size, sizeof(uint32_t));
+    for (uint32_t i = 0; i < old_size; ++i) {
+      if (old_names[i] == NULL) continue;
+      uint32_t j = trace_name_hash(old_names[i]) & (g_trace_names_size - 1);
+      while (g_trace_names[j] != NULL) j = (j + 1) & (g_trace_names_size - 1);
+      g_trace_names[j] = old_names[i];
+      g_trace_name_ids[j] = old_ids[i];
+    }
+    free(old_names);
+    free(old_ids);
+  }
+
+  uint32_t i = trace_name_hash(name) & (g_trace_names_size - 1);
+  while (g_trace_names[i] != NULL) {
+    if (strcmp(g_trace_names[i], name) == 0) return g_trace_name_ids[i];
+    i = (i + 1) & (g_trace_names_size - 1);
+  }
+  g_trace_names[i] = strdup(name);
+  g_trace_name_ids[i] = g_trace_names_count++;
+
+  size_t len = strlen(name);
+  trace_reserve(TRACE_RECORD_MAX);
+  trace_byte(SAIL_TRACE_NAME);
+  trace_varint(g_trace_name_ids[i]);
+  trace_varint(len);
+  trace_bytes(name, len);
+  return g_trace_name_ids[i];
+}
+
 unit enable_tracing(const unit u)
 {
   g_trace_depth = 0;
@@ -513,6 +747,7 @@ unit disable_tracing(const unit u)
 {
   g_trace_depth = 0;
   g_trace_enabled = false;
+  trace_flush();
   return UNIT;
 }
 
@@ -522,59 +757,165 @@ bool is_tracing(const unit u)
 }
 
 void trace_fbits(const fbits x) {
-  if (g_trace_enabled) fprintf(stderr, "0x%" PRIx64, x);
+  if (!g_trace_enabled) return;
+  if (g_trace_file != NULL) {
+    if (trace_value(SAIL_TRACE_FBITS)) trace_varint(x);
+  } else {
+    fprintf(stderr, "0x%" PRIx64, x);
+  }
 }
 
 void trace_unit(const unit u) {
-  if (g_trace_enabled) fputs("()", stderr);
+  if (!g_trace_enabled) return;
+  if (g_trace_file != NULL) {
+    trace_value(SAIL_TRACE_UNIT);
+  } else {
+    fputs("()", stderr);
+  }
 }
 
 void trace_sail_string(const_sail_string str) {
-  if (g_trace_enabled) fputs(str, stderr);
+  if (!g_trace_enabled) return;
+  if (g_trace_file != NULL) {
+    trace_value_string(str);
+  } else {
+    fputs(str, stderr);
+  }
+}
+
+/* Integers are zigzag encoded, so small negative numbers stay small */
+static void trace_value_int(int64_t n)
+{
+  if (trace_value(SAIL_TRACE_INT)) trace_varint(((uint64_t)n << 1) ^ (uint64_t)(n >> 63));
 }
 
 void trace_sail_int(const sail_int op) {
-  if (g_trace_enabled) mpz_out_str(stderr, 10, op);
+  if (!g_trace_enabled) return;
+#ifdef SAIL_HYBRID_INT
+  if (g_trace_file != NULL && op->big == NULL) {
+    trace_value_int(op->small);
+    return;
+  }
+#else
+  if (g_trace_file != NULL && mpz_fits_slong_p(op)) {
+    trace_value_int(mpz_get_si(op));
+    return;
+  }
+#endif
+  sail_string str = NULL;
+  dec_str(&str, op);
+  if (g_trace_file != NULL) {
+    trace_value_string(str);
+  } else {
+    fputs(str, stderr);
+  }
+  sail_free(str);
 }
 
 void trace_lbits(const lbits op) {
-  if (g_trace_enabled) fprint_bits("", op, "", stderr);
+  if (!g_trace_enabled) return;
+  if (g_trace_file == NULL) {
+    fprint_bits("", op, "", stderr);
+  } else if (op.len <= 64) {
+    if (trace_value(SAIL_TRACE_BITS)) {
+      trace_varint(op.len);
+      trace_varint(CONVERT_OF(fbits, lbits)(op, true));
+    }
+  } else {
+    sail_string str = NULL;
+    string_of_lbits(&str, op);
+    trace_value_string(str);
+    sail_free(str);
+  }
 }
 
 void trace_bool(const bool b) {
-  if (g_trace_enabled) {
-    if (b) {
-      fprintf(stderr, "true");
-    } else {
-      fprintf(stderr, "false");
-    }
+  if (!g_trace_enabled) return;
+  if (g_trace_file != NULL) {
+    trace_value(b ? SAIL_TRACE_TRUE : SAIL_TRACE_FALSE);
+  } else if (b) {
+    fprintf(stderr, "true");
+  } else {
+    fprintf(stderr, "false");
   }
 }
 
 void trace_unknown(void) {
-  if (g_trace_enabled) fputs("?", stderr);
+  if (!g_trace_enabled) return;
+  if (g_trace_file != NULL) {
+    trace_value(SAIL_TRACE_UNKNOWN);
+  } else {
+    fputs("?", stderr);
+  }
 }
 
+/*
+ * In the binary trace the separators are implied by the value counts,
+ * and the end of the arguments or return value closes the open
+ * record.
+ */
 void trace_argsep(void) {
-  if (g_trace_enabled) fputs(", ", stderr);
+  if (!g_trace_enabled) return;
+  if (g_trace_file == NULL) {
+    fputs(", ", stderr);
+  }
 }
 
 void trace_argend(void) {
-  if (g_trace_enabled) fputs(")\n", stderr);
+  if (!g_trace_enabled) return;
+  if (g_trace_file != NULL) {
+    g_trace_record = TRACE_NO_RECORD;
+    g_trace_count = TRACE_NO_RECORD;
+  } else {
+    fputs(")\n", stderr);
+  }
 }
 
 void trace_retend(void) {
-  if (g_trace_enabled) fputs("\n", stderr);
+  if (!g_trace_enabled) return;
+  if (g_trace_file != NULL) {
+    g_trace_record = TRACE_NO_RECORD;
+    g_trace_count = TRACE_NO_RECORD;
+  } else {
+    fputs("\n", stderr);
+  }
+}
+
+static void trace_indent(void)
+{
+  static const char indent[] = "|   |   |   |   |   |   |   |   ";
+  fputs("[TRACE] ", stderr);
+  for (int64_t i = g_trace_depth; i > 0; i -= 8) {
+    fwrite(indent, 1, 4 * (i < 8 ? i : 8), stderr);
+  }
+}
+
+/*
+ * Open a START or END record, leaving its value count at zero.
+ */
+static void trace_open_record(uint8_t tag, uint32_t id)
+{
+  g_trace_record = TRACE_NO_RECORD;
+  g_trace_count = TRACE_NO_RECORD;
+  trace_reserve(TRACE_RECORD_MAX);
+  g_trace_record = g_trace_buffer_len;
+  trace_byte(tag);
+  if (tag == SAIL_TRACE_START) trace_varint(id);
+  trace_varint((uint64_t)g_trace_depth);
+  g_trace_count = g_trace_buffer_len;
+  trace_byte(0);
 }
 
 void trace_start(char *name)
 {
   if (g_trace_enabled) {
-    fprintf(stderr, "[TRACE] ");
-    for (int64_t i = 0; i < g_trace_depth; ++i) {
-      fprintf(stderr, "%s", "|   ");
+    if (g_trace_file != NULL) {
+      uint32_t id = trace_name_id(name);
+      trace_open_record(SAIL_TRACE_START, id);
+    } else {
+      trace_indent();
+      fprintf(stderr, "%s(", name);
     }
-    fprintf(stderr, "%s(", name);
     g_trace_depth++;
   }
 }
@@ -582,46 +923,552 @@ void trace_start(char *name)
 void trace_end(void)
 {
   if (g_trace_enabled) {
-    fprintf(stderr, "[TRACE] ");
-    for (int64_t i = 0; i < g_trace_depth; ++i) {
-      fprintf(stderr, "%s", "|   ");
+    if (g_trace_file != NULL) {
+      trace_open_record(SAIL_TRACE_END, 0);
+    } else {
+      trace_indent();
     }
     g_trace_depth--;
   }
 }
 
-/* ***** ELF functions ***** */
+// ***** Instruction retire trace *****
+
+/*
+ * A stream of variable length records, each a tag byte followed by
+ * LEB128 encoded fields (see sail_trace.h). Models call these with
+ * raw values, so nothing is formatted while the model runs.
+ */
+#define RETIRE_BUFFER_SIZE (1 << 20)
+#define RETIRE_RECORD_MAX 32
+
+static gzFile g_retire_file = NULL;
+static uint8_t *g_retire_buffer = NULL;
+static size_t g_retire_buffer_len = 0;
+
+static void retire_flush(void)
+{
+  if (g_retire_file != NULL && g_retire_buffer_len > 0) {
+    gzwrite(g_retire_file, g_retire_buffer, g_retire_buffer_len);
+    g_retire_buffer_len = 0;
+  }
+}
+
+static void retire_close(void)
+{
+  if (g_retire_file != NULL) {
+    retire_flush();
+    gzclose(g_retire_file);
+    g_retire_file = NULL;
+  }
+}
 
-void elf_entry(mpz_t *rop, const unit u)
+static void retire_open(const char *filename)
 {
-  mpz_set_ui(*rop, g_elf_entry);
+  retire_close();
+  g_retire_file = open_trace_file(filename);
+  if (g_retire_buffer == NULL) {
+    g_retire_buffer = (uint8_t *)malloc(RETIRE_BUFFER_SIZE);
+    atexit(retire_close);
+  }
+  memcpy(g_retire_buffer, SAIL_RETIRE_MAGIC, 8);
+  g_retire_buffer_len = 8;
 }
 
-void elf_tohost(mpz_t *rop, const unit u)
+static inline void retire_start(uint8_t tag)
 {
-  mpz_set_ui(*rop, 0x0ul);
+  if (g_retire_buffer_len > RETIRE_BUFFER_SIZE - RETIRE_RECORD_MAX) retire_flush();
+  g_retire_buffer[g_retire_buffer_len++] = tag;
 }
 
-/* ***** Cycle limit ***** */
+static inline void retire_varint(uint64_t value)
+{
+  while (value >= 0x80) {
+    g_retire_buffer[g_retire_buffer_len++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  g_retire_buffer[g_retire_buffer_len++] = (uint8_t)value;
+}
 
-/* NB Also increments cycle_count */
-bool cycle_limit_reached(const unit u)
+bool retire_trace_enabled(const unit u)
 {
-  return ++g_cycle_count >= g_cycle_limit && g_cycle_limit != 0;
+  return g_retire_file != NULL;
+}
+
+unit retire_trace_instr(const fbits pc, const fbits opcode)
+{
+  if (g_retire_file != NULL) {
+    retire_start(SAIL_RETIRE_INSTR);
+    retire_varint(pc);
+    retire_varint(opcode);
+  }
+  return UNIT;
 }
 
-unit cycle_count(const unit u)
+unit retire_trace_reg_write(const mach_int reg, const fbits value)
 {
-  if (cycle_limit_reached(UNIT)) {
-    printf("\n[Sail] TIMEOUT: exceeded %" PRId64 " cycles\n", g_cycle_limit);
-    exit(EXIT_SUCCESS);
+  if (g_retire_file != NULL) {
+    retire_start(SAIL_RETIRE_REG_WRITE);
+    retire_varint((uint64_t)reg);
+    retire_varint(value);
   }
   return UNIT;
 }
 
+unit retire_trace_mem_read(const fbits addr, const fbits value, const mach_int bytes)
+{
+  if (g_retire_file != NULL) {
+    retire_start(SAIL_RETIRE_MEM_READ);
+    retire_varint(addr);
+    retire_varint((uint64_t)bytes);
+    retire_varint(value);
+  }
+  return UNIT;
+}
+
+unit retire_trace_mem_write(const fbits addr, const fbits value, const mach_int bytes)
+{
+  if (g_retire_file != NULL) {
+    retire_start(SAIL_RETIRE_MEM_WRITE);
+    retire_varint(addr);
+    retire_varint((uint64_t)bytes);
+    retire_varint(value);
+  }
+  return UNIT;
+}
+
+/* ***** Decoded-instruction cache ***** */
+
+/*
+ * Epoch zero marks a cache entry that has never been filled, so we
+ * start at one.
+ */
+uint64_t sail_decode_cache_epoch = 1;
+
+unit decode_cache_flush(const unit u)
+{
+  sail_decode_cache_epoch++;
+  return UNIT;
+}
+
+/* ***** Sampling profiler ***** */
+
+/*
+ * A SIGPROF handler samples the shadow stack maintained by models
+ * compiled with -c_shadow_stack. Samples are counted per distinct
+ * stack in a fixed size hash table, so the handler never allocates,
+ * and are written as folded stacks (one "f;g;h count" line per stack,
+ * outermost function first) when the model exits. This is the input
+ * format of flamegraph.pl and speedscope.
+ */
+
+volatile uint32_t sail_shadow_stack[SAIL_SHADOW_STACK_SIZE];
+volatile int sail_shadow_depth = 0;
+
+static const char *const *g_shadow_names = NULL;
+static int g_shadow_name_count = 0;
+
+void sail_shadow_stack_init(const char *const *names, int count)
+{
+  g_shadow_names = names;
+  g_shadow_name_count = count;
+}
+
+#define PROFILE_INTERVAL_USEC 1000
+#define PROFILE_MAX_DEPTH 256
+#define PROFILE_TABLE_SIZE (1 << 16)
+#define PROFILE_ARENA_SIZE (1 << 22)
+
+struct profile_entry {
+  uint64_t hash;
+  uint64_t count;
+  uint32_t offset;
+  uint32_t depth;
+  bool truncated;
+};
+
+static char *g_profile_filename = NULL;
+static struct profile_entry *g_profile_table = NULL;
+static uint32_t *g_profile_arena = NULL;
+static size_t g_profile_arena_len = 0;
+static uint64_t g_profile_samples = 0;
+static uint64_t g_profile_dropped = 0;
+
+static bool profile_entry_matches(struct profile_entry *entry, uint64_t hash, const uint32_t *frames, uint32_t depth, bool truncated)
+{
+  return entry->hash == hash
+    && entry->depth == depth
+    && entry->truncated == truncated
+    && memcmp(g_profile_arena + entry->offset, frames, depth * sizeof(uint32_t)) == 0;
+}
+
+static void profile_sample(int signum)
+{
+  uint32_t frames[PROFILE_MAX_DEPTH];
+  int depth = sail_shadow_depth;
+  bool truncated = false;
+
+  if (depth > SAIL_SHADOW_STACK_SIZE) {
+    depth = SAIL_SHADOW_STACK_SIZE;
+    truncated = true;
+  }
+  // Keep the innermost frames of very deep stacks
+  int start = 0;
+  if (depth > PROFILE_MAX_DEPTH) {
+    start = depth - PROFILE_MAX_DEPTH;
+    truncated = true;
+  }
+
+  uint64_t hash = 0xcbf29ce484222325ull;
+  uint32_t n = 0;
+  for (int i = start; i < depth; i++, n++) {
+    frames[n] = sail_shadow_stack[i];
+    hash = (hash ^ frames[n]) * 0x100000001b3ull;
+  }
+  hash ^= truncated;
+
+  g_profile_samples++;
+  for (size_t probe = 0; probe < PROFILE_TABLE_SIZE; probe++) {
+    struct profile_entry *entry = &g_profile_table[(hash + probe) & (PROFILE_TABLE_SIZE - 1)];
+    if (entry->count == 0) {
+      if (g_profile_arena_len + n > PROFILE_ARENA_SIZE) break;
+      memcpy(g_profile_arena + g_profile_arena_len, frames, n * sizeof(uint32_t));
+      entry->hash = hash;
+      entry->offset = (uint32_t)g_profile_arena_len;
+      entry->depth = n;
+      entry->truncated = truncated;
+      entry->count = 1;
+      g_profile_arena_len += n;
+      return;
+    } else if (profile_entry_matches(entry, hash, frames, n, truncated)) {
+      entry->count++;
+      return;
+    }
+  }
+  g_profile_dropped++;
+}
+
+static void profile_stop(void)
+{
+  struct itimerval timer = { { 0, 0 }, { 0, 0 } };
+  setitimer(ITIMER_PROF, &timer, NULL);
+  signal(SIGPROF, SIG_IGN);
+}
+
+static void profile_write(void)
+{
+  profile_stop();
+
+  FILE *fp = fopen(g_profile_filename, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "[Sail] Could not open profile file %s\n", g_profile_filename);
+    return;
+  }
+
+  for (size_t i = 0; i < PROFILE_TABLE_SIZE; i++) {
+    struct profile_entry *entry = &g_profile_table[i];
+    if (entry->count == 0) continue;
+
+    if (entry->truncated) fputs("[truncated];", fp);
+    if (entry->depth == 0) fputs("[unknown]", fp);
+    for (uint32_t j = 0; j < entry->depth; j++) {
+      uint32_t id = g_profile_arena[entry->offset + j];
+      if (j > 0) fputc(';', fp);
+      if (id < (uint32_t)g_shadow_name_count) {
+        fputs(g_shadow_names[id], fp);
+      } else {
+        fprintf(fp, "[function %" PRIu32 "]", id);
+      }
+    }
+    fprintf(fp, " %" PRIu64 "\n", entry->count);
+  }
+  fclose(fp);
+
+  if (g_profile_dropped > 0) {
+    fprintf(stderr, "[Sail] Profiler dropped %" PRIu64 " of %" PRIu64 " samples (too many distinct stacks)\n",
+            g_profile_dropped, g_profile_samples);
+  }
+}
+
+static void profile_start(const char *filename)
+{
+  if (g_shadow_names == NULL) {
+    fprintf(stderr, "Ignoring flag -P %s. Requires the model to be compiled with -c_shadow_stack\n", filename);
+    return;
+  }
+
+  if (g_profile_filename != NULL) {
+    free(g_profile_filename);
+  } else {
+    g_profile_table = (struct profile_entry *)calloc(PROFILE_TABLE_SIZE, sizeof(struct profile_entry));
+    g_profile_arena = (uint32_t *)malloc(PROFILE_ARENA_SIZE * sizeof(uint32_t));
+    atexit(profile_write);
+  }
+  g_profile_filename = strdup(filename);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = profile_sample;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, NULL);
+
+  struct itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = PROFILE_INTERVAL_USEC;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+/* ***** Exceptions with setjmp and longjmp ***** */
+
+struct sail_try_frame *sail_try_top = NULL;
+
+struct sail_cleanup *sail_cleanup_stack = NULL;
+size_t sail_cleanup_depth = 0;
+size_t sail_cleanup_capacity = 0;
+
+void sail_cleanup_grow(void)
+{
+  size_t capacity = sail_cleanup_capacity == 0 ? 256 : 2 * sail_cleanup_capacity;
+  size_t bytes = capacity * sizeof(struct sail_cleanup);
+  struct sail_cleanup *stack = (struct sail_cleanup *)realloc(sail_cleanup_stack, bytes);
+  if (stack == NULL) {
+    fprintf(stderr, "Could not grow the exception cleanup stack\n");
+    exit(EXIT_FAILURE);
+  }
+  sail_cleanup_stack = stack;
+  sail_cleanup_capacity = capacity;
+}
+
+void sail_throw(const_sail_string location)
+{
+  struct sail_try_frame *frame = sail_try_top;
+  size_t depth = frame == NULL ? 0 : frame->cleanup_depth;
+
+  while (sail_cleanup_depth > depth) {
+    struct sail_cleanup *entry = &sail_cleanup_stack[--sail_cleanup_depth];
+    if (entry->value != NULL) {
+      entry->kill(entry->value);
+    }
+  }
+
+  if (frame == NULL) {
+    fprintf(stderr, "Exiting due to uncaught exception: %s\n", location);
+    model_pre_exit();
+    exit(EXIT_FAILURE);
+  }
+
+  sail_shadow_depth = frame->shadow_depth;
+  sail_longjmp(frame->buf);
+}
+
+/* ***** ELF functions ***** */
+
+void elf_entry(sail_int *rop, const unit u)
+{
+  sail_int_set_ui(rop, g_elf_entry);
+}
+
+void elf_tohost(sail_int *rop, const unit u)
+{
+  sail_int_set_ui(rop, 0x0ul);
+}
+
+/* ***** Performance statistics ***** */
+
+/*
+ * With --stats or --stats-file the RTS reports the number of cycles
+ * executed, the wall clock time spent initialising the model,
+ * processing arguments (which includes loading ELF files and images),
+ * and running it, along with the resulting MIPS, peak RSS, and the
+ * number of memory blocks allocated. The report is written at exit,
+ * and every --stats-interval cycles as a single line.
+ */
+
+static bool g_stats_enabled = false;
+static char *g_stats_filename = NULL;
+static uint64_t g_stats_interval = 0;
+static uint64_t g_stats_next = UINT64_MAX;
+
+static double g_stats_init_start = 0.0;
+static double g_stats_load_start = 0.0;
+static double g_stats_run_start = 0.0;
+static double g_stats_run_end = 0.0;
+static uint64_t g_stats_memory_blocks = 0;
+static uint64_t g_stats_tag_blocks = 0;
+
+static double stats_now(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static double stats_mips(uint64_t cycles, double seconds)
+{
+  return seconds > 0.0 ? (double)cycles / seconds / 1e6 : 0.0;
+}
+
+static long stats_peak_rss_kib(void)
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+/*
+ * Called from cleanup_rts, before kill_mem frees the memory blocks we
+ * want to count.
+ */
+static void stats_end_run(void)
+{
+  if (g_stats_run_end != 0.0) return;
+  sync_cycle_count();
+  g_stats_run_end = stats_now();
+
+  g_stats_memory_blocks = 0;
+  for (struct block *b = sail_memory; b != NULL; b = b->next) g_stats_memory_blocks++;
+  g_stats_tag_blocks = 0;
+  for (struct tag_block *b = sail_tags; b != NULL; b = b->next) g_stats_tag_blocks++;
+}
+
+static void stats_report(void)
+{
+  stats_end_run();
+
+  double init = g_stats_load_start - g_stats_init_start;
+  double load = g_stats_run_start - g_stats_load_start;
+  double run = g_stats_run_end - g_stats_run_start;
+  double total = g_stats_run_end - g_stats_init_start;
+  long rss = stats_peak_rss_kib();
+
+  if (g_stats_enabled) {
+    fprintf(stderr, "[Sail] cycles: %" PRIu64 "\n", g_cycle_count);
+    fprintf(stderr, "[Sail] wall time: %.6fs (init %.6fs, load %.6fs, run %.6fs)\n", total, init, load, run);
+    fprintf(stderr, "[Sail] MIPS: %.3f\n", stats_mips(g_cycle_count, run));
+    fprintf(stderr, "[Sail] peak RSS: %ld KiB\n", rss);
+    fprintf(stderr, "[Sail] memory blocks: %" PRIu64 " (tag blocks: %" PRIu64 ")\n",
+            g_stats_memory_blocks, g_stats_tag_blocks);
+  }
+
+  if (g_stats_filename != NULL) {
+    FILE *fp = fopen(g_stats_filename, "w");
+    if (fp == NULL) {
+      fprintf(stderr, "[Sail] Could not open statistics file %s\n", g_stats_filename);
+      return;
+    }
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"cycles\": %" PRIu64 ",\n", g_cycle_count);
+    fprintf(fp, "  \"wall_seconds\": %.9f,\n", total);
+    fprintf(fp, "  \"init_seconds\": %.9f,\n", init);
+    fprintf(fp, "  \"load_seconds\": %.9f,\n", load);
+    fprintf(fp, "  \"run_seconds\": %.9f,\n", run);
+    fprintf(fp, "  \"mips\": %.6f,\n", stats_mips(g_cycle_count, run));
+    fprintf(fp, "  \"peak_rss_kib\": %ld,\n", rss);
+    fprintf(fp, "  \"memory_blocks\": %" PRIu64 ",\n", g_stats_memory_blocks);
+    fprintf(fp, "  \"tag_blocks\": %" PRIu64 "\n", g_stats_tag_blocks);
+    fprintf(fp, "}\n");
+    fclose(fp);
+  }
+}
+
+static void stats_periodic(void)
+{
+  static uint64_t last_cycles = 0;
+  static double last_time = 0.0;
+
+  double now = stats_now();
+  if (last_time == 0.0) last_time = g_stats_run_start;
+  fprintf(stderr, "[Sail] %" PRIu64 " cycles, %.3fs, %.3f MIPS\n",
+          g_cycle_count, now - g_stats_run_start, stats_mips(g_cycle_count - last_cycles, now - last_time));
+  last_cycles = g_cycle_count;
+  last_time = now;
+}
+
+/* ***** Cycle and time limits ***** */
+
+/* Must be called with g_cycle_count up to date */
+static void refill_cycle_budget(void)
+{
+  uint64_t next = g_cycle_count + CYCLE_POLL_INTERVAL;
+  if (g_stats_next < next) next = g_stats_next;
+  if (g_cycle_limit != 0 && g_cycle_limit < next) next = g_cycle_limit;
+  // Once the limit has been reached, every call should reach it again
+  if (next <= g_cycle_count) next = g_cycle_count + 1;
+
+  g_cycle_epoch = g_cycle_count;
+  g_cycle_refill = next - g_cycle_count;
+  sail_cycle_budget = g_cycle_refill;
+}
+
+bool sail_cycle_deadline(void)
+{
+  sync_cycle_count();
+
+  if (g_time_limit_reached) {
+    printf("\n[Sail] TIMEOUT: exceeded %" PRIu64 " seconds\n", g_time_limit);
+    model_pre_exit();
+    exit(EXIT_FAILURE);
+  }
+
+  if (g_cycle_count >= g_stats_next) {
+    stats_periodic();
+    g_stats_next += g_stats_interval;
+  }
+
+  refill_cycle_budget();
+  return g_cycle_limit != 0 && g_cycle_count >= g_cycle_limit;
+}
+
+void sail_cycle_limit_exit(void)
+{
+  printf("\n[Sail] TIMEOUT: exceeded %" PRId64 " cycles\n", g_cycle_limit);
+  model_pre_exit();
+  exit(EXIT_SUCCESS);
+}
+
 void get_cycle_count(sail_int *rop, const unit u)
 {
-    mpz_set_ui(*rop, g_cycle_count);
+  sync_cycle_count();
+  sail_int_set_ui(rop, g_cycle_count);
+}
+
+/*
+ * The first SIGALRM only sets a flag, which sail_cycle_deadline
+ * checks at least every CYCLE_POLL_INTERVAL cycles so the model can
+ * exit cleanly. If the model is not calling cycle_limit_reached, the
+ * next SIGALRM a second later terminates it immediately.
+ */
+static void time_limit_handler(int signum)
+{
+  if (g_time_limit_reached) {
+    static const char msg[] = "\n[Sail] TIMEOUT: model did not stop after reaching time limit\n";
+    if (write(STDERR_FILENO, msg, sizeof(msg) - 1)) {}
+    _exit(EXIT_FAILURE);
+  }
+  g_time_limit_reached = 1;
+}
+
+static void time_limit_start(void)
+{
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = time_limit_handler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGALRM, &action, NULL);
+
+  struct itimerval timer;
+  timer.it_value.tv_sec = (time_t)g_time_limit;
+  timer.it_value.tv_usec = 0;
+  timer.it_interval.tv_sec = 1;
+  timer.it_interval.tv_usec = 0;
+  setitimer(ITIMER_REAL, &timer, NULL);
 }
 
 /* ***** Argument Parsing ***** */
@@ -629,11 +1476,19 @@ void get_cycle_count(sail_int *rop, const unit u)
 static struct option options[] = {
   {"binary",     required_argument, 0, 'b'},
   {"cyclelimit", required_argument, 0, 'l'},
+  {"timelimit",  required_argument, 0, 't'},
   {"config",     required_argument, 0, 'C'},
   {"elf",        required_argument, 0, 'e'},
   {"entry",      required_argument, 0, 'n'},
   {"image",      required_argument, 0, 'i'},
   {"coverage",   required_argument, 0, 'c'},
+  {"coverage-binary", required_argument, 0, 'B'},
+  {"trace-file", required_argument, 0, 'T'},
+  {"retire-trace", required_argument, 0, 'R'},
+  {"profile",    required_argument, 0, 'P'},
+  {"stats",      no_argument,       0, 'S'},
+  {"stats-file", required_argument, 0, 'J'},
+  {"stats-interval", required_argument, 0, 'I'},
   {"verbosity",  required_argument, 0, 'v'},
   {"help",       no_argument,       0, 'h'},
   {0, 0, 0, 0}
@@ -655,9 +1510,11 @@ int process_arguments(int argc, char *argv[])
   bool     elf_entry_set = false;
   uint64_t elf_entry;
 
+  g_stats_load_start = stats_now();
+
   while (true) {
     int option_index = 0;
-    c = getopt_long(argc, argv, "e:n:i:b:l:C:c:v:h", options, &option_index);
+    c = getopt_long(argc, argv, "e:n:i:b:l:t:C:c:B:T:R:P:SJ:I:v:h", options, &option_index);
 
     if (c == -1) break;
 
@@ -677,10 +1534,11 @@ int process_arguments(int argc, char *argv[])
           return -1;
         };
 #ifdef HAVE_SETCONFIG
-        mpz_t s_value;
-        mpz_init_set_ui(s_value, value);
+        sail_int s_value;
+        CREATE(sail_int)(&s_value);
+        sail_int_set_ui(&s_value, value);
         z__SetConfig(arg, s_value);
-        mpz_clear(s_value);
+        KILL(sail_int)(&s_value);
 #else
         fprintf(stderr, "Ignoring flag -C %s", optarg);
 #endif
@@ -724,6 +1582,13 @@ int process_arguments(int argc, char *argv[])
       }
       break;
 
+    case 't':
+      if (!sscanf(optarg, "%" PRIu64, &g_time_limit)) {
+	fprintf(stderr, "Could not parse time limit %s\n", optarg);
+	return -1;
+      }
+      break;
+
     case 'c':
       if (sail_rts_set_coverage_file != NULL) {
         sail_rts_set_coverage_file(optarg);
@@ -732,6 +1597,42 @@ int process_arguments(int argc, char *argv[])
       }
       break;
 
+    case 'B':
+      if (sail_rts_set_coverage_binary_file != NULL) {
+        sail_rts_set_coverage_binary_file(optarg);
+      } else {
+        fprintf(stderr, "Ignoring flag -B %s. Requires the model to be compiled with coverage\n", optarg);
+      }
+      break;
+
+    case 'T':
+      trace_open(optarg);
+      break;
+
+    case 'R':
+      retire_open(optarg);
+      break;
+
+    case 'P':
+      profile_start(optarg);
+      break;
+
+    case 'S':
+      g_stats_enabled = true;
+      break;
+
+    case 'J':
+      free(g_stats_filename);
+      g_stats_filename = strdup(optarg);
+      break;
+
+    case 'I':
+      if (!sscanf(optarg, "%" PRIu64, &g_stats_interval)) {
+	fprintf(stderr, "Could not parse statistics interval %s\n", optarg);
+	return -1;
+      }
+      break;
+
     case 'v':
       if (!sscanf(optarg, "0x%" PRIx64, &g_verbosity)) {
        fprintf(stderr, "Could not parse verbosity flags %s\n", optarg);
@@ -757,6 +1658,15 @@ int process_arguments(int argc, char *argv[])
       g_elf_entry = elf_entry;
   }
 
+  if (g_stats_enabled || g_stats_filename != NULL) {
+    atexit(stats_report);
+    if (g_stats_interval != 0) g_stats_next = g_cycle_count + g_stats_interval;
+  }
+  sync_cycle_count();
+  refill_cycle_budget();
+  if (g_time_limit != 0) time_limit_start();
+  g_stats_run_start = stats_now();
+
   return 0;
 }
 
@@ -764,14 +1674,19 @@ int process_arguments(int argc, char *argv[])
 
 void setup_rts(void)
 {
+  g_stats_init_start = stats_now();
   disable_tracing(UNIT);
   setup_library();
 }
 
 void cleanup_rts(void)
 {
+  stats_end_run();
   cleanup_library();
   kill_mem();
+  free(sail_cleanup_stack);
+  sail_cleanup_stack = NULL;
+  sail_cleanup_capacity = 0;
 }
 
 #ifdef __cplusplus
@@ -69,6 +69,7 @@
 #define SAIL_RTS_H
 
 #include <inttypes.h>
+#include <setjmp.h>
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -114,15 +115,15 @@ uint64_t read_mem(uint64_t);
 // These memory builtins are intended to match the semantics for the
 // __ReadRAM and __WriteRAM functions in ASL.
 
-bool write_ram(const mpz_t addr_size,     // Either 32 or 64
-	       const mpz_t data_size_mpz, // Number of bytes
-	       const lbits hex_ram,       // Currently unused
+bool write_ram(const sail_int addr_size,     // Either 32 or 64
+	       const sail_int data_size_mpz, // Number of bytes
+	       const lbits hex_ram,          // Currently unused
 	       const lbits addr_bv,
 	       const lbits data);
 
 void read_ram(lbits *data,
-	      const mpz_t addr_size,
-	      const mpz_t data_size_mpz,
+	      const sail_int addr_size,
+	      const sail_int data_size_mpz,
 	      const lbits hex_ram,
 	      const lbits addr_bv);
 
@@ -139,15 +140,15 @@ void platform_read_mem(lbits *data,
                        const int read_kind,
                        const uint64_t addr_size,
                        const sbits addr,
-                       const mpz_t n);
+                       const sail_int n);
 unit platform_write_mem_ea(const int write_kind,
                            const uint64_t addr_size,
                            const sbits addr,
-                           const mpz_t n);
+                           const sail_int n);
 bool platform_write_mem(const int write_kind,
                         const uint64_t addr_size,
                         const sbits addr,
-                        const mpz_t n,
+                        const sail_int n,
                         const lbits data);
 bool platform_excl_res(const unit unit);
 unit platform_barrier();
@@ -157,26 +158,26 @@ unit platform_barrier();
 void emulator_read_mem(lbits *data,
                        const uint64_t addr_size,
                        const sbits addr,
-                       const mpz_t n);
+                       const sail_int n);
 
 void emulator_read_mem_ifetch(lbits *data,
                               const uint64_t addr_size,
                               const sbits addr,
-                              const mpz_t n);
+                              const sail_int n);
 
 void emulator_read_mem_exclusive(lbits *data,
                                  const uint64_t addr_size,
                                  const sbits addr,
-                                 const mpz_t n);
+                                 const sail_int n);
 
 bool emulator_write_mem(const uint64_t addr_size,
                         const sbits addr,
-                        const mpz_t n,
+                        const sail_int n,
                         const lbits data);
 
 bool emulator_write_mem_exclusive(const uint64_t addr_size,
                                   const sbits addr,
-                                  const mpz_t n,
+                                  const sail_int n,
                                   const lbits data);
 
 unit load_raw(fbits addr, const_sail_string file);
@@ -212,6 +213,10 @@ bool is_tracing(const unit);
  * TYPE are zencoded. trace_start(NAME) and trace_end() are called
  * before printing the function arguments and return value
  * respectively.
+ *
+ * When the model is run with --trace-file FILE these write compact
+ * binary records to FILE instead, which can be turned back into the
+ * text format using the sailtrace tool.
 */
 void trace_sail_int(const sail_int);
 void trace_bool(const bool);
@@ -227,15 +232,229 @@ void trace_retend(void);
 void trace_start(char *);
 void trace_end(void);
 
+/*
+ * An instruction retire trace, for comparing a model against RTL or
+ * another simulator. When the model is run with --retire-trace FILE
+ * these append compact binary records to FILE (compressed if it ends
+ * in .gz), otherwise they do nothing. A model should call
+ * retire_trace_instr once per retired instruction, followed by the
+ * register writes and memory accesses it performed. The sailtrace
+ * tool can print the trace as text. See lib/retire_trace.sail for
+ * the Sail declarations.
+ */
+bool retire_trace_enabled(const unit);
+unit retire_trace_instr(const fbits pc, const fbits opcode);
+unit retire_trace_reg_write(const mach_int reg, const fbits value);
+unit retire_trace_mem_read(const fbits addr, const fbits value, const mach_int bytes);
+unit retire_trace_mem_write(const fbits addr, const fbits value, const mach_int bytes);
+
+/*
+ * Decoded-instruction cache. A function marked with the decode_cache
+ * attribute (or named with -c_decode_cache) is memoized in a
+ * direct-mapped table of SAIL_DECODE_CACHE_SIZE entries indexed by a
+ * hash of its bitvector argument. Every entry records the epoch it
+ * was filled in, so decode_cache_flush invalidates all the caches at
+ * once by starting a new epoch. The cache is keyed by the opcode
+ * rather than the address it was fetched from, so writes to memory
+ * never make it stale. A model needs to flush it only when something
+ * else the decode function reads changes, such as the set of enabled
+ * extensions. See lib/decode_cache.sail for the Sail declaration.
+ */
+#ifndef SAIL_DECODE_CACHE_BITS
+#define SAIL_DECODE_CACHE_BITS 12
+#endif
+
+#define SAIL_DECODE_CACHE_SIZE ((size_t)1 << SAIL_DECODE_CACHE_BITS)
+
+extern uint64_t sail_decode_cache_epoch;
+
+static inline size_t sail_decode_cache_index(uint64_t key)
+{
+  return (size_t)((key * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - SAIL_DECODE_CACHE_BITS));
+}
+
+unit decode_cache_flush(const unit u);
+
+/*
+ * A shadow stack of the Sail functions currently executing, used by
+ * the sampling profiler (--profile FILE). When compiled with
+ * -c_shadow_stack every generated function starts with
+ * SAIL_SHADOW_FRAME(id), which pushes id and pops it again on every
+ * path out of the function using the GCC/Clang cleanup attribute.
+ * Frames beyond SAIL_SHADOW_STACK_SIZE are counted but not recorded.
+ * The model is single threaded, so there is one stack per process.
+ */
+#define SAIL_SHADOW_STACK_SIZE 1024
+
+extern volatile uint32_t sail_shadow_stack[SAIL_SHADOW_STACK_SIZE];
+extern volatile int sail_shadow_depth;
+
+static inline int sail_shadow_push(uint32_t id)
+{
+  int depth = sail_shadow_depth;
+  if (depth < SAIL_SHADOW_STACK_SIZE) {
+    sail_shadow_stack[depth] = id;
+  }
+  sail_shadow_depth = depth + 1;
+  return depth;
+}
+
+static inline void sail_shadow_pop(int *depth)
+{
+  sail_shadow_depth = *depth;
+}
+
+#define SAIL_SHADOW_FRAME(id) \
+  int sail_shadow_frame __attribute__((cleanup(sail_shadow_pop), unused)) = sail_shadow_push(id)
+
+/*
+ * Called from model_init with the table of Sail function names
+ * indexed by the ids passed to SAIL_SHADOW_FRAME.
+ */
+void sail_shadow_stack_init(const char *const *names, int count);
+
+/*
+ * Exceptions for models compiled with -c_setjmp_exceptions. Rather
+ * than checking have_exception after every call that can throw, each
+ * try block pushes a frame with SAIL_TRY_FRAME and calls sail_setjmp,
+ * and sail_throw longjmps to the innermost frame. The frame is popped
+ * on every path out of the try block using the GCC/Clang cleanup
+ * attribute.
+ *
+ * Heap-allocated locals are registered on a cleanup stack between
+ * their CREATE and KILL, so sail_throw can free those belonging to
+ * the frames it unwinds. With -O most of these are hoisted out of
+ * functions and never registered. Entries are usually killed in the
+ * reverse order they were created, so sail_cleanup_pop only has to
+ * look at the top of the stack.
+ *
+ * Define SAIL_BUILTIN_SETJMP when compiling both the model and the
+ * RTS to use the cheaper __builtin_setjmp and __builtin_longjmp,
+ * which only save the frame pointer, stack pointer, and resume
+ * address.
+ */
+#ifdef SAIL_BUILTIN_SETJMP
+typedef void *sail_jmp_buf[5];
+#define sail_setjmp(buf) __builtin_setjmp(buf)
+#define sail_longjmp(buf) __builtin_longjmp(buf, 1)
+#else
+typedef jmp_buf sail_jmp_buf;
+#define sail_setjmp(buf) setjmp(buf)
+#define sail_longjmp(buf) longjmp(buf, 1)
+#endif
+
+struct sail_try_frame {
+  sail_jmp_buf buf;
+  struct sail_try_frame *prev;
+  size_t cleanup_depth;
+  int shadow_depth;
+};
+
+struct sail_cleanup {
+  void *value;
+  void (*kill)(void *);
+};
+
+extern struct sail_try_frame *sail_try_top;
+
+extern struct sail_cleanup *sail_cleanup_stack;
+extern size_t sail_cleanup_depth;
+extern size_t sail_cleanup_capacity;
+
+static inline void sail_try_enter(struct sail_try_frame *frame)
+{
+  frame->prev = sail_try_top;
+  frame->cleanup_depth = sail_cleanup_depth;
+  frame->shadow_depth = sail_shadow_depth;
+  sail_try_top = frame;
+}
+
+static inline void sail_try_leave(struct sail_try_frame *frame)
+{
+  sail_try_top = frame->prev;
+}
+
+#define SAIL_TRY_FRAME(frame)                                                \
+  struct sail_try_frame frame __attribute__((cleanup(sail_try_leave)));     \
+  sail_try_enter(&frame)
+
+void sail_cleanup_grow(void);
+
+static inline void sail_cleanup_push(void *value, void (*kill)(void *))
+{
+  if (sail_cleanup_depth == sail_cleanup_capacity) {
+    sail_cleanup_grow();
+  }
+  sail_cleanup_stack[sail_cleanup_depth].value = value;
+  sail_cleanup_stack[sail_cleanup_depth].kill = kill;
+  sail_cleanup_depth++;
+}
+
+/*
+ * The kill functions registered for the builtin types. The C backend
+ * defines sail_cleanup_kill_T for each type T it generates.
+ */
+#define SAIL_CLEANUP_KILL(type)                                       \
+  static inline void sail_cleanup_kill_##type(void *value)            \
+  {                                                                   \
+    KILL(type)((type *)value);                                        \
+  }
+
+SAIL_CLEANUP_KILL(sail_int)
+SAIL_CLEANUP_KILL(lbits)
+SAIL_CLEANUP_KILL(sail_string)
+SAIL_CLEANUP_KILL(real)
+
+static inline void sail_cleanup_pop(void *value)
+{
+  size_t i = sail_cleanup_depth;
+  while (i > 0 && sail_cleanup_stack[i - 1].value != value) {
+    i--;
+  }
+  if (i == 0) return;
+  sail_cleanup_stack[i - 1].value = NULL;
+  while (sail_cleanup_depth > 0 && sail_cleanup_stack[sail_cleanup_depth - 1].value == NULL) {
+    sail_cleanup_depth--;
+  }
+}
+
+/*
+ * Kill the heap-allocated locals registered since the innermost try
+ * frame was entered, and longjmp to it. current_exception and
+ * have_exception must already be set. If there is no try frame, the
+ * exception is uncaught, so print where it was thrown, call
+ * model_pre_exit, and exit.
+ */
+void sail_throw(const_sail_string location) __attribute__((noreturn));
+
 /*
  * Functions for counting and limiting cycles
+ *
+ * The cycle count is kept as a budget that is counted down, so the
+ * common case of cycle_limit_reached is a decrement and test of a
+ * global. sail_cycle_deadline handles the cycle limit (--cyclelimit),
+ * periodic statistics, and the time limit (--timelimit) when it runs
+ * out, and returns true if the cycle limit has been reached.
  */
+extern uint64_t sail_cycle_budget;
+
+bool sail_cycle_deadline(void);
+
+// print a timeout message, call model_pre_exit, and exit
+void sail_cycle_limit_exit(void) __attribute__((noreturn, cold));
 
 // increment cycle count and test if over limit
-bool cycle_limit_reached(const unit);
+static inline bool cycle_limit_reached(const unit u)
+{
+  return __builtin_expect(--sail_cycle_budget == 0, 0) && sail_cycle_deadline();
+}
 
-// increment cycle count and abort if over
-unit cycle_count(const unit);
+// increment cycle count and exit if over
+static inline unit cycle_count(const unit u)
+{
+  if (cycle_limit_reached(UNIT)) sail_cycle_limit_exit();
+  return UNIT;
+}
 
 // read cycle count
 void get_cycle_count(sail_int *rop, const unit);
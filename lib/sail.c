@@ -76,6 +76,10 @@
 #include<string.h>
 #include<time.h>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include<immintrin.h>
+#endif
+
 #include"sail.h"
 
 #ifdef __cplusplus
@@ -92,7 +96,7 @@ uint64_t bzhi_u64(uint64_t bits, uint64_t len)
  * Temporary mpzs for use in functions below. To avoid conflicts, only
  * use in functions that do not call other functions in this file.
  */
-static sail_int sail_lib_tmp1, sail_lib_tmp2, sail_lib_tmp3;
+static mpz_t sail_lib_tmp1, sail_lib_tmp2, sail_lib_tmp3;
 static real sail_lib_tmp_real;
 
 #define FLOAT_PRECISION 255
@@ -100,10 +104,16 @@ static real sail_lib_tmp_real;
 void setup_library(void)
 {
   srand(0x0);
+#ifdef SAIL_POOL_ALLOC
+  setup_pool_alloc();
+#endif
   mpz_init(sail_lib_tmp1);
   mpz_init(sail_lib_tmp2);
   mpz_init(sail_lib_tmp3);
   mpq_init(sail_lib_tmp_real);
+#ifdef SAIL_HYBRID_INT
+  setup_hybrid_int();
+#endif
   mpf_set_default_prec(FLOAT_PRECISION);
 }
 
@@ -113,6 +123,9 @@ void cleanup_library(void)
   mpz_clear(sail_lib_tmp2);
   mpz_clear(sail_lib_tmp3);
   mpq_clear(sail_lib_tmp_real);
+#ifdef SAIL_HYBRID_INT
+  cleanup_hybrid_int();
+#endif
 }
 
 bool EQUAL(unit)(const unit a, const unit b)
@@ -167,7 +180,7 @@ void RECREATE(sail_string)(sail_string *str)
 void COPY(sail_string)(sail_string *str1, const_sail_string str2)
 {
   size_t len = strlen(str2);
-  *str1 = (sail_string)realloc(*str1, len + 1);
+  *str1 = (sail_string)sail_realloc(*str1, len + 1);
   *str1 = strcpy(*str1, str2);
 }
 
@@ -176,22 +189,22 @@ void KILL(sail_string)(sail_string *str)
   sail_free(*str);
 }
 
-void dec_str(sail_string *str, const mpz_t n)
+void dec_str(sail_string *str, const sail_int n)
 {
   sail_free(*str);
-  gmp_asprintf(str, "%Zd", n);
+  gmp_asprintf(str, "%Zd", sail_int_as_mpz(sail_lib_tmp1, n));
 }
 
-void hex_str(sail_string *str, const mpz_t n)
+void hex_str(sail_string *str, const sail_int n)
 {
   sail_free(*str);
-  gmp_asprintf(str, "0x%Zx", n);
+  gmp_asprintf(str, "0x%Zx", sail_int_as_mpz(sail_lib_tmp1, n));
 }
 
-void hex_str_upper(sail_string *str, const mpz_t n)
+void hex_str_upper(sail_string *str, const sail_int n)
 {
   sail_free(*str);
-  gmp_asprintf(str, "0x%ZX", n);
+  gmp_asprintf(str, "0x%ZX", sail_int_as_mpz(sail_lib_tmp1, n));
 }
 
 bool eq_string(const_sail_string str1, const_sail_string str2)
@@ -208,7 +221,7 @@ void undefined_string(sail_string *str, const unit u) {}
 
 void concat_str(sail_string *stro, const_sail_string str1, const_sail_string str2)
 {
-  *stro = (sail_string)realloc(*stro, strlen(str1) + strlen(str2) + 1);
+  *stro = (sail_string)sail_realloc(*stro, strlen(str1) + strlen(str2) + 1);
   (*stro)[0] = '\0';
   strcat(*stro, str1);
   strcat(*stro, str2);
@@ -221,7 +234,7 @@ bool string_startswith(const_sail_string s, const_sail_string prefix)
 
 void string_length(sail_int *len, const_sail_string s)
 {
-  mpz_set_ui(*len, strlen(s));
+  sail_int_set_ui(len, strlen(s));
 }
 
 void string_drop(sail_string *dst, const_sail_string s, sail_int ns)
@@ -229,11 +242,11 @@ void string_drop(sail_string *dst, const_sail_string s, sail_int ns)
   size_t len = strlen(s);
   mach_int n = CREATE_OF(mach_int, sail_int)(ns);
   if (len >= n) {
-    *dst = (sail_string)realloc(*dst, (len - n) + 1);
+    *dst = (sail_string)sail_realloc(*dst, (len - n) + 1);
     memcpy(*dst, s + n, len - n);
     (*dst)[len - n] = '\0';
   } else {
-    *dst = (sail_string)realloc(*dst, 1);
+    *dst = (sail_string)sail_realloc(*dst, 1);
     **dst = '\0';
   }
 }
@@ -248,24 +261,19 @@ void string_take(sail_string *dst, const_sail_string s, sail_int ns)
   } else {
     to_copy = n;
   }
-  *dst = (sail_string)realloc(*dst, to_copy + 1);
+  *dst = (sail_string)sail_realloc(*dst, to_copy + 1);
   memcpy(*dst, s, to_copy);
   (*dst)[to_copy] = '\0';
 }
 
 /* ***** Sail integers ***** */
 
-uint64_t sail_int_get_ui(const mpz_t op)
-{
-  return mpz_get_ui(op);
-}
-
 bool EQUAL(mach_int)(const mach_int op1, const mach_int op2)
 {
   return op1 == op2;
 }
 
-#ifndef USE_INT128
+#if !defined(USE_INT128) && !defined(SAIL_HYBRID_INT)
 
 void COPY(sail_int)(sail_int *rop, const sail_int op)
 {
@@ -312,7 +320,7 @@ void CONVERT_OF(sail_int, sail_string)(sail_int *rop, const_sail_string str)
   mpz_set_str(*rop, str, 10);
 }
 
-void RECREATE_OF(sail_int, sail_string)(mpz_t *rop, const_sail_string str)
+void RECREATE_OF(sail_int, sail_string)(sail_int *rop, const_sail_string str)
 {
   mpz_set_str(*rop, str, 10);
 }
@@ -342,17 +350,17 @@ bool lt(const sail_int op1, const sail_int op2)
   return mpz_cmp(op1, op2) < 0;
 }
 
-bool gt(const mpz_t op1, const mpz_t op2)
+bool gt(const sail_int op1, const sail_int op2)
 {
   return mpz_cmp(op1, op2) > 0;
 }
 
-bool lteq(const mpz_t op1, const mpz_t op2)
+bool lteq(const sail_int op1, const sail_int op2)
 {
   return mpz_cmp(op1, op2) <= 0;
 }
 
-bool gteq(const mpz_t op1, const mpz_t op2)
+bool gteq(const sail_int op1, const sail_int op2)
 {
   return mpz_cmp(op1, op2) >= 0;
 }
@@ -405,7 +413,7 @@ void sub_int(sail_int *rop, const sail_int op1, const sail_int op2)
 void sub_nat(sail_int *rop, const sail_int op1, const sail_int op2)
 {
   mpz_sub(*rop, op1, op2);
-  if (mpz_cmp_ui(*rop, 0) < 0ul) {
+  if (mpz_sgn(*rop) < 0) {
     mpz_set_ui(*rop, 0ul);
   }
 }
@@ -511,6 +519,7 @@ bool EQUAL(ref_fbits)(const fbits *op1, const fbits *op2)
   return *op1 == *op2;
 }
 
+#ifndef SAIL_LIMB_LBITS
 void CREATE(lbits)(lbits *rop)
 {
   rop->bits = (mpz_t *)sail_malloc(sizeof(mpz_t));
@@ -555,6 +564,7 @@ sbits CREATE_OF(sbits, lbits)(const lbits op, const bool direction)
   rop.len = op.len;
   return rop;
 }
+#endif
 
 sbits CREATE_OF(sbits, fbits)(const fbits op, const uint64_t len, const bool direction)
 {
@@ -564,6 +574,7 @@ sbits CREATE_OF(sbits, fbits)(const fbits op, const uint64_t len, const bool dir
   return rop;
 }
 
+#ifndef SAIL_LIMB_LBITS
 void RECREATE_OF(lbits, fbits)(lbits *rop, const uint64_t op, const uint64_t len, const bool direction)
 {
   rop->len = len;
@@ -582,19 +593,23 @@ void RECREATE_OF(lbits, sbits)(lbits *rop, const sbits op, const bool direction)
   rop->len = op.len;
   mpz_set_ui(*rop->bits, op.bits);
 }
+#endif
 
 // Bitvector conversions
 
+#ifndef SAIL_LIMB_LBITS
 fbits CONVERT_OF(fbits, lbits)(const lbits op, const bool direction)
 {
   return mpz_get_ui(*op.bits);
 }
+#endif
 
 fbits CONVERT_OF(fbits, sbits)(const sbits op, const bool direction)
 {
   return op.bits;
 }
 
+#ifndef SAIL_LIMB_LBITS
 void CONVERT_OF(lbits, fbits)(lbits *rop, const fbits op, const uint64_t len, const bool direction)
 {
   rop->len = len;
@@ -607,6 +622,7 @@ void CONVERT_OF(lbits, sbits)(lbits *rop, const sbits op, const bool direction)
   rop->len = op.len;
   mpz_set_ui(*rop->bits, op.bits & safe_rshift(UINT64_MAX, 64 - op.len));
 }
+#endif
 
 sbits CONVERT_OF(sbits, fbits)(const fbits op, const uint64_t len, const bool direction)
 {
@@ -616,6 +632,7 @@ sbits CONVERT_OF(sbits, fbits)(const fbits op, const uint64_t len, const bool di
   return rop;
 }
 
+#ifndef SAIL_LIMB_LBITS
 sbits CONVERT_OF(sbits, lbits)(const lbits op, const bool direction)
 {
   sbits rop;
@@ -623,6 +640,7 @@ sbits CONVERT_OF(sbits, lbits)(const lbits op, const bool direction)
   rop.bits = mpz_get_ui(*op.bits);
   return rop;
 }
+#endif
 
 void UNDEFINED(lbits)(lbits *rop, const sail_int len)
 {
@@ -648,6 +666,16 @@ fbits safe_rshift(const fbits x, const fbits n)
   }
 }
 
+fbits safe_lshift(const fbits x, const fbits n)
+{
+  if (n >= 64) {
+    return 0ul;
+  } else {
+    return x << n;
+  }
+}
+
+#ifndef SAIL_LIMB_LBITS
 void normalize_lbits(lbits *rop) {
   /* TODO optimisation: keep a set of masks of various sizes handy */
   mpz_set_ui(sail_lib_tmp1, 1);
@@ -663,6 +691,17 @@ void append_64(lbits *rop, const lbits op, const fbits chunk)
   mpz_add_ui(*rop->bits, *rop->bits, chunk);
 }
 
+fbits get_lbits_word(const lbits op, const uint64_t n)
+{
+#if GMP_NUMB_BITS == 64
+  return mpz_getlimbn(*op.bits, n);
+#else
+  mpz_fdiv_q_2exp(sail_lib_tmp1, *op.bits, 64 * n);
+  mpz_fdiv_r_2exp(sail_lib_tmp1, sail_lib_tmp1, 64);
+  return mpz_get_ui(sail_lib_tmp1);
+#endif
+}
+
 void add_bits(lbits *rop, const lbits op1, const lbits op2)
 {
   rop->len = op1.len;
@@ -678,17 +717,17 @@ void sub_bits(lbits *rop, const lbits op1, const lbits op2)
   normalize_lbits(rop);
 }
 
-void add_bits_int(lbits *rop, const lbits op1, const mpz_t op2)
+void add_bits_int(lbits *rop, const lbits op1, const sail_int op2)
 {
   rop->len = op1.len;
-  mpz_add(*rop->bits, *op1.bits, op2);
+  mpz_add(*rop->bits, *op1.bits, sail_int_as_mpz(sail_lib_tmp1, op2));
   normalize_lbits(rop);
 }
 
-void sub_bits_int(lbits *rop, const lbits op1, const mpz_t op2)
+void sub_bits_int(lbits *rop, const lbits op1, const sail_int op2)
 {
   rop->len = op1.len;
-  mpz_sub(*rop->bits, *op1.bits, op2);
+  mpz_sub(*rop->bits, *op1.bits, sail_int_as_mpz(sail_lib_tmp1, op2));
   normalize_lbits(rop);
 }
 
@@ -722,18 +761,64 @@ void not_bits(lbits *rop, const lbits op)
   }
 }
 
+/*
+ * The lane-wise kernels compute each lane independently, by clearing
+ * the top bit of every lane before the add or subtract, so no carry or
+ * borrow crosses a lane boundary, and then fixing up the top bits.
+ */
+static void lane_high_bits(mpz_t rop, const uint64_t len, const uint64_t lane)
+{
+  mpz_set_ui(rop, 0);
+  for (uint64_t i = lane - 1; i < len; i += lane) {
+    mpz_setbit(rop, i);
+  }
+}
+
+void add_lanes(lbits *rop, const lbits op1, const lbits op2, const mach_int lane)
+{
+  assert(op1.len == op2.len);
+  lane_high_bits(sail_lib_tmp1, op1.len, (uint64_t) lane);
+  // (op1 & ~high) + (op2 & ~high)
+  mpz_and(sail_lib_tmp2, *op1.bits, sail_lib_tmp1);
+  mpz_xor(sail_lib_tmp2, sail_lib_tmp2, *op1.bits);
+  mpz_and(sail_lib_tmp3, *op2.bits, sail_lib_tmp1);
+  mpz_xor(sail_lib_tmp3, sail_lib_tmp3, *op2.bits);
+  mpz_add(sail_lib_tmp2, sail_lib_tmp2, sail_lib_tmp3);
+  // ^ ((op1 ^ op2) & high)
+  mpz_xor(sail_lib_tmp3, *op1.bits, *op2.bits);
+  mpz_and(sail_lib_tmp3, sail_lib_tmp3, sail_lib_tmp1);
+  rop->len = op1.len;
+  mpz_xor(*rop->bits, sail_lib_tmp2, sail_lib_tmp3);
+  normalize_lbits(rop);
+}
+
+void sub_lanes(lbits *rop, const lbits op1, const lbits op2, const mach_int lane)
+{
+  assert(op1.len == op2.len);
+  lane_high_bits(sail_lib_tmp1, op1.len, (uint64_t) lane);
+  // (op1 | high) - (op2 & ~high)
+  mpz_ior(sail_lib_tmp2, *op1.bits, sail_lib_tmp1);
+  mpz_and(sail_lib_tmp3, *op2.bits, sail_lib_tmp1);
+  mpz_xor(sail_lib_tmp3, sail_lib_tmp3, *op2.bits);
+  mpz_sub(sail_lib_tmp2, sail_lib_tmp2, sail_lib_tmp3);
+  // ^ ((op1 ^ ~op2) & high)
+  mpz_xor(sail_lib_tmp3, *op1.bits, *op2.bits);
+  mpz_and(sail_lib_tmp3, sail_lib_tmp3, sail_lib_tmp1);
+  mpz_xor(sail_lib_tmp3, sail_lib_tmp3, sail_lib_tmp1);
+  rop->len = op1.len;
+  mpz_xor(*rop->bits, sail_lib_tmp2, sail_lib_tmp3);
+  normalize_lbits(rop);
+}
+
+static void mpz_signed_lbits(mpz_t rop, const lbits op);
+
 void mults_vec(lbits *rop, const lbits op1, const lbits op2)
 {
-  mpz_t op1_int, op2_int;
-  mpz_init(op1_int);
-  mpz_init(op2_int);
-  sail_signed(&op1_int, op1);
-  sail_signed(&op2_int, op2);
+  mpz_signed_lbits(sail_lib_tmp2, op1);
+  mpz_signed_lbits(sail_lib_tmp3, op2);
   rop->len = op1.len * 2;
-  mpz_mul(*rop->bits, op1_int, op2_int);
+  mpz_mul(*rop->bits, sail_lib_tmp2, sail_lib_tmp3);
   normalize_lbits(rop);
-  mpz_clear(op1_int);
-  mpz_clear(op2_int);
 }
 
 void mult_vec(lbits *rop, const lbits op1, const lbits op2)
@@ -746,26 +831,28 @@ void mult_vec(lbits *rop, const lbits op1, const lbits op2)
 
 void zeros(lbits *rop, const sail_int op)
 {
-  rop->len = mpz_get_ui(op);
+  rop->len = sail_int_get_ui(op);
   mpz_set_ui(*rop->bits, 0);
 }
 
 void zero_extend(lbits *rop, const lbits op, const sail_int len)
 {
-  assert(op.len <= mpz_get_ui(len));
-  rop->len = mpz_get_ui(len);
+  assert(op.len <= sail_int_get_ui(len));
+  rop->len = sail_int_get_ui(len);
   mpz_set(*rop->bits, *op.bits);
 }
+#endif
 
 fbits fast_zero_extend(const sbits op, const uint64_t n)
 {
   return op.bits;
 }
 
+#ifndef SAIL_LIMB_LBITS
 void sign_extend(lbits *rop, const lbits op, const sail_int len)
 {
-  assert(op.len <= mpz_get_ui(len));
-  rop->len = mpz_get_ui(len);
+  assert(op.len <= sail_int_get_ui(len));
+  rop->len = sail_int_get_ui(len);
   if(mpz_tstbit(*op.bits, op.len - 1)) {
     mpz_set(*rop->bits, *op.bits);
     for(mp_bitcnt_t i = rop->len - 1; i >= op.len; i--) {
@@ -775,6 +862,7 @@ void sign_extend(lbits *rop, const lbits op, const sail_int len)
     mpz_set(*rop->bits, *op.bits);
   }
 }
+#endif
 
 fbits fast_sign_extend(const fbits op, const uint64_t n, const uint64_t m)
 {
@@ -804,16 +892,17 @@ fbits fast_sign_extend2(const sbits op, const uint64_t m)
 
 void length_lbits(sail_int *rop, const lbits op)
 {
-  mpz_set_ui(*rop, op.len);
+  sail_int_set_ui(rop, op.len);
 }
 
+#ifndef SAIL_LIMB_LBITS
 void count_leading_zeros(sail_int *rop, const lbits op)
 {
   if (mpz_cmp_ui(*op.bits, 0) == 0) {
-    mpz_set_ui(*rop, op.len);
+    sail_int_set_ui(rop, op.len);
   } else {
     size_t bits = mpz_sizeinbase(*op.bits, 2);
-    mpz_set_ui(*rop, op.len - bits);
+    sail_int_set_ui(rop, op.len - bits);
   }
 }
 
@@ -825,6 +914,7 @@ bool eq_bits(const lbits op1, const lbits op2)
   }
   return true;
 }
+#endif
 
 bool EQUAL(lbits)(const lbits op1, const lbits op2)
 {
@@ -836,6 +926,7 @@ bool EQUAL(ref_lbits)(const lbits *op1, const lbits *op2)
   return eq_bits(*op1, *op2);
 }
 
+#ifndef SAIL_LIMB_LBITS
 bool neq_bits(const lbits op1, const lbits op2)
 {
   assert(op1.len == op2.len);
@@ -850,8 +941,8 @@ void vector_subrange_lbits(lbits *rop,
                            const sail_int n_mpz,
                            const sail_int m_mpz)
 {
-  uint64_t n = mpz_get_ui(n_mpz);
-  uint64_t m = mpz_get_ui(m_mpz);
+  uint64_t n = sail_int_get_ui(n_mpz);
+  uint64_t m = sail_int_get_ui(m_mpz);
 
   rop->len = n - (m - 1ul);
   mpz_fdiv_q_2exp(*rop->bits, *op.bits, m);
@@ -863,8 +954,8 @@ void vector_subrange_inc_lbits(lbits *rop,
 			       const sail_int n_mpz,
 			       const sail_int m_mpz)
 {
-  uint64_t n = mpz_get_ui(n_mpz);
-  uint64_t m = mpz_get_ui(m_mpz);
+  uint64_t n = sail_int_get_ui(n_mpz);
+  uint64_t m = sail_int_get_ui(m_mpz);
 
   rop->len = m - (n - 1ul);
   mpz_fdiv_q_2exp(*rop->bits, *op.bits, (op.len - 1) - m);
@@ -873,15 +964,15 @@ void vector_subrange_inc_lbits(lbits *rop,
 
 void sail_truncate(lbits *rop, const lbits op, const sail_int len)
 {
-  assert(op.len >= mpz_get_ui(len));
-  rop->len = mpz_get_ui(len);
+  assert(op.len >= sail_int_get_ui(len));
+  rop->len = sail_int_get_ui(len);
   mpz_set(*rop->bits, *op.bits);
   normalize_lbits(rop);
 }
 
 void sail_truncateLSB(lbits *rop, const lbits op, const sail_int len)
 {
-  uint64_t rlen = mpz_get_ui(len);
+  uint64_t rlen = sail_int_get_ui(len);
   assert(op.len >= rlen);
   rop->len = rlen;
   // similar to vector_subrange_lbits above -- right shift LSBs away
@@ -891,15 +982,16 @@ void sail_truncateLSB(lbits *rop, const lbits op, const sail_int len)
 
 fbits bitvector_access(const lbits op, const sail_int n_mpz)
 {
-  uint64_t n = mpz_get_ui(n_mpz);
+  uint64_t n = sail_int_get_ui(n_mpz);
   return (fbits) mpz_tstbit(*op.bits, n);
 }
 
 fbits bitvector_access_inc(const lbits op, const sail_int n_mpz)
 {
-  uint64_t n = mpz_get_ui(n_mpz);
+  uint64_t n = sail_int_get_ui(n_mpz);
   return (fbits) mpz_tstbit(*op.bits, (op.len - 1) - n);
 }
+#endif
 
 fbits update_fbits(const fbits op, const uint64_t n, const fbits bit)
 {
@@ -910,30 +1002,47 @@ fbits update_fbits(const fbits op, const uint64_t n, const fbits bit)
      }
 }
 
+fbits fast_reverse_endianness(const fbits op, const uint64_t len)
+{
+  uint64_t x = op;
+  x = (x & 0xFFFFFFFF00000000) >> 32 | (x & 0x00000000FFFFFFFF) << 32;
+  x = (x & 0xFFFF0000FFFF0000) >> 16 | (x & 0x0000FFFF0000FFFF) << 16;
+  x = (x & 0xFF00FF00FF00FF00) >> 8  | (x & 0x00FF00FF00FF00FF) << 8;
+  return safe_rshift(x, 64 - len);
+}
+
+#ifndef SAIL_LIMB_LBITS
 void sail_unsigned(sail_int *rop, const lbits op)
 {
   /* Normal form of bv_t is always positive so just return the bits. */
-  mpz_set(*rop, *op.bits);
+  sail_int_set_mpz(rop, *op.bits);
 }
 
-void sail_signed(sail_int *rop, const lbits op)
+static void mpz_signed_lbits(mpz_t rop, const lbits op)
 {
   if (op.len == 0) {
-    mpz_set_ui(*rop, 0);
+    mpz_set_ui(rop, 0);
   } else {
     mp_bitcnt_t sign_bit = op.len - 1;
-    mpz_set(*rop, *op.bits);
+    mpz_set(rop, *op.bits);
     if (mpz_tstbit(*op.bits, sign_bit) != 0) {
       /* If sign bit is unset then we are done,
          otherwise clear sign_bit and subtract 2**sign_bit */
       mpz_set_ui(sail_lib_tmp1, 1);
       mpz_mul_2exp(sail_lib_tmp1, sail_lib_tmp1, sign_bit); /* 2**sign_bit */
-      mpz_combit(*rop, sign_bit); /* clear sign_bit */
-      mpz_sub(*rop, *rop, sail_lib_tmp1);
+      mpz_combit(rop, sign_bit); /* clear sign_bit */
+      mpz_sub(rop, rop, sail_lib_tmp1);
     }
   }
 }
 
+void sail_signed(sail_int *rop, const lbits op)
+{
+  mpz_signed_lbits(sail_lib_tmp2, op);
+  sail_int_set_mpz(rop, sail_lib_tmp2);
+}
+#endif
+
 mach_int fast_unsigned(const fbits op)
 {
   return (mach_int) op;
@@ -949,12 +1058,14 @@ mach_int fast_signed(const fbits op, const uint64_t n)
   }
 }
 
+#ifndef SAIL_LIMB_LBITS
 void append(lbits *rop, const lbits op1, const lbits op2)
 {
   rop->len = op1.len + op2.len;
   mpz_mul_2exp(*rop->bits, *op1.bits, op2.len);
   mpz_ior(*rop->bits, *rop->bits, *op2.bits);
 }
+#endif
 
 sbits append_sf(const sbits op1, const fbits op2, const uint64_t len)
 {
@@ -980,26 +1091,48 @@ sbits append_ss(const sbits op1, const sbits op2)
   return rop;
 }
 
-void replicate_bits(lbits *rop, const lbits op1, const mpz_t op2)
+#ifndef SAIL_LIMB_LBITS
+void replicate_bits(lbits *rop, const lbits op1, const sail_int op2)
 {
-  uint64_t op2_ui = mpz_get_ui(op2);
-  rop->len = op1.len * op2_ui;
-  mpz_set_ui(*rop->bits, 0);
-  for (int i = 0; i < op2_ui; i++) {
-    mpz_mul_2exp(*rop->bits, *rop->bits, op1.len);
-    mpz_ior(*rop->bits, *rop->bits, *op1.bits);
+  uint64_t op2_ui = sail_int_get_ui(op2);
+  uint64_t len = op1.len * op2_ui;
+
+  if (len <= 64) {
+    rop->len = len;
+    mpz_set_ui(*rop->bits, fast_replicate_bits(op1.len, mpz_get_ui(*op1.bits), op2_ui));
+    return;
+  }
+
+  // Double the number of copies each time, so we only need
+  // O(log(op2)) GMP operations. The low copied bits are always a whole
+  // number of copies of op1, so they can be appended as-is.
+  mpz_set(sail_lib_tmp1, *op1.bits);
+  uint64_t copied = op1.len;
+  while (copied < len) {
+    uint64_t n = copied < len - copied ? copied : len - copied;
+    mpz_fdiv_r_2exp(sail_lib_tmp2, sail_lib_tmp1, n);
+    mpz_mul_2exp(sail_lib_tmp2, sail_lib_tmp2, copied);
+    mpz_ior(sail_lib_tmp1, sail_lib_tmp1, sail_lib_tmp2);
+    copied += n;
   }
+  rop->len = len;
+  mpz_set(*rop->bits, sail_lib_tmp1);
 }
+#endif
 
 uint64_t fast_replicate_bits(const uint64_t shift, const uint64_t v, const int64_t times)
 {
+  // Double the number of copies each iteration, then mask away any
+  // copies beyond the result length.
+  uint64_t len = shift * times;
   uint64_t r = v;
-  for (int i = 1; i < times; ++i) {
-    r |= (r << shift);
+  for (uint64_t copied = shift; copied < len; copied *= 2) {
+    r |= r << copied;
   }
-  return r;
+  return r & safe_rshift(UINT64_MAX, 64 - len);
 }
 
+#ifndef SAIL_LIMB_LBITS
 // Takes a slice of the (two's complement) binary representation of
 // integer n, starting at bit start, and of length len. With the
 // argument in the following order:
@@ -1018,14 +1151,15 @@ uint64_t fast_replicate_bits(const uint64_t shift, const uint64_t v, const int64
 //
 void get_slice_int(lbits *rop, const sail_int len_mpz, const sail_int n, const sail_int start_mpz)
 {
-  uint64_t start = mpz_get_ui(start_mpz);
-  uint64_t len = mpz_get_ui(len_mpz);
+  uint64_t start = sail_int_get_ui(start_mpz);
+  uint64_t len = sail_int_get_ui(len_mpz);
 
+  mpz_srcptr n_mpz = sail_int_as_mpz(sail_lib_tmp1, n);
   mpz_set_ui(*rop->bits, 0ul);
   rop->len = len;
 
   for (uint64_t i = 0; i < len; i++) {
-    if (mpz_tstbit(n, i + start)) mpz_setbit(*rop->bits, i);
+    if (mpz_tstbit(n_mpz, i + start)) mpz_setbit(*rop->bits, i);
   }
 }
 
@@ -1037,22 +1171,24 @@ void set_slice_int(sail_int *rop,
 		   const sail_int start_mpz,
 		   const lbits slice)
 {
-  uint64_t start = mpz_get_ui(start_mpz);
+  uint64_t start = sail_int_get_ui(start_mpz);
 
-  mpz_set(*rop, n);
+  mpz_set(sail_lib_tmp1, sail_int_as_mpz(sail_lib_tmp1, n));
 
   for (uint64_t i = 0; i < slice.len; i++) {
     if (mpz_tstbit(*slice.bits, i)) {
-      mpz_setbit(*rop, i + start);
+      mpz_setbit(sail_lib_tmp1, i + start);
     } else {
-      mpz_clrbit(*rop, i + start);
+      mpz_clrbit(sail_lib_tmp1, i + start);
     }
   }
+
+  sail_int_set_mpz(rop, sail_lib_tmp1);
 }
 
 void update_lbits(lbits *rop, const lbits op, const sail_int n_mpz, const uint64_t bit)
 {
-  uint64_t n = mpz_get_ui(n_mpz);
+  uint64_t n = sail_int_get_ui(n_mpz);
 
   mpz_set(*rop->bits, *op.bits);
   rop->len = op.len;
@@ -1066,7 +1202,7 @@ void update_lbits(lbits *rop, const lbits op, const sail_int n_mpz, const uint64
 
 void update_lbits_inc(lbits *rop, const lbits op, const sail_int n_mpz, const uint64_t bit)
 {
-  uint64_t n = mpz_get_ui(n_mpz);
+  uint64_t n = sail_int_get_ui(n_mpz);
 
   mpz_set(*rop->bits, *op.bits);
   rop->len = op.len;
@@ -1084,8 +1220,8 @@ void vector_update_subrange_lbits(lbits *rop,
 				 const sail_int m_mpz,
 				 const lbits slice)
 {
-  uint64_t n = mpz_get_ui(n_mpz);
-  uint64_t m = mpz_get_ui(m_mpz);
+  uint64_t n = sail_int_get_ui(n_mpz);
+  uint64_t m = sail_int_get_ui(m_mpz);
 
   mpz_set(*rop->bits, *op.bits);
   rop->len = op.len;
@@ -1105,8 +1241,8 @@ void vector_update_subrange_inc_lbits(lbits *rop,
                                       const sail_int m_mpz,
                                       const lbits slice)
 {
-  uint64_t n = mpz_get_ui(n_mpz);
-  uint64_t m = mpz_get_ui(m_mpz);
+  uint64_t n = sail_int_get_ui(n_mpz);
+  uint64_t m = sail_int_get_ui(m_mpz);
 
   mpz_set(*rop->bits, *op.bits);
   rop->len = op.len;
@@ -1120,6 +1256,7 @@ void vector_update_subrange_inc_lbits(lbits *rop,
     }
   }
 }
+#endif
 
 fbits fast_update_subrange(const fbits op,
 			   const mach_int n,
@@ -1138,11 +1275,12 @@ fbits fast_update_subrange(const fbits op,
   return rop;
 }
 
+#ifndef SAIL_LIMB_LBITS
 void slice(lbits *rop, const lbits op, const sail_int start_mpz, const sail_int len_mpz)
 {
-  assert(mpz_get_ui(start_mpz) + mpz_get_ui(len_mpz) <= op.len);
-  uint64_t start = mpz_get_ui(start_mpz);
-  uint64_t len = mpz_get_ui(len_mpz);
+  assert(sail_int_get_ui(start_mpz) + sail_int_get_ui(len_mpz) <= op.len);
+  uint64_t start = sail_int_get_ui(start_mpz);
+  uint64_t len = sail_int_get_ui(len_mpz);
 
   mpz_set_ui(*rop->bits, 0);
   rop->len = len;
@@ -1154,9 +1292,9 @@ void slice(lbits *rop, const lbits op, const sail_int start_mpz, const sail_int
 
 void slice_inc(lbits *rop, const lbits op, const sail_int start_mpz, const sail_int len_mpz)
 {
-  assert(mpz_get_ui(start_mpz) + mpz_get_ui(len_mpz) <= op.len);
-  uint64_t start = mpz_get_ui(start_mpz);
-  uint64_t len = mpz_get_ui(len_mpz);
+  assert(sail_int_get_ui(start_mpz) + sail_int_get_ui(len_mpz) <= op.len);
+  uint64_t start = sail_int_get_ui(start_mpz);
+  uint64_t len = sail_int_get_ui(len_mpz);
 
   mpz_set_ui(*rop->bits, 0);
   rop->len = len;
@@ -1165,6 +1303,7 @@ void slice_inc(lbits *rop, const lbits op, const sail_int start_mpz, const sail_
     if (mpz_tstbit(*op.bits, ((op.len - 1) - start) - i)) mpz_setbit(*rop->bits, (rop->len - 1) - i);
   }
 }
+#endif
 
 sbits sslice(const fbits op, const mach_int start, const mach_int len)
 {
@@ -1174,6 +1313,7 @@ sbits sslice(const fbits op, const mach_int start, const mach_int len)
   return rop;
 }
 
+#ifndef SAIL_LIMB_LBITS
 void set_slice(lbits *rop,
 	       const sail_int len_mpz,
 	       const sail_int slen_mpz,
@@ -1181,7 +1321,7 @@ void set_slice(lbits *rop,
 	       const sail_int start_mpz,
 	       const lbits slice)
 {
-  uint64_t start = mpz_get_ui(start_mpz);
+  uint64_t start = sail_int_get_ui(start_mpz);
 
   mpz_set(*rop->bits, *op.bits);
   rop->len = op.len;
@@ -1226,7 +1366,7 @@ void shift_bits_right_arith(lbits *rop, const lbits op1, const lbits op2)
 void arith_shiftr(lbits *rop, const lbits op1, const sail_int op2)
 {
   rop->len = op1.len;
-  mp_bitcnt_t shift_amt = mpz_get_ui(op2);
+  mp_bitcnt_t shift_amt = sail_int_get_ui(op2);
   mp_bitcnt_t sign_bit = op1.len - 1;
   mpz_fdiv_q_2exp(*rop->bits, *op1.bits, shift_amt);
   if(mpz_tstbit(*op1.bits, sign_bit) != 0) {
@@ -1240,49 +1380,46 @@ void arith_shiftr(lbits *rop, const lbits op1, const sail_int op2)
 void shiftl(lbits *rop, const lbits op1, const sail_int op2)
 {
   rop->len = op1.len;
-  mpz_mul_2exp(*rop->bits, *op1.bits, mpz_get_ui(op2));
+  mpz_mul_2exp(*rop->bits, *op1.bits, sail_int_get_ui(op2));
   normalize_lbits(rop);
 }
 
 void shiftr(lbits *rop, const lbits op1, const sail_int op2)
 {
   rop->len = op1.len;
-  mpz_tdiv_q_2exp(*rop->bits, *op1.bits, mpz_get_ui(op2));
+  mpz_tdiv_q_2exp(*rop->bits, *op1.bits, sail_int_get_ui(op2));
 }
 
 void reverse_endianness(lbits *rop, const lbits op)
 {
-  rop->len = op.len;
-  if (rop->len == 64ul) {
-    uint64_t x = mpz_get_ui(*op.bits);
-    x = (x & 0xFFFFFFFF00000000) >> 32 | (x & 0x00000000FFFFFFFF) << 32;
-    x = (x & 0xFFFF0000FFFF0000) >> 16 | (x & 0x0000FFFF0000FFFF) << 16;
-    x = (x & 0xFF00FF00FF00FF00) >> 8  | (x & 0x00FF00FF00FF00FF) << 8;
-    mpz_set_ui(*rop->bits, x);
-  } else if (rop->len == 32ul) {
-    uint64_t x = mpz_get_ui(*op.bits);
-    x = (x & 0xFFFF0000FFFF0000) >> 16 | (x & 0x0000FFFF0000FFFF) << 16;
-    x = (x & 0xFF00FF00FF00FF00) >> 8  | (x & 0x00FF00FF00FF00FF) << 8;
-    mpz_set_ui(*rop->bits, x);
-  } else if (rop->len == 16ul) {
-    uint64_t x = mpz_get_ui(*op.bits);
-    x = (x & 0xFF00FF00FF00FF00) >> 8  | (x & 0x00FF00FF00FF00FF) << 8;
-    mpz_set_ui(*rop->bits, x);
-  } else if (rop->len == 8ul) {
-    mpz_set(*rop->bits, *op.bits);
-  } else {
-    /* For other numbers of bytes we reverse the bytes.
-     * XXX could use mpz_import/export for this. */
-    mpz_set_ui(sail_lib_tmp1, 0xff); // byte mask
-    mpz_set_ui(*rop->bits, 0); // reset accumulator for result
-    for(mp_bitcnt_t byte = 0; byte < op.len; byte+=8) {
-      mpz_tdiv_q_2exp(sail_lib_tmp2, *op.bits, byte); // shift byte to bottom
-      mpz_and(sail_lib_tmp2, sail_lib_tmp2, sail_lib_tmp1); // and with mask
-      mpz_mul_2exp(*rop->bits, *rop->bits, 8); // shift result left 8
-      mpz_ior(*rop->bits, *rop->bits, sail_lib_tmp2); // or byte into result
+  uint64_t len = op.len;
+
+  if (len <= 64 && len % 8 == 0) {
+    mpz_set_ui(*rop->bits, fast_reverse_endianness(mpz_get_ui(*op.bits), len));
+  } else if (len <= 128 && len % 8 == 0) {
+    // Reverse each word and swap them, then shift the result down
+    // to remove the zero bytes that were above the length.
+    uint64_t words[2] = { fast_reverse_endianness(get_lbits_word(op, 1), 64),
+                          fast_reverse_endianness(get_lbits_word(op, 0), 64) };
+    uint64_t shift = 128 - len;
+    if (shift != 0) {
+      words[0] = (words[0] >> shift) | (words[1] << (64 - shift));
+      words[1] = words[1] >> shift;
     }
+    mpz_import(*rop->bits, 2, -1, sizeof(uint64_t), 0, 0, words);
+  } else {
+    // Export the bytes least significant first, then import them
+    // most significant first.
+    size_t bytes = (len + 7) / 8;
+    unsigned char *buf = (unsigned char *)sail_malloc(bytes);
+    memset(buf, 0, bytes);
+    mpz_export(buf, NULL, -1, 1, 0, 0, *op.bits);
+    mpz_import(*rop->bits, bytes, 1, 1, 0, 0, buf);
+    sail_free(buf);
   }
+  rop->len = len;
 }
+#endif
 
 bool eq_sbits(const sbits op1, const sbits op2)
 {
@@ -1342,6 +1479,376 @@ sbits sub_sbits(const sbits op1, const sbits op2)
   return rop;
 }
 
+/* ***** Sail 128-bit bitvectors ***** */
+
+#ifdef __SIZEOF_INT128__
+
+static void mpz_set_fbits128(mpz_t rop, const fbits128 op)
+{
+  uint64_t words[2] = { (uint64_t) op, (uint64_t) (op >> 64) };
+  mpz_import(rop, 2, -1, sizeof(uint64_t), 0, 0, words);
+}
+
+#ifndef SAIL_LIMB_LBITS
+static fbits128 fbits128_of_mpz(const mpz_t op)
+{
+#if GMP_NUMB_BITS == 64
+  return FBITS128_C(mpz_getlimbn(op, 1), mpz_getlimbn(op, 0));
+#else
+  uint64_t words[2] = { 0, 0 };
+  mpz_export(words, NULL, -1, sizeof(uint64_t), 0, 0, op);
+  return FBITS128_C(words[1], words[0]);
+#endif
+}
+#endif
+
+bool EQUAL(fbits128)(const fbits128 op1, const fbits128 op2)
+{
+  return op1 == op2;
+}
+
+bool EQUAL(ref_fbits128)(const fbits128 *op1, const fbits128 *op2)
+{
+  return *op1 == *op2;
+}
+
+#ifndef SAIL_LIMB_LBITS
+void CREATE_OF(lbits, fbits128)(lbits *rop, const fbits128 op, const uint64_t len, const bool direction)
+{
+  rop->bits = (mpz_t *)sail_malloc(sizeof(mpz_t));
+  rop->len = len;
+  mpz_init(*rop->bits);
+  mpz_set_fbits128(*rop->bits, op);
+}
+
+void RECREATE_OF(lbits, fbits128)(lbits *rop, const fbits128 op, const uint64_t len, const bool direction)
+{
+  rop->len = len;
+  mpz_set_fbits128(*rop->bits, op);
+}
+
+fbits128 CREATE_OF(fbits128, lbits)(const lbits op, const bool direction)
+{
+  return fbits128_of_mpz(*op.bits);
+}
+
+fbits128 CONVERT_OF(fbits128, lbits)(const lbits op, const bool direction)
+{
+  return fbits128_of_mpz(*op.bits);
+}
+
+void CONVERT_OF(lbits, fbits128)(lbits *rop, const fbits128 op, const uint64_t len, const bool direction)
+{
+  rop->len = len;
+  mpz_set_fbits128(*rop->bits, op & safe_rshift128(FBITS128_MAX, 128 - len));
+}
+#endif
+
+fbits128 UNDEFINED(fbits128)(const unit u) { return 0; }
+
+fbits128 safe_rshift128(const fbits128 x, const fbits128 n)
+{
+  if (n >= 128) {
+    return 0;
+  } else {
+    return x >> n;
+  }
+}
+
+fbits128 safe_lshift128(const fbits128 x, const fbits128 n)
+{
+  if (n >= 128) {
+    return 0;
+  } else {
+    return x << n;
+  }
+}
+
+fbits128 fast_sign_extend128(const fbits128 op, const uint64_t n, const uint64_t m)
+{
+  fbits128 rop = op;
+  if ((op >> (n - 1)) & 1) {
+    rop |= safe_rshift128(FBITS128_MAX, 128 - m) & ~safe_rshift128(FBITS128_MAX, 128 - n);
+  }
+  return rop;
+}
+
+fbits128 update_fbits128(const fbits128 op, const uint64_t n, const fbits bit)
+{
+  if ((bit & 1) == 1) {
+    return op | ((fbits128) 1 << n);
+  } else {
+    return op & ~((fbits128) 1 << n);
+  }
+}
+
+sbits sslice128(const fbits128 op, const mach_int start, const mach_int len)
+{
+  sbits rop;
+  rop.bits = bzhi_u64((uint64_t) safe_rshift128(op, start), len);
+  rop.len = len;
+  return rop;
+}
+
+fbits128 fast_replicate_bits128(const uint64_t shift, const fbits128 v, const int64_t times)
+{
+  uint64_t len = shift * times;
+  fbits128 r = v;
+  for (uint64_t copied = shift; copied < len; copied *= 2) {
+    r |= r << copied;
+  }
+  return r & safe_rshift128(FBITS128_MAX, 128 - len);
+}
+
+void string_of_fbits128(sail_string *str, const fbits128 op)
+{
+  sail_free(*str);
+  uint64_t hi = (uint64_t) (op >> 64);
+  uint64_t lo = (uint64_t) op;
+  int bytes;
+  if (hi == 0) {
+    bytes = asprintf(str, "0x%" PRIx64, lo);
+  } else {
+    bytes = asprintf(str, "0x%" PRIx64 "%016" PRIx64, hi, lo);
+  }
+  if (bytes == -1) {
+    fprintf(stderr, "Could not print bits 0x%" PRIx64 "%016" PRIx64 "\n", hi, lo);
+  }
+}
+
+void decimal_string_of_fbits128(sail_string *str, const fbits128 op)
+{
+  sail_free(*str);
+  mpz_set_fbits128(sail_lib_tmp1, op);
+  gmp_asprintf(str, "%Zd", sail_lib_tmp1);
+}
+
+#endif
+
+/* ***** Sail wide bitvectors ***** */
+
+/*
+ * Clear any bits above len, so wide bitvectors always satisfy the
+ * same invariant as fbits.
+ */
+static void wbits_normalize(uint64_t *rop, const size_t words, const uint64_t len)
+{
+  for (size_t i = (len + 63) / 64; i < words; i++) {
+    rop[i] = 0;
+  }
+  if (len % 64 != 0) {
+    rop[len / 64] &= UINT64_MAX >> (64 - (len % 64));
+  }
+}
+
+bool wbits_eq(const uint64_t *op1, const uint64_t *op2, const size_t words)
+{
+  return memcmp(op1, op2, words * sizeof(uint64_t)) == 0;
+}
+
+#define WBITS_BITWISE(name, scalar_op, avx2_op, sse2_op)                                 \
+  void name(uint64_t *rop, const uint64_t *op1, const uint64_t *op2, const size_t words) \
+  {                                                                                      \
+    size_t i = 0;                                                                        \
+    WBITS_AVX2_LOOP(avx2_op)                                                             \
+    WBITS_SSE2_LOOP(sse2_op)                                                             \
+    for (; i < words; i++) {                                                             \
+      rop[i] = op1[i] scalar_op op2[i];                                                  \
+    }                                                                                    \
+  }
+
+#ifdef __AVX2__
+#define WBITS_AVX2_LOOP(avx2_op)                                       \
+  for (; i + 4 <= words; i += 4) {                                     \
+    __m256i a = _mm256_loadu_si256((const __m256i *) (op1 + i));       \
+    __m256i b = _mm256_loadu_si256((const __m256i *) (op2 + i));       \
+    _mm256_storeu_si256((__m256i *) (rop + i), avx2_op(a, b));         \
+  }
+#else
+#define WBITS_AVX2_LOOP(avx2_op)
+#endif
+
+#ifdef __SSE2__
+#define WBITS_SSE2_LOOP(sse2_op)                                       \
+  for (; i + 2 <= words; i += 2) {                                     \
+    __m128i a = _mm_loadu_si128((const __m128i *) (op1 + i));          \
+    __m128i b = _mm_loadu_si128((const __m128i *) (op2 + i));          \
+    _mm_storeu_si128((__m128i *) (rop + i), sse2_op(a, b));            \
+  }
+#else
+#define WBITS_SSE2_LOOP(sse2_op)
+#endif
+
+WBITS_BITWISE(wbits_and, &, _mm256_and_si256, _mm_and_si128)
+WBITS_BITWISE(wbits_or, |, _mm256_or_si256, _mm_or_si128)
+WBITS_BITWISE(wbits_xor, ^, _mm256_xor_si256, _mm_xor_si128)
+
+void wbits_not(uint64_t *rop, const uint64_t *op, const size_t words, const uint64_t len)
+{
+  for (size_t i = 0; i < words; i++) {
+    rop[i] = ~op[i];
+  }
+  wbits_normalize(rop, words, len);
+}
+
+void wbits_add(uint64_t *rop, const uint64_t *op1, const uint64_t *op2, const size_t words, const uint64_t len)
+{
+  uint64_t carry = 0;
+  for (size_t i = 0; i < words; i++) {
+    uint64_t sum = op1[i] + op2[i];
+    uint64_t carry_out = sum < op1[i];
+    rop[i] = sum + carry;
+    carry = carry_out | (rop[i] < sum);
+  }
+  wbits_normalize(rop, words, len);
+}
+
+void wbits_sub(uint64_t *rop, const uint64_t *op1, const uint64_t *op2, const size_t words, const uint64_t len)
+{
+  uint64_t borrow = 0;
+  for (size_t i = 0; i < words; i++) {
+    uint64_t diff = op1[i] - op2[i];
+    uint64_t borrow_out = op1[i] < op2[i];
+    rop[i] = diff - borrow;
+    borrow = borrow_out | (diff < borrow);
+  }
+  wbits_normalize(rop, words, len);
+}
+
+/*
+ * Mask with the top bit of every lane set, used to add or subtract
+ * lanes within a single 64-bit word without carries crossing lanes.
+ */
+static uint64_t wbits_lane_high_bits(const uint64_t lane)
+{
+  uint64_t high = 0;
+  for (uint64_t i = lane - 1; i < 64; i += lane) {
+    high |= UINT64_C(1) << i;
+  }
+  return high;
+}
+
+#define WBITS_LANES(name, swar, avx2_8, avx2_16, avx2_32, avx2_64, sse2_8, sse2_16, sse2_32, sse2_64) \
+  void name(uint64_t *rop, const uint64_t *op1, const uint64_t *op2, const size_t words, const uint64_t lane) \
+  {                                                                                      \
+    size_t i = 0;                                                                        \
+    switch (lane) {                                                                      \
+    case 8:                                                                              \
+      WBITS_AVX2_LOOP(avx2_8)                                                            \
+      WBITS_SSE2_LOOP(sse2_8)                                                            \
+      break;                                                                             \
+    case 16:                                                                             \
+      WBITS_AVX2_LOOP(avx2_16)                                                           \
+      WBITS_SSE2_LOOP(sse2_16)                                                           \
+      break;                                                                             \
+    case 32:                                                                             \
+      WBITS_AVX2_LOOP(avx2_32)                                                           \
+      WBITS_SSE2_LOOP(sse2_32)                                                           \
+      break;                                                                             \
+    case 64:                                                                             \
+      WBITS_AVX2_LOOP(avx2_64)                                                           \
+      WBITS_SSE2_LOOP(sse2_64)                                                           \
+      break;                                                                             \
+    default:                                                                             \
+      break;                                                                             \
+    }                                                                                    \
+    uint64_t high = wbits_lane_high_bits(lane);                                          \
+    for (; i < words; i++) {                                                             \
+      uint64_t a = op1[i];                                                               \
+      uint64_t b = op2[i];                                                               \
+      rop[i] = swar;                                                                     \
+    }                                                                                    \
+  }
+
+WBITS_LANES(wbits_add_lanes,
+	    ((a & ~high) + (b & ~high)) ^ ((a ^ b) & high),
+	    _mm256_add_epi8, _mm256_add_epi16, _mm256_add_epi32, _mm256_add_epi64,
+	    _mm_add_epi8, _mm_add_epi16, _mm_add_epi32, _mm_add_epi64)
+
+WBITS_LANES(wbits_sub_lanes,
+	    ((a | high) - (b & ~high)) ^ ((a ^ ~b) & high),
+	    _mm256_sub_epi8, _mm256_sub_epi16, _mm256_sub_epi32, _mm256_sub_epi64,
+	    _mm_sub_epi8, _mm_sub_epi16, _mm_sub_epi32, _mm_sub_epi64)
+
+void wbits_shl(uint64_t *rop, const uint64_t *op, const size_t words, const uint64_t n, const uint64_t len)
+{
+  uint64_t word_shift = n / 64;
+  uint64_t bit_shift = n % 64;
+  for (size_t i = words; i-- > 0;) {
+    uint64_t word = 0;
+    if (i >= word_shift) {
+      word = op[i - word_shift] << bit_shift;
+      if (bit_shift != 0 && i > word_shift) {
+        word |= op[i - word_shift - 1] >> (64 - bit_shift);
+      }
+    }
+    rop[i] = word;
+  }
+  wbits_normalize(rop, words, len);
+}
+
+void wbits_lshr(uint64_t *rop, const uint64_t *op, const size_t words, const uint64_t n)
+{
+  uint64_t word_shift = n / 64;
+  uint64_t bit_shift = n % 64;
+  for (size_t i = 0; i < words; i++) {
+    uint64_t word = 0;
+    if (word_shift < words - i) {
+      word = op[i + word_shift] >> bit_shift;
+      if (bit_shift != 0 && word_shift + 1 < words - i) {
+        word |= op[i + word_shift + 1] << (64 - bit_shift);
+      }
+    }
+    rop[i] = word;
+  }
+}
+
+fbits wbits_extract(const uint64_t *op, const size_t words, const uint64_t start, const uint64_t len)
+{
+  uint64_t i = start / 64;
+  uint64_t offset = start % 64;
+  if (i >= words) {
+    return 0;
+  }
+  fbits rop = op[i] >> offset;
+  if (offset != 0 && i + 1 < words) {
+    rop |= op[i + 1] << (64 - offset);
+  }
+  return rop & safe_rshift(UINT64_MAX, 64 - len);
+}
+
+void wbits_insert(uint64_t *rop, const size_t words, const uint64_t start, const fbits slice, const uint64_t len)
+{
+  uint64_t i = start / 64;
+  uint64_t offset = start % 64;
+  fbits mask = safe_rshift(UINT64_MAX, 64 - len);
+  fbits bits = slice & mask;
+  if (i >= words) {
+    return;
+  }
+  rop[i] = (rop[i] & ~(mask << offset)) | (bits << offset);
+  if (offset != 0 && i + 1 < words) {
+    rop[i + 1] = (rop[i + 1] & ~(mask >> (64 - offset))) | (bits >> (64 - offset));
+  }
+}
+
+#ifndef SAIL_LIMB_LBITS
+void lbits_of_wbits(lbits *rop, const uint64_t *op, const size_t words, const uint64_t len)
+{
+  rop->len = len;
+  mpz_import(*rop->bits, words, -1, sizeof(uint64_t), 0, 0, op);
+}
+
+void wbits_of_lbits(uint64_t *rop, const size_t words, const lbits op)
+{
+  size_t count = 0;
+  memset(rop, 0, words * sizeof(uint64_t));
+  if (mpz_sizeinbase(*op.bits, 2) <= words * 64) {
+    mpz_export(rop, &count, -1, sizeof(uint64_t), 0, 0, *op.bits);
+  }
+}
+#endif
+
 /* ***** Sail Reals ***** */
 
 void CREATE(real)(real *rop)
@@ -1479,17 +1986,19 @@ void abs_real(real *rop, const real op)
 
 void round_up(sail_int *rop, const real op)
 {
-  mpz_cdiv_q(*rop, mpq_numref(op), mpq_denref(op));
+  mpz_cdiv_q(sail_lib_tmp1, mpq_numref(op), mpq_denref(op));
+  sail_int_set_mpz(rop, sail_lib_tmp1);
 }
 
 void round_down(sail_int *rop, const real op)
 {
-  mpz_fdiv_q(*rop, mpq_numref(op), mpq_denref(op));
+  mpz_fdiv_q(sail_lib_tmp1, mpq_numref(op), mpq_denref(op));
+  sail_int_set_mpz(rop, sail_lib_tmp1);
 }
 
 void to_real(real *rop, const sail_int op)
 {
-  mpq_set_z(*rop, op);
+  mpq_set_z(*rop, sail_int_as_mpz(sail_lib_tmp1, op));
   mpq_canonicalize(*rop);
 }
 
@@ -1520,7 +2029,7 @@ bool gteq_real(const real op1, const real op2)
 
 void real_power(real *rop, const real base, const sail_int exp)
 {
-  int64_t exp_si = mpz_get_si(exp);
+  int64_t exp_si = CONVERT_OF(mach_int, sail_int)(exp);
 
   mpz_set_ui(mpq_numref(*rop), 1);
   mpz_set_ui(mpq_denref(*rop), 1);
@@ -1608,7 +2117,7 @@ void random_real(real *rop, const unit u)
 void string_of_int(sail_string *str, const sail_int i)
 {
   sail_free(*str);
-  gmp_asprintf(str, "%Zd", i);
+  gmp_asprintf(str, "%Zd", sail_int_as_mpz(sail_lib_tmp1, i));
 }
 
 /* asprintf is a GNU extension, but it should exist on BSD */
@@ -1621,6 +2130,7 @@ void string_of_fbits(sail_string *str, const fbits op)
   }
 }
 
+#ifndef SAIL_LIMB_LBITS
 void string_of_lbits(sail_string *str, const lbits op)
 {
   sail_free(*str);
@@ -1636,6 +2146,7 @@ void string_of_lbits(sail_string *str, const lbits op)
     (*str)[op.len + 2] = '\0';
   }
 }
+#endif
 
 void decimal_string_of_fbits(sail_string *str, const fbits op)
 {
@@ -1646,13 +2157,14 @@ void decimal_string_of_fbits(sail_string *str, const fbits op)
   }
 }
 
+#ifndef SAIL_LIMB_LBITS
 void decimal_string_of_lbits(sail_string *str, const lbits op)
 {
   sail_free(*str);
   gmp_asprintf(str, "%Z", *op.bits);
 }
 
-void parse_hex_bits(lbits *res, const mpz_t n, const_sail_string hex)
+void parse_hex_bits(lbits *res, const sail_int n, const_sail_string hex)
 {
   if (!valid_hex_bits(n, hex)) {
     goto failure;
@@ -1661,7 +2173,7 @@ void parse_hex_bits(lbits *res, const mpz_t n, const_sail_string hex)
   mpz_t value;
   mpz_init(value);
   if (mpz_set_str(value, hex + 2, 16) == 0) {
-    res->len = mpz_get_ui(n);
+    res->len = sail_int_get_ui(n);
     mpz_set(*res->bits, value);
     mpz_clear(value);
     return;
@@ -1670,11 +2182,12 @@ void parse_hex_bits(lbits *res, const mpz_t n, const_sail_string hex)
 
   // On failure, we return a zero bitvector of the correct width
 failure:
-  res->len = mpz_get_ui(n);
+  res->len = sail_int_get_ui(n);
   mpz_set_ui(*res->bits, 0);
 }
+#endif
 
-bool valid_hex_bits(const mpz_t n, const_sail_string hex) {
+bool valid_hex_bits(const sail_int n, const_sail_string hex) {
   // The string must be prefixed by '0x'
   if (strncmp(hex, "0x", 2) != 0) {
     return false;
@@ -1711,7 +2224,7 @@ bool valid_hex_bits(const mpz_t n, const_sail_string hex) {
   // The width of the hex string is the width of the first non zero,
   // plus 4 times the remaining hex digits
   int hex_width = fnz_width + ((len - (non_zero + 1)) * 4);
-  if (mpz_cmp_si(n, hex_width) < 0) {
+  if (mpz_cmp_si(sail_int_as_mpz(sail_lib_tmp1, n), hex_width) < 0) {
     return false;
   }
 
@@ -1726,6 +2239,7 @@ bool valid_hex_bits(const mpz_t n, const_sail_string hex) {
   return true;
 }
 
+#ifndef SAIL_LIMB_LBITS
 void fprint_bits(const_sail_string pre,
 		 const lbits op,
 		 const_sail_string post,
@@ -1761,6 +2275,7 @@ void fprint_bits(const_sail_string pre,
 
   fputs(post, stream);
 }
+#endif
 
 unit print_bits(const_sail_string str, const lbits op)
 {
@@ -1801,7 +2316,7 @@ unit prerr_endline(const_sail_string str)
 unit print_int(const_sail_string str, const sail_int op)
 {
   fputs(str, stdout);
-  mpz_out_str(stdout, 10, op);
+  mpz_out_str(stdout, 10, sail_int_as_mpz(sail_lib_tmp1, op));
   putchar('\n');
   return UNIT;
 }
@@ -1809,14 +2324,14 @@ unit print_int(const_sail_string str, const sail_int op)
 unit prerr_int(const_sail_string str, const sail_int op)
 {
   fputs(str, stderr);
-  mpz_out_str(stderr, 10, op);
+  mpz_out_str(stderr, 10, sail_int_as_mpz(sail_lib_tmp1, op));
   fputs("\n", stderr);
   return UNIT;
 }
 
 unit sail_putchar(const sail_int op)
 {
-  char c = (char) mpz_get_ui(op);
+  char c = (char) sail_int_get_ui(op);
   putchar(c);
   fflush(stdout);
   return UNIT;
@@ -1826,32 +2341,35 @@ void get_time_ns(sail_int *rop, const unit u)
 {
   struct timespec t;
   clock_gettime(CLOCK_REALTIME, &t);
-  mpz_set_si(*rop, t.tv_sec);
-  mpz_mul_ui(*rop, *rop, 1000000000);
-  mpz_add_ui(*rop, *rop, t.tv_nsec);
+  mpz_set_si(sail_lib_tmp1, t.tv_sec);
+  mpz_mul_ui(sail_lib_tmp1, sail_lib_tmp1, 1000000000);
+  mpz_add_ui(sail_lib_tmp1, sail_lib_tmp1, t.tv_nsec);
+  sail_int_set_mpz(rop, sail_lib_tmp1);
 }
 
 // ARM specific optimisations
 
+#ifndef SAIL_LIMB_LBITS
 void arm_align(lbits *rop, const lbits x_bv, const sail_int y_mpz)
 {
   uint64_t x = mpz_get_ui(*x_bv.bits);
-  uint64_t y = mpz_get_ui(y_mpz);
+  uint64_t y = sail_int_get_ui(y_mpz);
   uint64_t z = y * (x / y);
   mp_bitcnt_t n = x_bv.len;
   mpz_set_ui(*rop->bits, safe_rshift(UINT64_MAX, 64l - (n - 1)) & z);
   rop->len = n;
 }
+#endif
 
 // Monomorphisation
 void make_the_value(sail_int *rop, const sail_int op)
 {
-  mpz_set(*rop, op);
+  COPY(sail_int)(rop, op);
 }
 
 void size_itself_int(sail_int *rop, const sail_int op)
 {
-  mpz_set(*rop, op);
+  COPY(sail_int)(rop, op);
 }
 
 #ifdef __cplusplus
@@ -72,6 +72,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 #include <gmp.h>
 
 #include <time.h>
@@ -80,16 +81,58 @@
 extern "C" {
 #endif
 
+/*
+ * When compiled with SAIL_POOL_ALLOC defined, small allocations made
+ * by the runtime and the generated code, including the mpz_t headers
+ * and limbs allocated by GMP, come from size-class free lists rather
+ * than malloc, see sail_pool.c. Both the runtime and the generated
+ * code must be compiled with the same setting. Memory from
+ * sail_malloc must only be resized with sail_realloc and released
+ * with sail_free, but sail_free and sail_realloc also accept memory
+ * from malloc. The pool is not thread safe.
+ */
+#ifdef SAIL_POOL_ALLOC
+
+void *sail_pool_malloc(size_t size);
+void *sail_pool_realloc(void *ptr, size_t size);
+void sail_pool_free(void *ptr);
+
+void setup_pool_alloc(void);
+
+static inline void *sail_malloc(size_t size)
+{
+  return sail_pool_malloc(size);
+}
+
+static inline void *sail_realloc(void *ptr, size_t size)
+{
+  return sail_pool_realloc(ptr, size);
+}
+
+static inline void sail_free(void *ptr)
+{
+  sail_pool_free(ptr);
+}
+
+#else
+
 static inline void *sail_malloc(size_t size)
 {
   return malloc(size);
 }
 
+static inline void *sail_realloc(void *ptr, size_t size)
+{
+  return realloc(ptr, size);
+}
+
 static inline void sail_free(void *ptr)
 {
   free(ptr);
 }
 
+#endif
+
 #define sail_new(type) (type *)(sail_malloc(sizeof(type)))
 #define sail_new_array(type, len) (type *)(sail_malloc((len) * sizeof(type)))
 
@@ -120,6 +163,9 @@ void cleanup_library(void);
   void copy_ ## type(type *, const_type);\
   void kill_ ## type(type *);
 #define SAIL_BUILTIN_TYPE(type) SAIL_BUILTIN_TYPE_IMPL(type, const type)
+
+#include "sail_hints.h"
+
 /* ***** Sail unit type ***** */
 
 typedef int unit;
@@ -156,10 +202,6 @@ typedef const char *const_sail_string;
 
 SAIL_BUILTIN_TYPE_IMPL(sail_string, const_sail_string)
 
-void dec_str(sail_string *str, const mpz_t n);
-void hex_str(sail_string *str, const mpz_t n);
-void hex_str_upper(sail_string *str, const mpz_t n);
-
 void undefined_string(sail_string *str, const unit u);
 
 bool eq_string(const_sail_string, const_sail_string);
@@ -175,11 +217,40 @@ typedef int64_t mach_int;
 
 bool EQUAL(mach_int)(const mach_int, const mach_int);
 
+#define SAIL_INT_FUNCTION(fname, rtype, ...) void fname(rtype*, __VA_ARGS__)
+
+#ifdef SAIL_HYBRID_INT
+
+#include "sail_hybrid_int.h"
+
+#else
+
 typedef mpz_t sail_int;
 
-uint64_t sail_int_get_ui(const sail_int);
+static inline uint64_t sail_int_get_ui(const sail_int op)
+{
+  return mpz_get_ui(op);
+}
 
-#define SAIL_INT_FUNCTION(fname, rtype, ...) void fname(rtype*, __VA_ARGS__)
+static inline void sail_int_set_ui(sail_int *rop, const uint64_t op)
+{
+  mpz_set_ui(*rop, op);
+}
+
+/*
+ * Conversions to and from GMP, for library functions that need the
+ * full value. With this representation they are just copies, and
+ * sail_int_as_mpz never needs its scratch space.
+ */
+static inline mpz_srcptr sail_int_as_mpz(mpz_ptr tmp, const sail_int op)
+{
+  return op;
+}
+
+static inline void sail_int_set_mpz(sail_int *rop, mpz_srcptr op)
+{
+  mpz_set(*rop, op);
+}
 
 SAIL_BUILTIN_TYPE(sail_int)
 
@@ -188,11 +259,6 @@ void RECREATE_OF(sail_int, mach_int)(sail_int *, const mach_int);
 
 mach_int CREATE_OF(mach_int, sail_int)(const sail_int);
 
-void CREATE_OF(sail_int, sail_string)(sail_int *, const_sail_string);
-void RECREATE_OF(sail_int, sail_string)(mpz_t *, const_sail_string);
-
-void CONVERT_OF(sail_int, sail_string)(sail_int *, const_sail_string);
-
 mach_int CONVERT_OF(mach_int, sail_int)(const sail_int);
 void CONVERT_OF(sail_int, mach_int)(sail_int *, const mach_int);
 
@@ -207,6 +273,20 @@ bool gt(const sail_int, const sail_int);
 bool lteq(const sail_int, const sail_int);
 bool gteq(const sail_int, const sail_int);
 
+SAIL_INT_FUNCTION(add_int, sail_int, const sail_int, const sail_int);
+SAIL_INT_FUNCTION(sub_int, sail_int, const sail_int, const sail_int);
+
+#endif
+
+void CREATE_OF(sail_int, sail_string)(sail_int *, const_sail_string);
+void RECREATE_OF(sail_int, sail_string)(sail_int *, const_sail_string);
+
+void CONVERT_OF(sail_int, sail_string)(sail_int *, const_sail_string);
+
+void dec_str(sail_string *str, const sail_int n);
+void hex_str(sail_string *str, const sail_int n);
+void hex_str_upper(sail_string *str, const sail_int n);
+
 /*
  * Left and right shift for integers
  */
@@ -230,8 +310,6 @@ SAIL_INT_FUNCTION(undefined_range, sail_int, const sail_int, const sail_int);
  * truncating towards zero, and rounding towards -infinity (floor) as
  * fdiv/fmod and tdiv/tmod respectively.
  */
-SAIL_INT_FUNCTION(add_int, sail_int, const sail_int, const sail_int);
-SAIL_INT_FUNCTION(sub_int, sail_int, const sail_int, const sail_int);
 SAIL_INT_FUNCTION(sub_nat, sail_int, const sail_int, const sail_int);
 SAIL_INT_FUNCTION(mult_int, sail_int, const sail_int, const sail_int);
 SAIL_INT_FUNCTION(ediv_int, sail_int, const sail_int, const sail_int);
@@ -273,10 +351,27 @@ typedef struct {
   uint64_t bits;
 } sbits;
 
+/*
+ * By default lbits are a GMP integer together with a length. When
+ * the runtime is compiled with SAIL_LIMB_LBITS defined, they are
+ * instead stored as an array of 64-bit limbs, least significant
+ * first, with size limbs allocated. In both cases the bits above the
+ * length are always zero. The limb implementation is in
+ * sail_limbs.c, and only uses GMP when converting to and from
+ * sail_int.
+ */
+#ifdef SAIL_LIMB_LBITS
+typedef struct {
+  uint64_t len;
+  uint64_t size;
+  uint64_t *bits;
+} lbits;
+#else
 typedef struct {
   mp_bitcnt_t len;
   mpz_t *bits;
 } lbits;
+#endif
 
 // For backwards compatibility
 typedef uint64_t mach_bits;
@@ -324,26 +419,40 @@ sbits undefined_sbits(void);
 
 /*
  * Wrapper around >> operator to avoid UB when shift amount is greater
- * than or equal to 64.
+ * than or equal to 64, and likewise for <<.
  */
 fbits safe_rshift(const fbits, const fbits);
+fbits safe_lshift(const fbits, const fbits);
 
 /*
  * Used internally to construct large bitvector literals.
  */
 void append_64(lbits *rop, const lbits op, const fbits chunk);
 
+/*
+ * Get bits [64 * n + 63 .. 64 * n] of a bitvector, independently of
+ * how lbits is represented.
+ */
+fbits get_lbits_word(const lbits op, const uint64_t n);
+
 void add_bits(lbits *rop, const lbits op1, const lbits op2);
 void sub_bits(lbits *rop, const lbits op1, const lbits op2);
 
-void add_bits_int(lbits *rop, const lbits op1, const mpz_t op2);
-void sub_bits_int(lbits *rop, const lbits op1, const mpz_t op2);
+void add_bits_int(lbits *rop, const lbits op1, const sail_int op2);
+void sub_bits_int(lbits *rop, const lbits op1, const sail_int op2);
 
 void and_bits(lbits *rop, const lbits op1, const lbits op2);
 void or_bits(lbits *rop, const lbits op1, const lbits op2);
 void xor_bits(lbits *rop, const lbits op1, const lbits op2);
 void not_bits(lbits *rop, const lbits op);
 
+/*
+ * Add or subtract each lane of the given width independently. The
+ * lane width must be 8, 16, 32 or 64.
+ */
+void add_lanes(lbits *rop, const lbits op1, const lbits op2, const mach_int lane);
+void sub_lanes(lbits *rop, const lbits op1, const lbits op2, const mach_int lane);
+
 void mults_vec(lbits *rop, const lbits op1, const lbits op2);
 void mult_vec(lbits *rop, const lbits op1, const lbits op2);
 
@@ -446,6 +555,12 @@ void arith_shiftr(lbits *rop, const lbits op1, const sail_int op2);
 
 void reverse_endianness(lbits*, lbits);
 
+/*
+ * Reverse the bytes of a len bit bitvector, where len is a multiple
+ * of 8 no greater than 64.
+ */
+fbits fast_reverse_endianness(const fbits op, const uint64_t len);
+
 bool eq_sbits(const sbits op1, const sbits op2);
 bool neq_sbits(const sbits op1, const sbits op2);
 sbits not_sbits(const sbits op);
@@ -455,6 +570,301 @@ sbits and_sbits(const sbits op1, const sbits op2);
 sbits add_sbits(const sbits op1, const sbits op2);
 sbits sub_sbits(const sbits op1, const sbits op2);
 
+/* ***** Sail 128-bit bitvectors ***** */
+
+/*
+ * When compiling with -Ofbits128, bitvectors with a statically known
+ * length between 65 and 128 bits are represented as an unsigned
+ * __int128, rather than using lbits. Like fbits, the bits above the
+ * length of the bitvector are always zero.
+ */
+#ifdef __SIZEOF_INT128__
+
+typedef unsigned __int128 fbits128;
+
+#define FBITS128_C(hi, lo) ((((fbits128) (hi)) << 64) | ((fbits128) (lo)))
+#define FBITS128_MAX (~((fbits128) 0))
+
+bool EQUAL(fbits128)(const fbits128, const fbits128);
+bool EQUAL(ref_fbits128)(const fbits128*, const fbits128*);
+
+void CREATE_OF(lbits, fbits128)(lbits *,
+				const fbits128 op,
+				const uint64_t len,
+				const bool direction);
+
+void RECREATE_OF(lbits, fbits128)(lbits *,
+				  const fbits128 op,
+				  const uint64_t len,
+				  const bool direction);
+
+fbits128 CREATE_OF(fbits128, lbits)(const lbits op, const bool direction);
+
+fbits128 CONVERT_OF(fbits128, lbits)(const lbits, const bool);
+void CONVERT_OF(lbits, fbits128)(lbits *, const fbits128, const uint64_t, const bool);
+
+fbits128 UNDEFINED(fbits128)(const unit);
+
+/*
+ * Like safe_rshift and safe_lshift, but for 128-bit values
+ */
+fbits128 safe_rshift128(const fbits128, const fbits128);
+fbits128 safe_lshift128(const fbits128, const fbits128);
+
+fbits128 fast_sign_extend128(const fbits128 op, const uint64_t n, const uint64_t m);
+
+fbits128 update_fbits128(const fbits128 op, const uint64_t n, const fbits bit);
+
+sbits sslice128(const fbits128 op, const mach_int start, const mach_int len);
+
+fbits128 fast_replicate_bits128(const fbits shift, const fbits128 v, const mach_int times);
+
+void string_of_fbits128(sail_string *str, const fbits128 op);
+void decimal_string_of_fbits128(sail_string *str, const fbits128 op);
+
+#endif
+
+/* ***** Sail wide bitvectors ***** */
+
+/*
+ * When compiling with -Owide_bits, bitvectors with a statically known
+ * length too large for fbits (up to 2048 bits) are stored on the
+ * stack as a fixed number of 64-bit words, least significant word
+ * first, rather than using lbits. As with fbits, the bits above the
+ * length of the bitvector are always zero.
+ *
+ * The kernels below operate on the raw words. When the runtime is
+ * compiled with AVX2 or SSE2 enabled the bitwise and lane-wise
+ * kernels use the corresponding vector instructions.
+ */
+
+bool wbits_eq(const uint64_t *op1, const uint64_t *op2, const size_t words);
+
+void wbits_and(uint64_t *rop, const uint64_t *op1, const uint64_t *op2, const size_t words);
+void wbits_or(uint64_t *rop, const uint64_t *op1, const uint64_t *op2, const size_t words);
+void wbits_xor(uint64_t *rop, const uint64_t *op1, const uint64_t *op2, const size_t words);
+void wbits_not(uint64_t *rop, const uint64_t *op, const size_t words, const uint64_t len);
+
+/*
+ * Addition and subtraction of the whole bitvector, modulo 2^len.
+ */
+void wbits_add(uint64_t *rop, const uint64_t *op1, const uint64_t *op2, const size_t words, const uint64_t len);
+void wbits_sub(uint64_t *rop, const uint64_t *op1, const uint64_t *op2, const size_t words, const uint64_t len);
+
+/*
+ * Addition and subtraction of independent lanes of the given width,
+ * which must divide 64.
+ */
+void wbits_add_lanes(uint64_t *rop, const uint64_t *op1, const uint64_t *op2, const size_t words, const uint64_t lane);
+void wbits_sub_lanes(uint64_t *rop, const uint64_t *op1, const uint64_t *op2, const size_t words, const uint64_t lane);
+
+void wbits_shl(uint64_t *rop, const uint64_t *op, const size_t words, const uint64_t n, const uint64_t len);
+void wbits_lshr(uint64_t *rop, const uint64_t *op, const size_t words, const uint64_t n);
+
+/*
+ * Read or write len <= 64 bits starting at bit start.
+ */
+fbits wbits_extract(const uint64_t *op, const size_t words, const uint64_t start, const uint64_t len);
+void wbits_insert(uint64_t *rop, const size_t words, const uint64_t start, const fbits slice, const uint64_t len);
+
+void lbits_of_wbits(lbits *rop, const uint64_t *op, const size_t words, const uint64_t len);
+void wbits_of_lbits(uint64_t *rop, const size_t words, const lbits op);
+
+#define SAIL_WBITS(words)                                                                      \
+  typedef struct {                                                                             \
+    uint64_t bits[words];                                                                      \
+  } wbits ## words;                                                                            \
+                                                                                               \
+  static inline bool EQUAL(wbits ## words)(const wbits ## words op1, const wbits ## words op2) \
+  {                                                                                            \
+    return wbits_eq(op1.bits, op2.bits, words);                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline bool EQUAL(ref_wbits ## words)(const wbits ## words *op1,                      \
+                                               const wbits ## words *op2)                      \
+  {                                                                                            \
+    return wbits_eq(op1->bits, op2->bits, words);                                              \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words UNDEFINED(wbits ## words)(const unit u)                         \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    memset(rop.bits, 0, sizeof(rop.bits));                                                     \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline void CREATE_OF(lbits, wbits ## words)(lbits *rop,                              \
+                                                      const wbits ## words op,                 \
+                                                      const uint64_t len,                      \
+                                                      const bool direction)                    \
+  {                                                                                            \
+    CREATE(lbits)(rop);                                                                        \
+    lbits_of_wbits(rop, op.bits, words, len);                                                  \
+  }                                                                                            \
+                                                                                               \
+  static inline void RECREATE_OF(lbits, wbits ## words)(lbits *rop,                            \
+                                                        const wbits ## words op,               \
+                                                        const uint64_t len,                    \
+                                                        const bool direction)                  \
+  {                                                                                            \
+    lbits_of_wbits(rop, op.bits, words, len);                                                  \
+  }                                                                                            \
+                                                                                               \
+  static inline void CONVERT_OF(lbits, wbits ## words)(lbits *rop,                             \
+                                                       const wbits ## words op,                \
+                                                       const uint64_t len,                     \
+                                                       const bool direction)                   \
+  {                                                                                            \
+    lbits_of_wbits(rop, op.bits, words, len);                                                  \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words CREATE_OF(wbits ## words, lbits)(const lbits op,                \
+                                                                const bool direction)          \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    wbits_of_lbits(rop.bits, words, op);                                                       \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words CONVERT_OF(wbits ## words, lbits)(const lbits op,               \
+                                                                 const bool direction)         \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    wbits_of_lbits(rop.bits, words, op);                                                       \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words and_wbits ## words(const wbits ## words op1,                    \
+                                                  const wbits ## words op2)                    \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    wbits_and(rop.bits, op1.bits, op2.bits, words);                                            \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words or_wbits ## words(const wbits ## words op1,                     \
+                                                 const wbits ## words op2)                     \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    wbits_or(rop.bits, op1.bits, op2.bits, words);                                             \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words xor_wbits ## words(const wbits ## words op1,                    \
+                                                  const wbits ## words op2)                    \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    wbits_xor(rop.bits, op1.bits, op2.bits, words);                                            \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words not_wbits ## words(const wbits ## words op,                     \
+                                                  const uint64_t len)                          \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    wbits_not(rop.bits, op.bits, words, len);                                                  \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words add_wbits ## words(const wbits ## words op1,                    \
+                                                  const wbits ## words op2,                    \
+                                                  const uint64_t len)                          \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    wbits_add(rop.bits, op1.bits, op2.bits, words, len);                                       \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words sub_wbits ## words(const wbits ## words op1,                    \
+                                                  const wbits ## words op2,                    \
+                                                  const uint64_t len)                          \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    wbits_sub(rop.bits, op1.bits, op2.bits, words, len);                                       \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words add_lanes_wbits ## words(const wbits ## words op1,              \
+                                                        const wbits ## words op2,              \
+                                                        const uint64_t lane)                   \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    wbits_add_lanes(rop.bits, op1.bits, op2.bits, words, lane);                                \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words sub_lanes_wbits ## words(const wbits ## words op1,              \
+                                                        const wbits ## words op2,              \
+                                                        const uint64_t lane)                   \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    wbits_sub_lanes(rop.bits, op1.bits, op2.bits, words, lane);                                \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words shl_wbits ## words(const wbits ## words op,                     \
+                                                  const uint64_t n,                            \
+                                                  const uint64_t len)                          \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    wbits_shl(rop.bits, op.bits, words, n, len);                                               \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words lshr_wbits ## words(const wbits ## words op, const uint64_t n)  \
+  {                                                                                            \
+    wbits ## words rop;                                                                        \
+    wbits_lshr(rop.bits, op.bits, words, n);                                                   \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline fbits access_wbits ## words(const wbits ## words op, const uint64_t n)         \
+  {                                                                                            \
+    return (op.bits[n / 64] >> (n % 64)) & 1;                                                  \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words update_wbits ## words(const wbits ## words op,                  \
+                                                     const uint64_t n,                         \
+                                                     const fbits bit)                          \
+  {                                                                                            \
+    wbits ## words rop = op;                                                                   \
+    wbits_insert(rop.bits, words, n, bit, 1);                                                  \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline fbits extract_wbits ## words(const wbits ## words op,                          \
+                                             const uint64_t start,                             \
+                                             const uint64_t len)                               \
+  {                                                                                            \
+    return wbits_extract(op.bits, words, start, len);                                          \
+  }                                                                                            \
+                                                                                               \
+  static inline sbits sslice_wbits ## words(const wbits ## words op,                           \
+                                            const uint64_t start,                              \
+                                            const uint64_t len)                                \
+  {                                                                                            \
+    sbits rop;                                                                                 \
+    rop.len = len;                                                                             \
+    rop.bits = wbits_extract(op.bits, words, start, len);                                      \
+    return rop;                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline wbits ## words insert_wbits ## words(const wbits ## words op,                  \
+                                                     const uint64_t start,                     \
+                                                     const fbits slice,                        \
+                                                     const uint64_t len)                       \
+  {                                                                                            \
+    wbits ## words rop = op;                                                                   \
+    wbits_insert(rop.bits, words, start, slice, len);                                          \
+    return rop;                                                                                \
+  }
+
+SAIL_WBITS(2)
+SAIL_WBITS(4)
+SAIL_WBITS(8)
+SAIL_WBITS(16)
+SAIL_WBITS(32)
+
 /* ***** Sail reals ***** */
 
 typedef mpq_t real;
@@ -512,9 +922,9 @@ void decimal_string_of_fbits(sail_string *str, const fbits op);
 
 /* ***** Mapping support ***** */
 
-void parse_hex_bits(lbits *stro, const mpz_t n, const_sail_string str);
+void parse_hex_bits(lbits *stro, const sail_int n, const_sail_string str);
 
-bool valid_hex_bits(const mpz_t n, const_sail_string str);
+bool valid_hex_bits(const sail_int n, const_sail_string str);
 
 /*
  * Utility function not callable from Sail!
@@ -74,14 +74,54 @@ extern "C" {
 
 int sail_coverage_exit(void);
 
+/*
+ * In the output file name %p is replaced by the process id. The
+ * binary format is written atomically and can be combined with
+ * `sailcov merge`.
+ */
 void sail_set_coverage_file(const char *output_file);
 
+void sail_set_coverage_binary_file(const char *output_file);
+
 void sail_function_entry(int function_id, const char *function_name, const char *sail_file, int l1, int c1, int l2, int c2);
 
 void sail_branch_reached(int branch_id, const char *sail_file, int l1, int c1, int l2, int c2);
 
 void sail_branch_target_taken(int branch_id, int branch_target_id, const char *sail_file, int l1, int c1, int l2, int c2);
 
+/*
+ * The C backend emits a static table of spans for functions,
+ * branches, and branch targets, indexed by their ids. Once these are
+ * registered, the _id variants of the above only need to record the
+ * id, and the spans are looked up when sail_coverage_exit is called.
+ */
+struct sail_coverage_span {
+  const char *sail_file;
+  int l1;
+  int c1;
+  int l2;
+  int c2;
+};
+
+void sail_coverage_init(const struct sail_coverage_span *functions, int function_count,
+                        const struct sail_coverage_span *branches, int branch_count,
+                        const struct sail_coverage_span *branch_targets, int branch_target_count);
+
+/*
+ * As sail_coverage_init, but keep a 64-bit hit counter for each id
+ * rather than a single bit. The counts are appended to each line of
+ * the coverage file.
+ */
+void sail_coverage_init_counts(const struct sail_coverage_span *functions, int function_count,
+                               const struct sail_coverage_span *branches, int branch_count,
+                               const struct sail_coverage_span *branch_targets, int branch_target_count);
+
+void sail_function_entry_id(int function_id);
+
+void sail_branch_reached_id(int branch_id);
+
+void sail_branch_target_taken_id(int branch_id, int branch_target_id);
+
 #ifdef __cplusplus
 }
 #endif
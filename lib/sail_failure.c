@@ -77,9 +77,8 @@ void sail_match_failure(const_sail_string msg)
   exit(EXIT_FAILURE);
 }
 
-unit sail_assert(bool b, const_sail_string msg)
+void sail_assert_failure(const_sail_string msg)
 {
-  if (b) return UNIT;
   fprintf(stderr, "Assertion failed: %s\n", msg);
   exit(EXIT_FAILURE);
 }
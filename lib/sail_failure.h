@@ -78,13 +78,20 @@ extern "C" {
  * This function should be called whenever a pattern match failure
  * occurs. Pattern match failures are always fatal.
  */
-void sail_match_failure(const_sail_string msg);
+void sail_match_failure(const_sail_string msg) __attribute__((noreturn, cold));
 
 /*
  * sail_assert implements the assert construct in Sail. If any
- * assertion fails we immediately exit the model.
+ * assertion fails we immediately exit the model. The check is inline
+ * so the failure path can be moved out of line.
  */
-unit sail_assert(bool b, const_sail_string msg);
+void sail_assert_failure(const_sail_string msg) __attribute__((noreturn, cold));
+
+static inline unit sail_assert(bool b, const_sail_string msg)
+{
+  if (SAIL_LIKELY(b)) return UNIT;
+  sail_assert_failure(msg);
+}
 
 #ifdef __cplusplus
 }
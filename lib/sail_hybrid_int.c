@@ -0,0 +1,536 @@
+/****************************************************************************/
+/*     Sail                                                                 */
+/*                                                                          */
+/*  Sail and the Sail architecture models here, comprising all files and    */
+/*  directories except the ASL-derived Sail code in the aarch64 directory,  */
+/*  are subject to the BSD two-clause licence below.                        */
+/*                                                                          */
+/*  The ASL derived parts of the ARMv8.3 specification in                   */
+/*  aarch64/no_vector and aarch64/full are copyright ARM Ltd.               */
+/*                                                                          */
+/*  Copyright (c) 2013-2021                                                 */
+/*    Kathyrn Gray                                                          */
+/*    Shaked Flur                                                           */
+/*    Stephen Kell                                                          */
+/*    Gabriel Kerneis                                                       */
+/*    Robert Norton-Wright                                                  */
+/*    Christopher Pulte                                                     */
+/*    Peter Sewell                                                          */
+/*    Alasdair Armstrong                                                    */
+/*    Brian Campbell                                                        */
+/*    Thomas Bauereiss                                                      */
+/*    Anthony Fox                                                           */
+/*    Jon French                                                            */
+/*    Dominic Mulligan                                                      */
+/*    Stephen Kell                                                          */
+/*    Mark Wassell                                                          */
+/*    Alastair Reid (Arm Ltd)                                               */
+/*                                                                          */
+/*  All rights reserved.                                                    */
+/*                                                                          */
+/*  This work was partially supported by EPSRC grant EP/K008528/1 <a        */
+/*  href="http://www.cl.cam.ac.uk/users/pes20/rems">REMS: Rigorous          */
+/*  Engineering for Mainstream Systems</a>, an ARM iCASE award, EPSRC IAA   */
+/*  KTF funding, and donations from Arm.  This project has received         */
+/*  funding from the European Research Council (ERC) under the European     */
+/*  Union’s Horizon 2020 research and innovation programme (grant           */
+/*  agreement No 789108, ELVER).                                            */
+/*                                                                          */
+/*  This software was developed by SRI International and the University of  */
+/*  Cambridge Computer Laboratory (Department of Computer Science and       */
+/*  Technology) under DARPA/AFRL contracts FA8650-18-C-7809 ("CIFV")        */
+/*  and FA8750-10-C-0237 ("CTSRD").                                         */
+/*                                                                          */
+/*  Redistribution and use in source and binary forms, with or without      */
+/*  modification, are permitted provided that the following conditions      */
+/*  are met:                                                                */
+/*  1. Redistributions of source code must retain the above copyright       */
+/*     notice, this list of conditions and the following disclaimer.        */
+/*  2. Redistributions in binary form must reproduce the above copyright    */
+/*     notice, this list of conditions and the following disclaimer in      */
+/*     the documentation and/or other materials provided with the           */
+/*     distribution.                                                        */
+/*                                                                          */
+/*  THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''      */
+/*  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED       */
+/*  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A         */
+/*  PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR     */
+/*  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,            */
+/*  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT        */
+/*  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF        */
+/*  USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND     */
+/*  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,      */
+/*  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT      */
+/*  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF      */
+/*  SUCH DAMAGE.                                                            */
+/****************************************************************************/
+
+/*
+ * The out of line parts of the hybrid sail_int representation
+ * described in sail_hybrid_int.h. Every operation first tries to
+ * compute its result on the inline int64_t values, and only falls
+ * back to GMP if an operand is already big or the result would
+ * overflow.
+ */
+#ifdef SAIL_HYBRID_INT
+
+#include<limits.h>
+#include<stdbool.h>
+#include<stdint.h>
+#include<stdlib.h>
+
+#include"sail.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Scratch space for viewing inline operands as GMP integers.
+ */
+static mpz_t sail_hybrid_tmp1, sail_hybrid_tmp2;
+
+void setup_hybrid_int(void)
+{
+  mpz_init(sail_hybrid_tmp1);
+  mpz_init(sail_hybrid_tmp2);
+}
+
+void cleanup_hybrid_int(void)
+{
+  mpz_clear(sail_hybrid_tmp1);
+  mpz_clear(sail_hybrid_tmp2);
+}
+
+void sail_int_clear_big(sail_hybrid_int *rop)
+{
+  mpz_clear(*rop->big);
+  sail_free(rop->big);
+  rop->big = NULL;
+}
+
+static mpz_ptr sail_int_make_big(sail_hybrid_int *rop)
+{
+  if (rop->big == NULL) {
+    rop->big = sail_new(mpz_t);
+    mpz_init(*rop->big);
+  }
+  return *rop->big;
+}
+
+/*
+ * Values which fit in an int64_t are always stored inline, so this
+ * frees any GMP integer rop no longer needs.
+ */
+static void sail_hybrid_set_mpz(sail_hybrid_int *rop, mpz_srcptr op)
+{
+  if (mpz_fits_slong_p(op)) {
+    sail_int_set_si(rop, mpz_get_si(op));
+  } else {
+    mpz_set(sail_int_make_big(rop), op);
+  }
+}
+
+void sail_int_set_mpz(sail_int *rop, mpz_srcptr op)
+{
+  sail_hybrid_set_mpz(*rop, op);
+}
+
+void sail_int_copy_big(sail_hybrid_int *rop, const sail_hybrid_int *op)
+{
+  if (rop != op) {
+    mpz_set(sail_int_make_big(rop), *op->big);
+  }
+}
+
+void sail_int_set_ui_big(sail_hybrid_int *rop, const uint64_t op)
+{
+  mpz_set_ui(sail_int_make_big(rop), op);
+}
+
+int sail_int_cmp(const sail_hybrid_int *op1, const sail_hybrid_int *op2)
+{
+  if (op1->big == NULL && op2->big == NULL) {
+    return (op1->small > op2->small) - (op1->small < op2->small);
+  } else if (op2->big == NULL) {
+    return mpz_cmp_si(*op1->big, op2->small);
+  } else if (op1->big == NULL) {
+    return -mpz_cmp_si(*op2->big, op1->small);
+  } else {
+    return mpz_cmp(*op1->big, *op2->big);
+  }
+}
+
+/*
+ * Move the result of a slow path back inline if it fits.
+ */
+static void sail_hybrid_demote(sail_hybrid_int *rop)
+{
+  if (mpz_fits_slong_p(*rop->big)) {
+    sail_int_set_si(rop, mpz_get_si(*rop->big));
+  }
+}
+
+/*
+ * GMP allows the result of an operation to alias its operands, so each
+ * slow path computes straight into the GMP integer of rop, which may be
+ * one of op1 and op2, and then demotes it if the result is small.
+ */
+#define SAIL_HYBRID_SLOW_BINOP(name, gmp_op)                                                            \
+  static void name(sail_hybrid_int *rop, const sail_hybrid_int *op1, const sail_hybrid_int *op2) \
+  {                                                                                                 \
+    mpz_srcptr x = sail_int_as_mpz(sail_hybrid_tmp1, op1);                                          \
+    mpz_srcptr y = sail_int_as_mpz(sail_hybrid_tmp2, op2);                                          \
+    gmp_op(sail_int_make_big(rop), x, y);                                                           \
+    sail_hybrid_demote(rop);                                                                        \
+  }
+
+SAIL_HYBRID_SLOW_BINOP(emod_int_gmp, mpz_mod)
+SAIL_HYBRID_SLOW_BINOP(tdiv_int_gmp, mpz_tdiv_q)
+SAIL_HYBRID_SLOW_BINOP(tmod_int_gmp, mpz_tdiv_r)
+SAIL_HYBRID_SLOW_BINOP(fdiv_int_gmp, mpz_fdiv_q)
+SAIL_HYBRID_SLOW_BINOP(fmod_int_gmp, mpz_fdiv_r)
+
+/*
+ * Addition, subtraction, and multiplication use the GMP functions
+ * taking a machine integer when an operand is inline, rather than
+ * converting it to a GMP integer first.
+ */
+static void sail_hybrid_add_si(mpz_ptr rop, mpz_srcptr op1, const int64_t op2)
+{
+  if (op2 >= 0) {
+    mpz_add_ui(rop, op1, (uint64_t)op2);
+  } else {
+    mpz_sub_ui(rop, op1, -(uint64_t)op2);
+  }
+}
+
+static void add_int_gmp(sail_hybrid_int *rop, const sail_hybrid_int *op1, const sail_hybrid_int *op2)
+{
+  if (op1->big == NULL) {
+    const sail_hybrid_int *tmp = op1;
+    op1 = op2;
+    op2 = tmp;
+  }
+  mpz_srcptr x = sail_int_as_mpz(sail_hybrid_tmp1, op1);
+  if (op2->big == NULL) {
+    sail_hybrid_add_si(sail_int_make_big(rop), x, op2->small);
+  } else {
+    mpz_add(sail_int_make_big(rop), x, *op2->big);
+  }
+  sail_hybrid_demote(rop);
+}
+
+static void sub_int_gmp(sail_hybrid_int *rop, const sail_hybrid_int *op1, const sail_hybrid_int *op2)
+{
+  mpz_srcptr x = sail_int_as_mpz(sail_hybrid_tmp1, op1);
+  if (op2->big == NULL) {
+    int64_t y = op2->small;
+    if (y <= 0) {
+      mpz_add_ui(sail_int_make_big(rop), x, -(uint64_t)y);
+    } else {
+      mpz_sub_ui(sail_int_make_big(rop), x, (uint64_t)y);
+    }
+  } else {
+    mpz_sub(sail_int_make_big(rop), x, *op2->big);
+  }
+  sail_hybrid_demote(rop);
+}
+
+static void mult_int_gmp(sail_hybrid_int *rop, const sail_hybrid_int *op1, const sail_hybrid_int *op2)
+{
+  if (op1->big == NULL) {
+    const sail_hybrid_int *tmp = op1;
+    op1 = op2;
+    op2 = tmp;
+  }
+  mpz_srcptr x = sail_int_as_mpz(sail_hybrid_tmp1, op1);
+  if (op2->big == NULL) {
+    mpz_mul_si(sail_int_make_big(rop), x, op2->small);
+  } else {
+    mpz_mul(sail_int_make_big(rop), x, *op2->big);
+  }
+  sail_hybrid_demote(rop);
+}
+
+static void ediv_int_gmp(sail_hybrid_int *rop, const sail_hybrid_int *op1, const sail_hybrid_int *op2)
+{
+  mpz_srcptr x = sail_int_as_mpz(sail_hybrid_tmp1, op1);
+  mpz_srcptr y = sail_int_as_mpz(sail_hybrid_tmp2, op2);
+  /* GMP doesn't have Euclidean division but we can emulate it using
+     flooring and ceiling division. */
+  if (mpz_sgn(y) >= 0) {
+    mpz_fdiv_q(sail_int_make_big(rop), x, y);
+  } else {
+    mpz_cdiv_q(sail_int_make_big(rop), x, y);
+  }
+  sail_hybrid_demote(rop);
+}
+
+void sail_int_add_slow(sail_hybrid_int *rop, const sail_hybrid_int *op1, const sail_hybrid_int *op2)
+{
+  add_int_gmp(rop, op1, op2);
+}
+
+void sail_int_sub_slow(sail_hybrid_int *rop, const sail_hybrid_int *op1, const sail_hybrid_int *op2)
+{
+  sub_int_gmp(rop, op1, op2);
+}
+
+void CREATE_OF(sail_int, sail_string)(sail_int *rop, const_sail_string str)
+{
+  CREATE(sail_int)(rop);
+  CONVERT_OF(sail_int, sail_string)(rop, str);
+}
+
+void RECREATE_OF(sail_int, sail_string)(sail_int *rop, const_sail_string str)
+{
+  CONVERT_OF(sail_int, sail_string)(rop, str);
+}
+
+void CONVERT_OF(sail_int, sail_string)(sail_int *rop, const_sail_string str)
+{
+  mpz_set_str(sail_hybrid_tmp1, str, 10);
+  sail_int_set_mpz(rop, sail_hybrid_tmp1);
+}
+
+/*
+ * Shifts only take the fast path when the result is exact, otherwise
+ * they use GMP.
+ */
+void shl_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  uint64_t shift = sail_int_get_ui(op2);
+  if (op1->big == NULL && shift < 63) {
+    int64_t r = (int64_t) ((uint64_t) op1->small << shift);
+    if ((r >> shift) == op1->small) {
+      sail_int_set_si(*rop, r);
+      return;
+    }
+  }
+  mpz_mul_2exp(sail_int_make_big(*rop), sail_int_as_mpz(sail_hybrid_tmp1, op1), shift);
+  sail_hybrid_demote(*rop);
+}
+
+mach_int shl_mach_int(const mach_int op1, const mach_int op2)
+{
+  return op1 << op2;
+}
+
+void shr_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  uint64_t shift = sail_int_get_ui(op2);
+  if (op1->big == NULL) {
+    /* An arithmetic right shift rounds towards -infinity like mpz_fdiv_q_2exp. */
+    sail_int_set_si(*rop, op1->small >> (shift < 63 ? shift : 63));
+    return;
+  }
+  mpz_fdiv_q_2exp(sail_int_make_big(*rop), *op1->big, shift);
+  sail_hybrid_demote(*rop);
+}
+
+mach_int shr_mach_int(const mach_int op1, const mach_int op2)
+{
+  return op1 >> op2;
+}
+
+void undefined_int(sail_int *rop, const int n)
+{
+  sail_int_set_ui(rop, (uint64_t) n);
+}
+
+void undefined_nat(sail_int *rop, const unit u)
+{
+  sail_int_set_si(*rop, 0);
+}
+
+void undefined_range(sail_int *rop, const sail_int l, const sail_int u)
+{
+  COPY(sail_int)(rop, l);
+}
+
+void sub_nat(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  sub_int(rop, op1, op2);
+  if ((*rop)->big == NULL ? (*rop)->small < 0 : mpz_sgn(*(*rop)->big) < 0) {
+    sail_int_set_si(*rop, 0);
+  }
+}
+
+void mult_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  int64_t r;
+  if (op1->big == NULL && op2->big == NULL && !__builtin_mul_overflow(op1->small, op2->small, &r)) {
+    sail_int_set_si(*rop, r);
+  } else {
+    mult_int_gmp(*rop, op1, op2);
+  }
+}
+
+/*
+ * The divisions can use C's truncating / and % whenever both
+ * operands are inline, except for division by zero (where we want
+ * the same behaviour as GMP), and INT64_MIN / -1 which overflows.
+ */
+static inline bool sail_int_small_divisible(const sail_int op1, const sail_int op2)
+{
+  return op1->big == NULL && op2->big == NULL && op2->small != 0
+    && !(op1->small == INT64_MIN && op2->small == -1);
+}
+
+void ediv_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  if (sail_int_small_divisible(op1, op2)) {
+    int64_t q = op1->small / op2->small;
+    if (op1->small % op2->small < 0) {
+      q = op2->small > 0 ? q - 1 : q + 1;
+    }
+    sail_int_set_si(*rop, q);
+  } else {
+    ediv_int_gmp(*rop, op1, op2);
+  }
+}
+
+void emod_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  if (sail_int_small_divisible(op1, op2)) {
+    int64_t r = op1->small % op2->small;
+    if (r < 0) {
+      r = op2->small > 0 ? r + op2->small : r - op2->small;
+    }
+    sail_int_set_si(*rop, r);
+  } else {
+    emod_int_gmp(*rop, op1, op2);
+  }
+}
+
+void tdiv_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  if (sail_int_small_divisible(op1, op2)) {
+    sail_int_set_si(*rop, op1->small / op2->small);
+  } else {
+    tdiv_int_gmp(*rop, op1, op2);
+  }
+}
+
+void tmod_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  if (sail_int_small_divisible(op1, op2)) {
+    sail_int_set_si(*rop, op1->small % op2->small);
+  } else {
+    tmod_int_gmp(*rop, op1, op2);
+  }
+}
+
+void fdiv_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  if (sail_int_small_divisible(op1, op2)) {
+    int64_t q = op1->small / op2->small;
+    int64_t r = op1->small % op2->small;
+    if (r != 0 && (r < 0) != (op2->small < 0)) {
+      q--;
+    }
+    sail_int_set_si(*rop, q);
+  } else {
+    fdiv_int_gmp(*rop, op1, op2);
+  }
+}
+
+void fmod_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  if (sail_int_small_divisible(op1, op2)) {
+    int64_t r = op1->small % op2->small;
+    if (r != 0 && (r < 0) != (op2->small < 0)) {
+      r += op2->small;
+    }
+    sail_int_set_si(*rop, r);
+  } else {
+    fmod_int_gmp(*rop, op1, op2);
+  }
+}
+
+void max_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  if (lt(op1, op2)) {
+    COPY(sail_int)(rop, op2);
+  } else {
+    COPY(sail_int)(rop, op1);
+  }
+}
+
+void min_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  if (gt(op1, op2)) {
+    COPY(sail_int)(rop, op2);
+  } else {
+    COPY(sail_int)(rop, op1);
+  }
+}
+
+void neg_int(sail_int *rop, const sail_int op)
+{
+  if (op->big == NULL && op->small != INT64_MIN) {
+    sail_int_set_si(*rop, -op->small);
+  } else {
+    mpz_neg(sail_int_make_big(*rop), sail_int_as_mpz(sail_hybrid_tmp1, op));
+    sail_hybrid_demote(*rop);
+  }
+}
+
+void abs_int(sail_int *rop, const sail_int op)
+{
+  if (op->big == NULL && op->small != INT64_MIN) {
+    sail_int_set_si(*rop, op->small < 0 ? -op->small : op->small);
+  } else {
+    mpz_abs(sail_int_make_big(*rop), sail_int_as_mpz(sail_hybrid_tmp1, op));
+    sail_hybrid_demote(*rop);
+  }
+}
+
+void pow_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  uint64_t n = sail_int_get_ui(op2);
+
+  if (op1->big == NULL) {
+    /* Exponentiation by squaring, giving up as soon as anything overflows. */
+    int64_t base = op1->small;
+    int64_t r = 1;
+    uint64_t i = n;
+    bool overflow = false;
+    while (i != 0 && !overflow) {
+      if (i & 1) {
+        overflow = __builtin_mul_overflow(r, base, &r);
+      }
+      i >>= 1;
+      if (i != 0 && !overflow) {
+        overflow = __builtin_mul_overflow(base, base, &base);
+      }
+    }
+    if (!overflow) {
+      sail_int_set_si(*rop, r);
+      return;
+    }
+  }
+
+  mpz_pow_ui(sail_int_make_big(*rop), sail_int_as_mpz(sail_hybrid_tmp1, op1), n);
+  sail_hybrid_demote(*rop);
+}
+
+void pow2(sail_int *rop, const sail_int exp)
+{
+  /* Assume exponent is never more than 2^64... */
+  uint64_t exp_ui = sail_int_get_ui(exp);
+  if (exp_ui < 63) {
+    sail_int_set_si(*rop, INT64_C(1) << exp_ui);
+  } else {
+    mpz_ptr big = sail_int_make_big(*rop);
+    mpz_set_ui(big, 0);
+    mpz_setbit(big, exp_ui);
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
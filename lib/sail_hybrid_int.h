@@ -0,0 +1,291 @@
+/****************************************************************************/
+/*     Sail                                                                 */
+/*                                                                          */
+/*  Sail and the Sail architecture models here, comprising all files and    */
+/*  directories except the ASL-derived Sail code in the aarch64 directory,  */
+/*  are subject to the BSD two-clause licence below.                        */
+/*                                                                          */
+/*  The ASL derived parts of the ARMv8.3 specification in                   */
+/*  aarch64/no_vector and aarch64/full are copyright ARM Ltd.               */
+/*                                                                          */
+/*  Copyright (c) 2013-2021                                                 */
+/*    Kathyrn Gray                                                          */
+/*    Shaked Flur                                                           */
+/*    Stephen Kell                                                          */
+/*    Gabriel Kerneis                                                       */
+/*    Robert Norton-Wright                                                  */
+/*    Christopher Pulte                                                     */
+/*    Peter Sewell                                                          */
+/*    Alasdair Armstrong                                                    */
+/*    Brian Campbell                                                        */
+/*    Thomas Bauereiss                                                      */
+/*    Anthony Fox                                                           */
+/*    Jon French                                                            */
+/*    Dominic Mulligan                                                      */
+/*    Stephen Kell                                                          */
+/*    Mark Wassell                                                          */
+/*    Alastair Reid (Arm Ltd)                                               */
+/*                                                                          */
+/*  All rights reserved.                                                    */
+/*                                                                          */
+/*  This work was partially supported by EPSRC grant EP/K008528/1 <a        */
+/*  href="http://www.cl.cam.ac.uk/users/pes20/rems">REMS: Rigorous          */
+/*  Engineering for Mainstream Systems</a>, an ARM iCASE award, EPSRC IAA   */
+/*  KTF funding, and donations from Arm.  This project has received         */
+/*  funding from the European Research Council (ERC) under the European     */
+/*  Union’s Horizon 2020 research and innovation programme (grant           */
+/*  agreement No 789108, ELVER).                                            */
+/*                                                                          */
+/*  This software was developed by SRI International and the University of  */
+/*  Cambridge Computer Laboratory (Department of Computer Science and       */
+/*  Technology) under DARPA/AFRL contracts FA8650-18-C-7809 ("CIFV")        */
+/*  and FA8750-10-C-0237 ("CTSRD").                                         */
+/*                                                                          */
+/*  Redistribution and use in source and binary forms, with or without      */
+/*  modification, are permitted provided that the following conditions      */
+/*  are met:                                                                */
+/*  1. Redistributions of source code must retain the above copyright       */
+/*     notice, this list of conditions and the following disclaimer.        */
+/*  2. Redistributions in binary form must reproduce the above copyright    */
+/*     notice, this list of conditions and the following disclaimer in      */
+/*     the documentation and/or other materials provided with the           */
+/*     distribution.                                                        */
+/*                                                                          */
+/*  THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''      */
+/*  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED       */
+/*  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A         */
+/*  PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR     */
+/*  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,            */
+/*  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT        */
+/*  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF        */
+/*  USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND     */
+/*  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,      */
+/*  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT      */
+/*  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF      */
+/*  SUCH DAMAGE.                                                            */
+/****************************************************************************/
+
+/*
+ * A hybrid representation of sail_int, selected by compiling the
+ * runtime with SAIL_HYBRID_INT. Integers that fit in 64 bits are
+ * stored inline, and arithmetic on them uses the compiler's overflow
+ * checking builtins. Only when a result overflows is a GMP integer
+ * allocated to hold it, so unlike lib/int128 or the SAIL_INT64 mode
+ * of lib/nostd, results are always exact.
+ *
+ * A value is stored in big if and only if it does not fit in an
+ * int64_t, so two integers can only be equal if they have the same
+ * representation.
+ *
+ * This header is included by sail.h, and should not be included
+ * directly.
+ */
+#ifndef SAIL_HYBRID_INT_H
+#define SAIL_HYBRID_INT_H
+
+typedef struct {
+  int64_t small;
+  mpz_t *big;
+} sail_hybrid_int;
+
+/*
+ * Like mpz_t, sail_int is a one element array so it is passed by
+ * reference, and generated code can treat both representations the
+ * same way.
+ */
+typedef sail_hybrid_int sail_int[1];
+
+/*
+ * Called by setup_library and cleanup_library.
+ */
+void setup_hybrid_int(void);
+void cleanup_hybrid_int(void);
+
+/*
+ * Slow paths, implemented in sail_hybrid_int.c
+ */
+void sail_int_clear_big(sail_hybrid_int *rop);
+void sail_int_copy_big(sail_hybrid_int *rop, const sail_hybrid_int *op);
+void sail_int_set_ui_big(sail_hybrid_int *rop, const uint64_t op);
+int sail_int_cmp(const sail_hybrid_int *op1, const sail_hybrid_int *op2);
+void sail_int_add_slow(sail_hybrid_int *rop, const sail_hybrid_int *op1, const sail_hybrid_int *op2);
+void sail_int_sub_slow(sail_hybrid_int *rop, const sail_hybrid_int *op1, const sail_hybrid_int *op2);
+
+static inline void sail_int_set_si(sail_hybrid_int *rop, const int64_t op)
+{
+  if (rop->big != NULL) {
+    sail_int_clear_big(rop);
+  }
+  rop->small = op;
+}
+
+static inline void CREATE(sail_int)(sail_int *rop)
+{
+  (*rop)->small = 0;
+  (*rop)->big = NULL;
+}
+
+static inline void RECREATE(sail_int)(sail_int *rop)
+{
+  sail_int_set_si(*rop, 0);
+}
+
+static inline void COPY(sail_int)(sail_int *rop, const sail_int op)
+{
+  if (op->big == NULL) {
+    sail_int_set_si(*rop, op->small);
+  } else {
+    sail_int_copy_big(*rop, op);
+  }
+}
+
+static inline void KILL(sail_int)(sail_int *rop)
+{
+  if ((*rop)->big != NULL) {
+    sail_int_clear_big(*rop);
+  }
+}
+
+/*
+ * Conversions to and from machine integers. Like mpz_get_ui,
+ * sail_int_get_ui returns the least significant 64 bits of the
+ * absolute value.
+ */
+static inline uint64_t sail_int_get_ui(const sail_int op)
+{
+  if (op->big != NULL) {
+    return mpz_get_ui(*op->big);
+  } else if (op->small < 0) {
+    return -(uint64_t)op->small;
+  } else {
+    return (uint64_t)op->small;
+  }
+}
+
+static inline void sail_int_set_ui(sail_int *rop, const uint64_t op)
+{
+  if (op <= INT64_MAX) {
+    sail_int_set_si(*rop, (int64_t)op);
+  } else {
+    sail_int_set_ui_big(*rop, op);
+  }
+}
+
+static inline void CREATE_OF(sail_int, mach_int)(sail_int *rop, const mach_int op)
+{
+  (*rop)->small = op;
+  (*rop)->big = NULL;
+}
+
+static inline void RECREATE_OF(sail_int, mach_int)(sail_int *rop, const mach_int op)
+{
+  sail_int_set_si(*rop, op);
+}
+
+static inline void CONVERT_OF(sail_int, mach_int)(sail_int *rop, const mach_int op)
+{
+  sail_int_set_si(*rop, op);
+}
+
+static inline mach_int CREATE_OF(mach_int, sail_int)(const sail_int op)
+{
+  return (mach_int)sail_int_get_ui(op);
+}
+
+static inline mach_int CONVERT_OF(mach_int, sail_int)(const sail_int op)
+{
+  if (op->big != NULL) {
+    return mpz_get_si(*op->big);
+  }
+  return op->small;
+}
+
+/*
+ * Conversions to and from GMP, for library functions that need the
+ * full value. sail_int_as_mpz returns a GMP view of op, using tmp as
+ * scratch space if op is stored inline.
+ */
+static inline mpz_srcptr sail_int_as_mpz(mpz_ptr tmp, const sail_int op)
+{
+  if (op->big != NULL) {
+    return *op->big;
+  }
+  mpz_set_si(tmp, op->small);
+  return tmp;
+}
+
+void sail_int_set_mpz(sail_int *rop, mpz_srcptr op);
+
+/*
+ * Comparison operators for integers
+ */
+static inline bool eq_int(const sail_int op1, const sail_int op2)
+{
+  if (op1->big == NULL && op2->big == NULL) {
+    return op1->small == op2->small;
+  }
+  return sail_int_cmp(op1, op2) == 0;
+}
+
+static inline bool EQUAL(sail_int)(const sail_int op1, const sail_int op2)
+{
+  return eq_int(op1, op2);
+}
+
+static inline bool lt(const sail_int op1, const sail_int op2)
+{
+  if (op1->big == NULL && op2->big == NULL) {
+    return op1->small < op2->small;
+  }
+  return sail_int_cmp(op1, op2) < 0;
+}
+
+static inline bool gt(const sail_int op1, const sail_int op2)
+{
+  if (op1->big == NULL && op2->big == NULL) {
+    return op1->small > op2->small;
+  }
+  return sail_int_cmp(op1, op2) > 0;
+}
+
+static inline bool lteq(const sail_int op1, const sail_int op2)
+{
+  if (op1->big == NULL && op2->big == NULL) {
+    return op1->small <= op2->small;
+  }
+  return sail_int_cmp(op1, op2) <= 0;
+}
+
+static inline bool gteq(const sail_int op1, const sail_int op2)
+{
+  if (op1->big == NULL && op2->big == NULL) {
+    return op1->small >= op2->small;
+  }
+  return sail_int_cmp(op1, op2) >= 0;
+}
+
+/*
+ * Addition and subtraction are by far the most common operations, so
+ * their fast paths are inlined.
+ */
+static inline void add_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  int64_t r;
+  if (op1->big == NULL && op2->big == NULL && !__builtin_add_overflow(op1->small, op2->small, &r)) {
+    sail_int_set_si(*rop, r);
+  } else {
+    sail_int_add_slow(*rop, op1, op2);
+  }
+}
+
+static inline void sub_int(sail_int *rop, const sail_int op1, const sail_int op2)
+{
+  int64_t r;
+  if (op1->big == NULL && op2->big == NULL && !__builtin_sub_overflow(op1->small, op2->small, &r)) {
+    sail_int_set_si(*rop, r);
+  } else {
+    sail_int_sub_slow(*rop, op1, op2);
+  }
+}
+
+#endif
@@ -0,0 +1,998 @@
+/****************************************************************************/
+/*     Sail                                                                 */
+/*                                                                          */
+/*  Sail and the Sail architecture models here, comprising all files and    */
+/*  directories except the ASL-derived Sail code in the aarch64 directory,  */
+/*  are subject to the BSD two-clause licence below.                        */
+/*                                                                          */
+/*  The ASL derived parts of the ARMv8.3 specification in                   */
+/*  aarch64/no_vector and aarch64/full are copyright ARM Ltd.               */
+/*                                                                          */
+/*  Copyright (c) 2013-2021                                                 */
+/*    Kathyrn Gray                                                          */
+/*    Shaked Flur                                                           */
+/*    Stephen Kell                                                          */
+/*    Gabriel Kerneis                                                       */
+/*    Robert Norton-Wright                                                  */
+/*    Christopher Pulte                                                     */
+/*    Peter Sewell                                                          */
+/*    Alasdair Armstrong                                                    */
+/*    Brian Campbell                                                        */
+/*    Thomas Bauereiss                                                      */
+/*    Anthony Fox                                                           */
+/*    Jon French                                                            */
+/*    Dominic Mulligan                                                      */
+/*    Stephen Kell                                                          */
+/*    Mark Wassell                                                          */
+/*    Alastair Reid (Arm Ltd)                                               */
+/*                                                                          */
+/*  All rights reserved.                                                    */
+/*                                                                          */
+/*  This work was partially supported by EPSRC grant EP/K008528/1 <a        */
+/*  href="http://www.cl.cam.ac.uk/users/pes20/rems">REMS: Rigorous          */
+/*  Engineering for Mainstream Systems</a>, an ARM iCASE award, EPSRC IAA   */
+/*  KTF funding, and donations from Arm.  This project has received         */
+/*  funding from the European Research Council (ERC) under the European     */
+/*  Union’s Horizon 2020 research and innovation programme (grant           */
+/*  agreement No 789108, ELVER).                                            */
+/*                                                                          */
+/*  This software was developed by SRI International and the University of  */
+/*  Cambridge Computer Laboratory (Department of Computer Science and       */
+/*  Technology) under DARPA/AFRL contracts FA8650-18-C-7809 ("CIFV")        */
+/*  and FA8750-10-C-0237 ("CTSRD").                                         */
+/*                                                                          */
+/*  Redistribution and use in source and binary forms, with or without      */
+/*  modification, are permitted provided that the following conditions      */
+/*  are met:                                                                */
+/*  1. Redistributions of source code must retain the above copyright       */
+/*     notice, this list of conditions and the following disclaimer.        */
+/*  2. Redistributions in binary form must reproduce the above copyright    */
+/*     notice, this list of conditions and the following disclaimer in      */
+/*     the documentation and/or other materials provided with the           */
+/*     distribution.                                                        */
+/*                                                                          */
+/*  THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''      */
+/*  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED       */
+/*  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A         */
+/*  PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR     */
+/*  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,            */
+/*  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT        */
+/*  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF        */
+/*  USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND     */
+/*  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,      */
+/*  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT      */
+/*  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF      */
+/*  SUCH DAMAGE.                                                            */
+/****************************************************************************/
+
+/*
+ * An implementation of lbits as an array of 64-bit limbs, selected by
+ * compiling the runtime with SAIL_LIMB_LBITS. Unlike the GMP
+ * representation in sail.c, these bitvectors know their own length,
+ * so operations work on whole words and never need to renormalize an
+ * arbitrary precision integer. GMP is only used when converting to
+ * and from sail_int, and for multiplication.
+ *
+ * The limbs are stored least significant first. Only the first
+ * LIMBS(len) limbs are meaningful, and any bits above len in the top
+ * limb are always zero.
+ */
+#ifdef SAIL_LIMB_LBITS
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include<assert.h>
+#include<inttypes.h>
+#include<stdbool.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include"sail.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LIMBS(len) (((len) + UINT64_C(63)) / 64)
+
+/*
+ * Make sure rop has room for len bits. A new array is allocated if
+ * the current one is too small, or if fresh is true because the
+ * result cannot be computed in place. The old array is returned so
+ * the caller can free it once any operands that alias rop have been
+ * read.
+ */
+static uint64_t *lbits_prepare(lbits *rop, const uint64_t len, const bool fresh)
+{
+  uint64_t limbs = LIMBS(len);
+  if (!fresh && limbs <= rop->size) {
+    return NULL;
+  }
+  uint64_t *old = rop->bits;
+  rop->size = limbs == 0 ? 1 : limbs;
+  rop->bits = sail_new_array(uint64_t, rop->size);
+  return old;
+}
+
+static void lbits_normalize(lbits *rop)
+{
+  if (rop->len % 64 != 0) {
+    rop->bits[rop->len / 64] &= UINT64_MAX >> (64 - rop->len % 64);
+  }
+}
+
+static inline uint64_t lbits_limb(const lbits op, const uint64_t i)
+{
+  return i < LIMBS(op.len) ? op.bits[i] : 0;
+}
+
+static inline bool lbits_tstbit(const lbits op, const uint64_t n)
+{
+  return n < op.len && ((op.bits[n / 64] >> (n % 64)) & 1);
+}
+
+static inline void lbits_setbit(lbits *rop, const uint64_t n, const bool bit)
+{
+  if (n < rop->len) {
+    if (bit) {
+      rop->bits[n / 64] |= UINT64_C(1) << (n % 64);
+    } else {
+      rop->bits[n / 64] &= ~(UINT64_C(1) << (n % 64));
+    }
+  }
+}
+
+static void lbits_set_ui(lbits *rop, const uint64_t op, const uint64_t len)
+{
+  uint64_t *old = lbits_prepare(rop, len, false);
+  memset(rop->bits, 0, rop->size * sizeof(uint64_t));
+  rop->bits[0] = op;
+  rop->len = len;
+  lbits_normalize(rop);
+  sail_free(old);
+}
+
+/*
+ * Copy the limbs of op into rop, zeroing any extra limbs needed for
+ * len bits. Safe when rop and op share limbs.
+ */
+static void lbits_copy_extend(lbits *rop, const lbits op, const uint64_t len)
+{
+  uint64_t *old = lbits_prepare(rop, len, false);
+  uint64_t limbs = LIMBS(op.len) < LIMBS(len) ? LIMBS(op.len) : LIMBS(len);
+  if (rop->bits != op.bits) {
+    memcpy(rop->bits, op.bits, limbs * sizeof(uint64_t));
+  }
+  memset(rop->bits + limbs, 0, (rop->size - limbs) * sizeof(uint64_t));
+  rop->len = len;
+  lbits_normalize(rop);
+  sail_free(old);
+}
+
+/*
+ * Set rop to the bits [start + len - 1 .. start] of op. Reads are
+ * always at or above the limb being written, so this is safe when
+ * rop and op share limbs.
+ */
+static void lbits_extract(lbits *rop, const lbits op, const uint64_t start, const uint64_t len)
+{
+  uint64_t *old = lbits_prepare(rop, len, false);
+  uint64_t word_shift = start / 64;
+  uint64_t bit_shift = start % 64;
+  for (uint64_t i = 0; i < LIMBS(len); i++) {
+    uint64_t word = lbits_limb(op, i + word_shift) >> bit_shift;
+    if (bit_shift != 0) {
+      word |= lbits_limb(op, i + word_shift + 1) << (64 - bit_shift);
+    }
+    rop->bits[i] = word;
+  }
+  if (len == 0) {
+    rop->bits[0] = 0;
+  }
+  rop->len = len;
+  lbits_normalize(rop);
+  sail_free(old);
+}
+
+/*
+ * Overwrite the bits [start + count - 1 .. start] of rop with the low
+ * count bits of op, ignoring any that fall outside rop.
+ */
+static void lbits_insert(lbits *rop, const uint64_t start, const lbits op, const uint64_t count)
+{
+  for (uint64_t i = 0; i < count; i += 64) {
+    uint64_t n = count - i < 64 ? count - i : 64;
+    wbits_insert(rop->bits, LIMBS(rop->len), start + i, lbits_limb(op, i / 64), n);
+  }
+  lbits_normalize(rop);
+}
+
+/*
+ * Or op, shifted left by shift bits, into the limbs of rop. The
+ * caller must ensure rop is large enough. op may share limbs with
+ * rop only if it is a prefix of rop no longer than shift, as when
+ * replicate_bits copies the bits it has already produced.
+ */
+static void lbits_ior_shifted(lbits *rop, const lbits op, const uint64_t shift)
+{
+  uint64_t word_shift = shift / 64;
+  uint64_t bit_shift = shift % 64;
+  uint64_t limbs = LIMBS(rop->len);
+  for (uint64_t i = 0; i < LIMBS(op.len) && i + word_shift < limbs; i++) {
+    uint64_t word = op.bits[i];
+    if (i == op.len / 64) {
+      word &= UINT64_MAX >> (64 - op.len % 64);
+    }
+    rop->bits[i + word_shift] |= word << bit_shift;
+    if (bit_shift != 0 && i + word_shift + 1 < limbs) {
+      rop->bits[i + word_shift + 1] |= word >> (64 - bit_shift);
+    }
+  }
+}
+
+static void mpz_set_lbits(mpz_t rop, const lbits op)
+{
+  mpz_import(rop, LIMBS(op.len), -1, sizeof(uint64_t), 0, 0, op.bits);
+}
+
+/*
+ * Set rop to the two's complement representation of op modulo 2^len.
+ */
+static void lbits_set_mpz(lbits *rop, const mpz_t op, const uint64_t len)
+{
+  uint64_t *old = lbits_prepare(rop, len, false);
+  memset(rop->bits, 0, rop->size * sizeof(uint64_t));
+  rop->len = len;
+  if (mpz_fits_slong_p(op)) {
+    int64_t v = mpz_get_si(op);
+    for (uint64_t i = 0; i < LIMBS(len); i++) {
+      rop->bits[i] = i == 0 ? (uint64_t) v : (v < 0 ? UINT64_MAX : 0);
+    }
+  } else {
+    mpz_t r;
+    mpz_init(r);
+    mpz_fdiv_r_2exp(r, op, len);
+    mpz_export(rop->bits, NULL, -1, sizeof(uint64_t), 0, 0, r);
+    mpz_clear(r);
+  }
+  lbits_normalize(rop);
+  sail_free(old);
+}
+
+static void lbits_set_sail_int(lbits *rop, const sail_int op, const uint64_t len)
+{
+  mpz_t value;
+  mpz_init(value);
+  lbits_set_mpz(rop, sail_int_as_mpz(value, op), len);
+  mpz_clear(value);
+}
+
+/*
+ * Set rop to the value of op interpreted as a two's complement
+ * integer.
+ */
+static void mpz_set_signed_lbits(mpz_t rop, const lbits op)
+{
+  mpz_set_lbits(rop, op);
+  if (lbits_tstbit(op, op.len - 1)) {
+    /* Subtract 2**len to get the negative value */
+    mpz_t m;
+    mpz_init(m);
+    mpz_setbit(m, op.len);
+    mpz_sub(rop, rop, m);
+    mpz_clear(m);
+  }
+}
+
+void CREATE(lbits)(lbits *rop)
+{
+  rop->size = 1;
+  rop->bits = sail_new_array(uint64_t, 1);
+  rop->bits[0] = 0;
+  rop->len = 0;
+}
+
+void RECREATE(lbits)(lbits *rop)
+{
+  rop->bits[0] = 0;
+  rop->len = 0;
+}
+
+void COPY(lbits)(lbits *rop, const lbits op)
+{
+  lbits_copy_extend(rop, op, op.len);
+}
+
+void KILL(lbits)(lbits *rop)
+{
+  sail_free(rop->bits);
+}
+
+void CREATE_OF(lbits, fbits)(lbits *rop, const uint64_t op, const uint64_t len, const bool direction)
+{
+  CREATE(lbits)(rop);
+  lbits_set_ui(rop, op, len);
+}
+
+fbits CREATE_OF(fbits, lbits)(const lbits op, const bool direction)
+{
+  return lbits_limb(op, 0);
+}
+
+sbits CREATE_OF(sbits, lbits)(const lbits op, const bool direction)
+{
+  sbits rop;
+  rop.bits = lbits_limb(op, 0);
+  rop.len = op.len;
+  return rop;
+}
+
+void RECREATE_OF(lbits, fbits)(lbits *rop, const uint64_t op, const uint64_t len, const bool direction)
+{
+  lbits_set_ui(rop, op, len);
+}
+
+void CREATE_OF(lbits, sbits)(lbits *rop, const sbits op, const bool direction)
+{
+  CREATE(lbits)(rop);
+  lbits_set_ui(rop, op.bits, op.len);
+}
+
+void RECREATE_OF(lbits, sbits)(lbits *rop, const sbits op, const bool direction)
+{
+  lbits_set_ui(rop, op.bits, op.len);
+}
+
+fbits CONVERT_OF(fbits, lbits)(const lbits op, const bool direction)
+{
+  return lbits_limb(op, 0);
+}
+
+void CONVERT_OF(lbits, fbits)(lbits *rop, const fbits op, const uint64_t len, const bool direction)
+{
+  lbits_set_ui(rop, op, len);
+}
+
+void CONVERT_OF(lbits, sbits)(lbits *rop, const sbits op, const bool direction)
+{
+  lbits_set_ui(rop, op.bits, op.len);
+}
+
+sbits CONVERT_OF(sbits, lbits)(const lbits op, const bool direction)
+{
+  sbits rop;
+  rop.len = op.len;
+  rop.bits = lbits_limb(op, 0);
+  return rop;
+}
+
+void append_64(lbits *rop, const lbits op, const fbits chunk)
+{
+  uint64_t *old = lbits_prepare(rop, op.len + 64, false);
+  for (uint64_t i = LIMBS(op.len); i-- > 0;) {
+    rop->bits[i + 1] = op.bits[i];
+  }
+  rop->bits[0] = chunk;
+  rop->len = op.len + 64;
+  sail_free(old);
+}
+
+fbits get_lbits_word(const lbits op, const uint64_t n)
+{
+  return lbits_limb(op, n);
+}
+
+void add_bits(lbits *rop, const lbits op1, const lbits op2)
+{
+  uint64_t *old = lbits_prepare(rop, op1.len, false);
+  wbits_add(rop->bits, op1.bits, op2.bits, LIMBS(op1.len), op1.len);
+  rop->len = op1.len;
+  sail_free(old);
+}
+
+void sub_bits(lbits *rop, const lbits op1, const lbits op2)
+{
+  assert(op1.len == op2.len);
+  uint64_t *old = lbits_prepare(rop, op1.len, false);
+  wbits_sub(rop->bits, op1.bits, op2.bits, LIMBS(op1.len), op1.len);
+  rop->len = op1.len;
+  sail_free(old);
+}
+
+void add_bits_int(lbits *rop, const lbits op1, const sail_int op2)
+{
+  lbits tmp;
+  CREATE(lbits)(&tmp);
+  lbits_set_sail_int(&tmp, op2, op1.len);
+  add_bits(rop, op1, tmp);
+  KILL(lbits)(&tmp);
+}
+
+void sub_bits_int(lbits *rop, const lbits op1, const sail_int op2)
+{
+  lbits tmp;
+  CREATE(lbits)(&tmp);
+  lbits_set_sail_int(&tmp, op2, op1.len);
+  sub_bits(rop, op1, tmp);
+  KILL(lbits)(&tmp);
+}
+
+void and_bits(lbits *rop, const lbits op1, const lbits op2)
+{
+  assert(op1.len == op2.len);
+  uint64_t *old = lbits_prepare(rop, op1.len, false);
+  wbits_and(rop->bits, op1.bits, op2.bits, LIMBS(op1.len));
+  rop->len = op1.len;
+  sail_free(old);
+}
+
+void or_bits(lbits *rop, const lbits op1, const lbits op2)
+{
+  assert(op1.len == op2.len);
+  uint64_t *old = lbits_prepare(rop, op1.len, false);
+  wbits_or(rop->bits, op1.bits, op2.bits, LIMBS(op1.len));
+  rop->len = op1.len;
+  sail_free(old);
+}
+
+void xor_bits(lbits *rop, const lbits op1, const lbits op2)
+{
+  assert(op1.len == op2.len);
+  uint64_t *old = lbits_prepare(rop, op1.len, false);
+  wbits_xor(rop->bits, op1.bits, op2.bits, LIMBS(op1.len));
+  rop->len = op1.len;
+  sail_free(old);
+}
+
+void not_bits(lbits *rop, const lbits op)
+{
+  uint64_t *old = lbits_prepare(rop, op.len, false);
+  wbits_not(rop->bits, op.bits, LIMBS(op.len), op.len);
+  rop->len = op.len;
+  sail_free(old);
+}
+
+void add_lanes(lbits *rop, const lbits op1, const lbits op2, const mach_int lane)
+{
+  assert(op1.len == op2.len);
+  uint64_t *old = lbits_prepare(rop, op1.len, false);
+  wbits_add_lanes(rop->bits, op1.bits, op2.bits, LIMBS(op1.len), (uint64_t) lane);
+  rop->len = op1.len;
+  lbits_normalize(rop);
+  sail_free(old);
+}
+
+void sub_lanes(lbits *rop, const lbits op1, const lbits op2, const mach_int lane)
+{
+  assert(op1.len == op2.len);
+  uint64_t *old = lbits_prepare(rop, op1.len, false);
+  wbits_sub_lanes(rop->bits, op1.bits, op2.bits, LIMBS(op1.len), (uint64_t) lane);
+  rop->len = op1.len;
+  lbits_normalize(rop);
+  sail_free(old);
+}
+
+void mults_vec(lbits *rop, const lbits op1, const lbits op2)
+{
+  mpz_t op1_int, op2_int;
+  mpz_init(op1_int);
+  mpz_init(op2_int);
+  mpz_set_signed_lbits(op1_int, op1);
+  mpz_set_signed_lbits(op2_int, op2);
+  mpz_mul(op1_int, op1_int, op2_int);
+  lbits_set_mpz(rop, op1_int, op1.len * 2);
+  mpz_clear(op1_int);
+  mpz_clear(op2_int);
+}
+
+void mult_vec(lbits *rop, const lbits op1, const lbits op2)
+{
+  mpz_t op1_int, op2_int;
+  mpz_init(op1_int);
+  mpz_init(op2_int);
+  mpz_set_lbits(op1_int, op1);
+  mpz_set_lbits(op2_int, op2);
+  mpz_mul(op1_int, op1_int, op2_int);
+  lbits_set_mpz(rop, op1_int, op1.len * 2);
+  mpz_clear(op1_int);
+  mpz_clear(op2_int);
+}
+
+void zeros(lbits *rop, const sail_int op)
+{
+  lbits_set_ui(rop, 0, sail_int_get_ui(op));
+}
+
+void zero_extend(lbits *rop, const lbits op, const sail_int len)
+{
+  assert(op.len <= sail_int_get_ui(len));
+  lbits_copy_extend(rop, op, sail_int_get_ui(len));
+}
+
+void sign_extend(lbits *rop, const lbits op, const sail_int len)
+{
+  assert(op.len <= sail_int_get_ui(len));
+  bool sign = lbits_tstbit(op, op.len - 1);
+  uint64_t op_len = op.len;
+  lbits_copy_extend(rop, op, sail_int_get_ui(len));
+  if (sign && op_len < rop->len) {
+    rop->bits[op_len / 64] |= UINT64_MAX << (op_len % 64);
+    for (uint64_t i = op_len / 64 + 1; i < LIMBS(rop->len); i++) {
+      rop->bits[i] = UINT64_MAX;
+    }
+    lbits_normalize(rop);
+  }
+}
+
+void count_leading_zeros(sail_int *rop, const lbits op)
+{
+  for (uint64_t i = LIMBS(op.len); i-- > 0;) {
+    if (op.bits[i] != 0) {
+      sail_int_set_ui(rop, op.len - (64 * i + 64 - __builtin_clzll(op.bits[i])));
+      return;
+    }
+  }
+  sail_int_set_ui(rop, op.len);
+}
+
+bool eq_bits(const lbits op1, const lbits op2)
+{
+  assert(op1.len == op2.len);
+  return wbits_eq(op1.bits, op2.bits, LIMBS(op1.len));
+}
+
+bool neq_bits(const lbits op1, const lbits op2)
+{
+  return !eq_bits(op1, op2);
+}
+
+void vector_subrange_lbits(lbits *rop,
+                           const lbits op,
+                           const sail_int n_mpz,
+                           const sail_int m_mpz)
+{
+  uint64_t n = sail_int_get_ui(n_mpz);
+  uint64_t m = sail_int_get_ui(m_mpz);
+
+  lbits_extract(rop, op, m, n - (m - 1ul));
+}
+
+void vector_subrange_inc_lbits(lbits *rop,
+                               const lbits op,
+                               const sail_int n_mpz,
+                               const sail_int m_mpz)
+{
+  uint64_t n = sail_int_get_ui(n_mpz);
+  uint64_t m = sail_int_get_ui(m_mpz);
+
+  lbits_extract(rop, op, (op.len - 1) - m, m - (n - 1ul));
+}
+
+void sail_truncate(lbits *rop, const lbits op, const sail_int len)
+{
+  assert(op.len >= sail_int_get_ui(len));
+  lbits_extract(rop, op, 0, sail_int_get_ui(len));
+}
+
+void sail_truncateLSB(lbits *rop, const lbits op, const sail_int len)
+{
+  uint64_t rlen = sail_int_get_ui(len);
+  assert(op.len >= rlen);
+  lbits_extract(rop, op, op.len - rlen, rlen);
+}
+
+fbits bitvector_access(const lbits op, const sail_int n_mpz)
+{
+  return (fbits) lbits_tstbit(op, sail_int_get_ui(n_mpz));
+}
+
+fbits bitvector_access_inc(const lbits op, const sail_int n_mpz)
+{
+  return (fbits) lbits_tstbit(op, (op.len - 1) - sail_int_get_ui(n_mpz));
+}
+
+void sail_unsigned(sail_int *rop, const lbits op)
+{
+  if (op.len < 64) {
+    CONVERT_OF(sail_int, mach_int)(rop, (mach_int) lbits_limb(op, 0));
+    return;
+  }
+  mpz_t value;
+  mpz_init(value);
+  mpz_set_lbits(value, op);
+  sail_int_set_mpz(rop, value);
+  mpz_clear(value);
+}
+
+void sail_signed(sail_int *rop, const lbits op)
+{
+  if (op.len == 0) {
+    CONVERT_OF(sail_int, mach_int)(rop, 0);
+    return;
+  } else if (op.len <= 64) {
+    CONVERT_OF(sail_int, mach_int)(rop, fast_signed(lbits_limb(op, 0), op.len));
+    return;
+  }
+  mpz_t value;
+  mpz_init(value);
+  mpz_set_signed_lbits(value, op);
+  sail_int_set_mpz(rop, value);
+  mpz_clear(value);
+}
+
+void append(lbits *rop, const lbits op1, const lbits op2)
+{
+  uint64_t len = op1.len + op2.len;
+  uint64_t *old = lbits_prepare(rop, len, rop->bits == op1.bits);
+  uint64_t low = LIMBS(op2.len);
+  if (rop->bits != op2.bits) {
+    memcpy(rop->bits, op2.bits, low * sizeof(uint64_t));
+  }
+  memset(rop->bits + low, 0, (rop->size - low) * sizeof(uint64_t));
+  rop->len = len;
+  lbits_ior_shifted(rop, op1, op2.len);
+  sail_free(old);
+}
+
+void replicate_bits(lbits *rop, const lbits op1, const sail_int op2)
+{
+  uint64_t times = sail_int_get_ui(op2);
+  uint64_t len = op1.len * times;
+
+  if (len <= 64) {
+    lbits_set_ui(rop, fast_replicate_bits(op1.len, lbits_limb(op1, 0), times), len);
+    return;
+  }
+
+  uint64_t *old = lbits_prepare(rop, len, rop->bits == op1.bits);
+  memset(rop->bits, 0, rop->size * sizeof(uint64_t));
+  rop->len = len;
+  memcpy(rop->bits, op1.bits, LIMBS(op1.len) * sizeof(uint64_t));
+
+  // Double the number of copies each time by copying the bits we
+  // already have, which are always a whole number of copies of op1.
+  uint64_t copied = op1.len;
+  while (copied < len) {
+    lbits prefix = { .len = copied < len - copied ? copied : len - copied, .size = 0, .bits = rop->bits };
+    lbits_ior_shifted(rop, prefix, copied);
+    copied += prefix.len;
+  }
+  sail_free(old);
+}
+
+void get_slice_int(lbits *rop, const sail_int len_mpz, const sail_int n, const sail_int start_mpz)
+{
+  mpz_t shifted;
+  mpz_init(shifted);
+  mpz_fdiv_q_2exp(shifted, sail_int_as_mpz(shifted, n), sail_int_get_ui(start_mpz));
+  lbits_set_mpz(rop, shifted, sail_int_get_ui(len_mpz));
+  mpz_clear(shifted);
+}
+
+void set_slice_int(sail_int *rop,
+                   const sail_int len_mpz,
+                   const sail_int n,
+                   const sail_int start_mpz,
+                   const lbits slice)
+{
+  uint64_t start = sail_int_get_ui(start_mpz);
+
+  mpz_t value;
+  mpz_init(value);
+  mpz_set(value, sail_int_as_mpz(value, n));
+
+  for (uint64_t i = 0; i < slice.len; i++) {
+    if (lbits_tstbit(slice, i)) {
+      mpz_setbit(value, i + start);
+    } else {
+      mpz_clrbit(value, i + start);
+    }
+  }
+
+  sail_int_set_mpz(rop, value);
+  mpz_clear(value);
+}
+
+void update_lbits(lbits *rop, const lbits op, const sail_int n_mpz, const uint64_t bit)
+{
+  lbits_copy_extend(rop, op, op.len);
+  lbits_setbit(rop, sail_int_get_ui(n_mpz), bit != UINT64_C(0));
+}
+
+void update_lbits_inc(lbits *rop, const lbits op, const sail_int n_mpz, const uint64_t bit)
+{
+  lbits_copy_extend(rop, op, op.len);
+  lbits_setbit(rop, (op.len - 1) - sail_int_get_ui(n_mpz), bit != UINT64_C(0));
+}
+
+void vector_update_subrange_lbits(lbits *rop,
+                                  const lbits op,
+                                  const sail_int n_mpz,
+                                  const sail_int m_mpz,
+                                  const lbits slice)
+{
+  uint64_t n = sail_int_get_ui(n_mpz);
+  uint64_t m = sail_int_get_ui(m_mpz);
+
+  lbits_copy_extend(rop, op, op.len);
+  lbits_insert(rop, m, slice, n - (m - 1ul));
+}
+
+void vector_update_subrange_inc_lbits(lbits *rop,
+                                      const lbits op,
+                                      const sail_int n_mpz,
+                                      const sail_int m_mpz,
+                                      const lbits slice)
+{
+  uint64_t n = sail_int_get_ui(n_mpz);
+  uint64_t m = sail_int_get_ui(m_mpz);
+
+  lbits_copy_extend(rop, op, op.len);
+
+  for (uint64_t i = 0; i < m - (n - 1ul); i++) {
+    uint64_t out_bit = ((op.len - 1) - m) + i;
+    lbits_setbit(rop, out_bit, lbits_tstbit(slice, (slice.len - 1) - i));
+  }
+}
+
+void slice(lbits *rop, const lbits op, const sail_int start_mpz, const sail_int len_mpz)
+{
+  assert(sail_int_get_ui(start_mpz) + sail_int_get_ui(len_mpz) <= op.len);
+  lbits_extract(rop, op, sail_int_get_ui(start_mpz), sail_int_get_ui(len_mpz));
+}
+
+void slice_inc(lbits *rop, const lbits op, const sail_int start_mpz, const sail_int len_mpz)
+{
+  assert(sail_int_get_ui(start_mpz) + sail_int_get_ui(len_mpz) <= op.len);
+  uint64_t start = sail_int_get_ui(start_mpz);
+  uint64_t len = sail_int_get_ui(len_mpz);
+
+  lbits_extract(rop, op, (op.len - start) - len, len);
+}
+
+void set_slice(lbits *rop,
+               const sail_int len_mpz,
+               const sail_int slen_mpz,
+               const lbits op,
+               const sail_int start_mpz,
+               const lbits slice)
+{
+  lbits_copy_extend(rop, op, op.len);
+  lbits_insert(rop, sail_int_get_ui(start_mpz), slice, slice.len);
+}
+
+void shiftl(lbits *rop, const lbits op1, const sail_int op2)
+{
+  uint64_t *old = lbits_prepare(rop, op1.len, false);
+  wbits_shl(rop->bits, op1.bits, LIMBS(op1.len), sail_int_get_ui(op2), op1.len);
+  rop->len = op1.len;
+  sail_free(old);
+}
+
+void shiftr(lbits *rop, const lbits op1, const sail_int op2)
+{
+  uint64_t *old = lbits_prepare(rop, op1.len, false);
+  wbits_lshr(rop->bits, op1.bits, LIMBS(op1.len), sail_int_get_ui(op2));
+  rop->len = op1.len;
+  sail_free(old);
+}
+
+void arith_shiftr(lbits *rop, const lbits op1, const sail_int op2)
+{
+  uint64_t shift = sail_int_get_ui(op2);
+  bool sign = lbits_tstbit(op1, op1.len - 1);
+  shiftr(rop, op1, op2);
+  if (sign) {
+    for (uint64_t i = shift < rop->len ? rop->len - shift : 0; i < rop->len; i++) {
+      lbits_setbit(rop, i, true);
+    }
+  }
+}
+
+/*
+ * The shift amount for the bitvector versions of the shifts is the
+ * low 64-bits of op2, which is what the GMP implementation uses.
+ */
+void shift_bits_left(lbits *rop, const lbits op1, const lbits op2)
+{
+  uint64_t *old = lbits_prepare(rop, op1.len, false);
+  wbits_shl(rop->bits, op1.bits, LIMBS(op1.len), lbits_limb(op2, 0), op1.len);
+  rop->len = op1.len;
+  sail_free(old);
+}
+
+void shift_bits_right(lbits *rop, const lbits op1, const lbits op2)
+{
+  uint64_t *old = lbits_prepare(rop, op1.len, false);
+  wbits_lshr(rop->bits, op1.bits, LIMBS(op1.len), lbits_limb(op2, 0));
+  rop->len = op1.len;
+  sail_free(old);
+}
+
+void shift_bits_right_arith(lbits *rop, const lbits op1, const lbits op2)
+{
+  uint64_t shift = lbits_limb(op2, 0);
+  bool sign = lbits_tstbit(op1, op1.len - 1);
+  shift_bits_right(rop, op1, op2);
+  if (sign) {
+    for (uint64_t i = shift < rop->len ? rop->len - shift : 0; i < rop->len; i++) {
+      lbits_setbit(rop, i, true);
+    }
+  }
+}
+
+void reverse_endianness(lbits *rop, const lbits op)
+{
+  uint64_t len = op.len;
+
+  if (len <= 64 && len % 8 == 0) {
+    lbits_set_ui(rop, fast_reverse_endianness(lbits_limb(op, 0), len), len);
+    return;
+  }
+
+  uint64_t limbs = LIMBS(len);
+  uint64_t *old = lbits_prepare(rop, len, rop->bits == op.bits);
+  rop->len = len;
+  if (len % 8 == 0) {
+    // Reverse the order of the limbs and the bytes within them, then
+    // shift away the zero bytes that were above the top of op.
+    for (uint64_t i = 0; i < limbs; i++) {
+      rop->bits[i] = fast_reverse_endianness(op.bits[limbs - 1 - i], 64);
+    }
+    wbits_lshr(rop->bits, rop->bits, limbs, limbs * 64 - len);
+  } else {
+    uint64_t bytes = (len + 7) / 8;
+    memset(rop->bits, 0, rop->size * sizeof(uint64_t));
+    for (uint64_t byte = 0; byte < bytes; byte++) {
+      fbits b = wbits_extract(op.bits, limbs, byte * 8, 8);
+      wbits_insert(rop->bits, limbs, (bytes - 1 - byte) * 8, b, 8);
+    }
+    lbits_normalize(rop);
+  }
+  sail_free(old);
+}
+
+#ifdef __SIZEOF_INT128__
+
+static void lbits_set_fbits128(lbits *rop, const fbits128 op, const uint64_t len)
+{
+  uint64_t *old = lbits_prepare(rop, len, false);
+  memset(rop->bits, 0, rop->size * sizeof(uint64_t));
+  rop->bits[0] = (uint64_t) op;
+  if (rop->size > 1) {
+    rop->bits[1] = (uint64_t) (op >> 64);
+  }
+  rop->len = len;
+  lbits_normalize(rop);
+  sail_free(old);
+}
+
+void CREATE_OF(lbits, fbits128)(lbits *rop, const fbits128 op, const uint64_t len, const bool direction)
+{
+  CREATE(lbits)(rop);
+  lbits_set_fbits128(rop, op, len);
+}
+
+void RECREATE_OF(lbits, fbits128)(lbits *rop, const fbits128 op, const uint64_t len, const bool direction)
+{
+  lbits_set_fbits128(rop, op, len);
+}
+
+fbits128 CREATE_OF(fbits128, lbits)(const lbits op, const bool direction)
+{
+  return FBITS128_C(lbits_limb(op, 1), lbits_limb(op, 0));
+}
+
+fbits128 CONVERT_OF(fbits128, lbits)(const lbits op, const bool direction)
+{
+  return FBITS128_C(lbits_limb(op, 1), lbits_limb(op, 0));
+}
+
+void CONVERT_OF(lbits, fbits128)(lbits *rop, const fbits128 op, const uint64_t len, const bool direction)
+{
+  lbits_set_fbits128(rop, op, len);
+}
+
+#endif
+
+void lbits_of_wbits(lbits *rop, const uint64_t *op, const size_t words, const uint64_t len)
+{
+  lbits tmp = { .len = len, .size = words, .bits = (uint64_t *) op };
+  lbits_copy_extend(rop, tmp, len);
+}
+
+void wbits_of_lbits(uint64_t *rop, const size_t words, const lbits op)
+{
+  uint64_t limbs = LIMBS(op.len) < words ? LIMBS(op.len) : words;
+  memset(rop, 0, words * sizeof(uint64_t));
+  memcpy(rop, op.bits, limbs * sizeof(uint64_t));
+}
+
+static char hex_digit(const fbits nibble)
+{
+  return (char) (nibble < 10 ? '0' + nibble : 'A' + (nibble - 10));
+}
+
+void string_of_lbits(sail_string *str, const lbits op)
+{
+  sail_free(*str);
+  if ((op.len % 4) == 0) {
+    uint64_t digits = op.len == 0 ? 1 : op.len / 4;
+    *str = (char *) sail_malloc((digits + 3) * sizeof(char));
+    (*str)[0] = '0';
+    (*str)[1] = 'x';
+    for (uint64_t i = 0; i < digits; ++i) {
+      (*str)[i + 2] = hex_digit(wbits_extract(op.bits, LIMBS(op.len), 4 * (digits - 1 - i), 4));
+    }
+    (*str)[digits + 2] = '\0';
+  } else {
+    *str = (char *) sail_malloc((op.len + 3) * sizeof(char));
+    (*str)[0] = '0';
+    (*str)[1] = 'b';
+    for (uint64_t i = 1; i <= op.len; ++i) {
+      (*str)[i + 1] = lbits_tstbit(op, op.len - i) + 0x30;
+    }
+    (*str)[op.len + 2] = '\0';
+  }
+}
+
+void decimal_string_of_lbits(sail_string *str, const lbits op)
+{
+  mpz_t value;
+  mpz_init(value);
+  mpz_set_lbits(value, op);
+  sail_free(*str);
+  gmp_asprintf(str, "%Zd", value);
+  mpz_clear(value);
+}
+
+void parse_hex_bits(lbits *res, const sail_int n, const_sail_string hex)
+{
+  mpz_t value;
+  mpz_init(value);
+  if (!valid_hex_bits(n, hex) || mpz_set_str(value, hex + 2, 16) != 0) {
+    // On failure, we return a zero bitvector of the correct width
+    mpz_set_ui(value, 0);
+  }
+  lbits_set_mpz(res, value, sail_int_get_ui(n));
+  mpz_clear(value);
+}
+
+void fprint_bits(const_sail_string pre,
+                 const lbits op,
+                 const_sail_string post,
+                 FILE *stream)
+{
+  fputs(pre, stream);
+
+  if (op.len % 4 == 0) {
+    fputs("0x", stream);
+    for (uint64_t i = op.len / 4; i > 0; --i) {
+      fputc(hex_digit(wbits_extract(op.bits, LIMBS(op.len), 4 * (i - 1), 4)), stream);
+    }
+  } else {
+    fputs("0b", stream);
+    for (uint64_t i = op.len; i > 0; --i) {
+      fputc(lbits_tstbit(op, i - 1) + 0x30, stream);
+    }
+  }
+
+  fputs(post, stream);
+}
+
+void arm_align(lbits *rop, const lbits x_bv, const sail_int y_mpz)
+{
+  uint64_t x = lbits_limb(x_bv, 0);
+  uint64_t y = sail_int_get_ui(y_mpz);
+  uint64_t z = y * (x / y);
+  uint64_t n = x_bv.len;
+  lbits_set_ui(rop, safe_rshift(UINT64_MAX, 64l - (n - 1)) & z, n);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
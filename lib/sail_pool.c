@@ -0,0 +1,266 @@
+/****************************************************************************/
+/*     Sail                                                                 */
+/*                                                                          */
+/*  Sail and the Sail architecture models here, comprising all files and    */
+/*  directories except the ASL-derived Sail code in the aarch64 directory,  */
+/*  are subject to the BSD two-clause licence below.                        */
+/*                                                                          */
+/*  The ASL derived parts of the ARMv8.3 specification in                   */
+/*  aarch64/no_vector and aarch64/full are copyright ARM Ltd.               */
+/*                                                                          */
+/*  Copyright (c) 2013-2021                                                 */
+/*    Kathyrn Gray                                                          */
+/*    Shaked Flur                                                           */
+/*    Stephen Kell                                                          */
+/*    Gabriel Kerneis                                                       */
+/*    Robert Norton-Wright                                                  */
+/*    Christopher Pulte                                                     */
+/*    Peter Sewell                                                          */
+/*    Alasdair Armstrong                                                    */
+/*    Brian Campbell                                                        */
+/*    Thomas Bauereiss                                                      */
+/*    Anthony Fox                                                           */
+/*    Jon French                                                            */
+/*    Dominic Mulligan                                                      */
+/*    Stephen Kell                                                          */
+/*    Mark Wassell                                                          */
+/*    Alastair Reid (Arm Ltd)                                               */
+/*                                                                          */
+/*  All rights reserved.                                                    */
+/*                                                                          */
+/*  This work was partially supported by EPSRC grant EP/K008528/1 <a        */
+/*  href="http://www.cl.cam.ac.uk/users/pes20/rems">REMS: Rigorous          */
+/*  Engineering for Mainstream Systems</a>, an ARM iCASE award, EPSRC IAA   */
+/*  KTF funding, and donations from Arm.  This project has received         */
+/*  funding from the European Research Council (ERC) under the European     */
+/*  Union’s Horizon 2020 research and innovation programme (grant           */
+/*  agreement No 789108, ELVER).                                            */
+/*                                                                          */
+/*  This software was developed by SRI International and the University of  */
+/*  Cambridge Computer Laboratory (Department of Computer Science and       */
+/*  Technology) under DARPA/AFRL contracts FA8650-18-C-7809 ("CIFV")        */
+/*  and FA8750-10-C-0237 ("CTSRD").                                         */
+/*                                                                          */
+/*  Redistribution and use in source and binary forms, with or without      */
+/*  modification, are permitted provided that the following conditions      */
+/*  are met:                                                                */
+/*  1. Redistributions of source code must retain the above copyright       */
+/*     notice, this list of conditions and the following disclaimer.        */
+/*  2. Redistributions in binary form must reproduce the above copyright    */
+/*     notice, this list of conditions and the following disclaimer in      */
+/*     the documentation and/or other materials provided with the           */
+/*     distribution.                                                        */
+/*                                                                          */
+/*  THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''      */
+/*  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED       */
+/*  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A         */
+/*  PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR     */
+/*  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,            */
+/*  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT        */
+/*  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF        */
+/*  USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND     */
+/*  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,      */
+/*  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT      */
+/*  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF      */
+/*  SUCH DAMAGE.                                                            */
+/****************************************************************************/
+
+/*
+ * A pool allocator for the small, short lived allocations made by the
+ * runtime and the generated code, which are mostly the mpz_t headers
+ * and limbs of sail_int and lbits temporaries. It is only compiled
+ * when SAIL_POOL_ALLOC is defined, see sail.h.
+ *
+ * Memory is taken from malloc in slabs of SAIL_POOL_SLAB bytes,
+ * aligned to their size, and each slab holds blocks of a single size
+ * class. Freed blocks go onto a free list for their class, so after
+ * the first few calls of a function its temporaries are created and
+ * killed without calling malloc or free. Larger allocations are
+ * passed straight to malloc. A hash set of slab addresses tells us
+ * which blocks belong to the pool, so memory from malloc can still be
+ * passed to sail_free and sail_realloc.
+ */
+#ifdef SAIL_POOL_ALLOC
+
+#include<stdint.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include"sail.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAIL_POOL_SLAB_BITS 16
+#define SAIL_POOL_SLAB ((size_t)1 << SAIL_POOL_SLAB_BITS)
+
+/* Size classes are powers of two from 16 to 1024 bytes */
+#define SAIL_POOL_MIN_BITS 4
+#define SAIL_POOL_CLASSES 7
+#define SAIL_POOL_MAX ((size_t)1 << (SAIL_POOL_MIN_BITS + SAIL_POOL_CLASSES - 1))
+
+struct sail_pool_block {
+  struct sail_pool_block *next;
+};
+
+/*
+ * The header at the start of each slab, padded to the smallest block
+ * size so every block is 16 byte aligned.
+ */
+struct sail_pool_slab {
+  size_t size_class;
+  size_t padding;
+};
+
+static struct sail_pool_block *sail_pool_free_lists[SAIL_POOL_CLASSES];
+
+/* The unused part of the most recent slab for each size class */
+static unsigned char *sail_pool_next[SAIL_POOL_CLASSES];
+static unsigned char *sail_pool_end[SAIL_POOL_CLASSES];
+
+/* Open addressing, with zero marking an empty entry */
+static uintptr_t *sail_pool_slabs = NULL;
+static size_t sail_pool_slabs_capacity = 0;
+static size_t sail_pool_slabs_count = 0;
+
+static void *sail_pool_check(void *ptr)
+{
+  if (ptr == NULL) {
+    fprintf(stderr, "[Sail] Out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+
+static size_t sail_pool_hash(uintptr_t slab, size_t capacity)
+{
+  uint64_t key = (uint64_t)(slab >> SAIL_POOL_SLAB_BITS);
+  return (size_t)((key * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (capacity - 1);
+}
+
+static void sail_pool_insert(uintptr_t *slabs, size_t capacity, uintptr_t slab)
+{
+  size_t i = sail_pool_hash(slab, capacity);
+  while (slabs[i] != 0) i = (i + 1) & (capacity - 1);
+  slabs[i] = slab;
+}
+
+static void sail_pool_add_slab(uintptr_t slab)
+{
+  if (2 * (sail_pool_slabs_count + 1) > sail_pool_slabs_capacity) {
+    size_t capacity = sail_pool_slabs_capacity == 0 ? 64 : 2 * sail_pool_slabs_capacity;
+    uintptr_t *slabs = (uintptr_t *)sail_pool_check(calloc(capacity, sizeof(uintptr_t)));
+    for (size_t i = 0; i < sail_pool_slabs_capacity; i++) {
+      if (sail_pool_slabs[i] != 0) sail_pool_insert(slabs, capacity, sail_pool_slabs[i]);
+    }
+    free(sail_pool_slabs);
+    sail_pool_slabs = slabs;
+    sail_pool_slabs_capacity = capacity;
+  }
+  sail_pool_insert(sail_pool_slabs, sail_pool_slabs_capacity, slab);
+  sail_pool_slabs_count++;
+}
+
+/* Returns NULL if ptr was not allocated by the pool */
+static struct sail_pool_slab *sail_pool_find_slab(void *ptr)
+{
+  if (sail_pool_slabs_count == 0) return NULL;
+  uintptr_t slab = (uintptr_t)ptr & ~(uintptr_t)(SAIL_POOL_SLAB - 1);
+  size_t i = sail_pool_hash(slab, sail_pool_slabs_capacity);
+  while (sail_pool_slabs[i] != 0) {
+    if (sail_pool_slabs[i] == slab) return (struct sail_pool_slab *)slab;
+    i = (i + 1) & (sail_pool_slabs_capacity - 1);
+  }
+  return NULL;
+}
+
+static size_t sail_pool_block_size(size_t size_class)
+{
+  return (size_t)1 << (size_class + SAIL_POOL_MIN_BITS);
+}
+
+static void sail_pool_new_slab(size_t size_class)
+{
+  unsigned char *slab = (unsigned char *)sail_pool_check(aligned_alloc(SAIL_POOL_SLAB, SAIL_POOL_SLAB));
+  ((struct sail_pool_slab *)slab)->size_class = size_class;
+  sail_pool_add_slab((uintptr_t)slab);
+
+  size_t block_size = sail_pool_block_size(size_class);
+  size_t blocks = (SAIL_POOL_SLAB - sizeof(struct sail_pool_slab)) / block_size;
+  sail_pool_next[size_class] = slab + sizeof(struct sail_pool_slab);
+  sail_pool_end[size_class] = sail_pool_next[size_class] + blocks * block_size;
+}
+
+void *sail_pool_malloc(size_t size)
+{
+  if (size > SAIL_POOL_MAX) return sail_pool_check(malloc(size));
+
+  size_t size_class = 0;
+  while (sail_pool_block_size(size_class) < size) size_class++;
+
+  struct sail_pool_block *block = sail_pool_free_lists[size_class];
+  if (block != NULL) {
+    sail_pool_free_lists[size_class] = block->next;
+    return block;
+  }
+
+  if (sail_pool_next[size_class] == sail_pool_end[size_class]) sail_pool_new_slab(size_class);
+  void *ptr = sail_pool_next[size_class];
+  sail_pool_next[size_class] += sail_pool_block_size(size_class);
+  return ptr;
+}
+
+void sail_pool_free(void *ptr)
+{
+  if (ptr == NULL) return;
+
+  struct sail_pool_slab *slab = sail_pool_find_slab(ptr);
+  if (slab == NULL) {
+    free(ptr);
+    return;
+  }
+
+  struct sail_pool_block *block = (struct sail_pool_block *)ptr;
+  block->next = sail_pool_free_lists[slab->size_class];
+  sail_pool_free_lists[slab->size_class] = block;
+}
+
+void *sail_pool_realloc(void *ptr, size_t size)
+{
+  if (ptr == NULL) return sail_pool_malloc(size);
+
+  struct sail_pool_slab *slab = sail_pool_find_slab(ptr);
+  if (slab == NULL) return sail_pool_check(realloc(ptr, size));
+
+  size_t block_size = sail_pool_block_size(slab->size_class);
+  if (size <= block_size) return ptr;
+
+  void *new_ptr = sail_pool_malloc(size);
+  memcpy(new_ptr, ptr, block_size);
+  sail_pool_free(ptr);
+  return new_ptr;
+}
+
+/* GMP passes the old sizes, which we do not need */
+static void *sail_pool_gmp_realloc(void *ptr, size_t old_size, size_t new_size)
+{
+  return sail_pool_realloc(ptr, new_size);
+}
+
+static void sail_pool_gmp_free(void *ptr, size_t size)
+{
+  sail_pool_free(ptr);
+}
+
+void setup_pool_alloc(void)
+{
+  mp_set_memory_functions(sail_pool_malloc, sail_pool_gmp_realloc, sail_pool_gmp_free);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+/****************************************************************************/
+/*     Sail                                                                 */
+/*                                                                          */
+/*  Sail and the Sail architecture models here, comprising all files and    */
+/*  directories except the ASL-derived Sail code in the aarch64 directory,  */
+/*  are subject to the BSD two-clause licence below.                        */
+/*                                                                          */
+/*  The ASL derived parts of the ARMv8.3 specification in                   */
+/*  aarch64/no_vector and aarch64/full are copyright ARM Ltd.               */
+/*                                                                          */
+/*  Copyright (c) 2013-2021                                                 */
+/*    Kathyrn Gray                                                          */
+/*    Shaked Flur                                                           */
+/*    Stephen Kell                                                          */
+/*    Gabriel Kerneis                                                       */
+/*    Robert Norton-Wright                                                  */
+/*    Christopher Pulte                                                     */
+/*    Peter Sewell                                                          */
+/*    Alasdair Armstrong                                                    */
+/*    Brian Campbell                                                        */
+/*    Thomas Bauereiss                                                      */
+/*    Anthony Fox                                                           */
+/*    Jon French                                                            */
+/*    Dominic Mulligan                                                      */
+/*    Stephen Kell                                                          */
+/*    Mark Wassell                                                          */
+/*    Alastair Reid (Arm Ltd)                                               */
+/*                                                                          */
+/*  All rights reserved.                                                    */
+/*                                                                          */
+/*  This work was partially supported by EPSRC grant EP/K008528/1 <a        */
+/*  href="http://www.cl.cam.ac.uk/users/pes20/rems">REMS: Rigorous          */
+/*  Engineering for Mainstream Systems</a>, an ARM iCASE award, EPSRC IAA   */
+/*  KTF funding, and donations from Arm.  This project has received         */
+/*  funding from the European Research Council (ERC) under the European     */
+/*  Union’s Horizon 2020 research and innovation programme (grant           */
+/*  agreement No 789108, ELVER).                                            */
+/*                                                                          */
+/*  This software was developed by SRI International and the University of  */
+/*  Cambridge Computer Laboratory (Department of Computer Science and       */
+/*  Technology) under DARPA/AFRL contracts FA8650-18-C-7809 ("CIFV")        */
+/*  and FA8750-10-C-0237 ("CTSRD").                                         */
+/*                                                                          */
+/*  Redistribution and use in source and binary forms, with or without      */
+/*  modification, are permitted provided that the following conditions      */
+/*  are met:                                                                */
+/*  1. Redistributions of source code must retain the above copyright       */
+/*     notice, this list of conditions and the following disclaimer.        */
+/*  2. Redistributions in binary form must reproduce the above copyright    */
+/*     notice, this list of conditions and the following disclaimer in      */
+/*     the documentation and/or other materials provided with the           */
+/*     distribution.                                                        */
+/*                                                                          */
+/*  THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''      */
+/*  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED       */
+/*  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A         */
+/*  PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR     */
+/*  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,            */
+/*  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT        */
+/*  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF        */
+/*  USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND     */
+/*  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,      */
+/*  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT      */
+/*  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF      */
+/*  SUCH DAMAGE.                                                            */
+/****************************************************************************/
+
+#ifndef SAIL_TRACE_H
+#define SAIL_TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The binary trace format written by the RTS when given --trace-file,
+ * and read by sailtrace to reproduce the text trace.
+ *
+ * The file starts with SAIL_TRACE_MAGIC, followed by records
+ * consisting of a tag byte and the fields listed below. Numbers are
+ * encoded as unsigned LEB128, and strings as their length followed by
+ * their bytes. The value count in a START or END record is a single
+ * byte, and gives the number of value records that follow it, which
+ * are the arguments or return value of the call.
+ */
+#define SAIL_TRACE_MAGIC "SAILTRC2"
+
+enum sail_trace_tag {
+  SAIL_TRACE_NAME = 1, /* function id, name */
+  SAIL_TRACE_START,    /* function id, depth, value count */
+  SAIL_TRACE_END,      /* depth, value count */
+  SAIL_TRACE_UNIT,
+  SAIL_TRACE_UNKNOWN,
+  SAIL_TRACE_FALSE,
+  SAIL_TRACE_TRUE,
+  SAIL_TRACE_FBITS,    /* bits */
+  SAIL_TRACE_BITS,     /* length, bits, for bitvectors of up to 64 bits */
+  SAIL_TRACE_INT,      /* zigzag encoded integer, if it fits in 64 bits */
+  SAIL_TRACE_STRING,   /* anything else, already formatted as text */
+};
+
+/*
+ * The instruction retire trace written with --retire-trace starts
+ * with SAIL_RETIRE_MAGIC, followed by records consisting of a tag
+ * byte and the fields listed below, each encoded as an unsigned
+ * LEB128 number.
+ */
+#define SAIL_RETIRE_MAGIC "SAILRET1"
+
+enum sail_retire_tag {
+  SAIL_RETIRE_INSTR = 1, /* pc, opcode */
+  SAIL_RETIRE_REG_WRITE, /* register number, value */
+  SAIL_RETIRE_MEM_READ,  /* address, size in bytes, value */
+  SAIL_RETIRE_MEM_WRITE, /* address, size in bytes, value */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,6 +14,8 @@ let opt_cumulative_table = ref None
 let opt_histogram = ref false
 let opt_cumulative_histogram = ref None
 let opt_colour_count = ref false
+let opt_heat = ref false
+let opt_hottest = ref None
 
 type color = { hue : int; saturation : int }
 
@@ -96,6 +98,14 @@ let options =
         Arg.Set opt_colour_count,
         " colour by number of files a span appears in (instead of nesting depth)"
       );
+      ( "--heat",
+        Arg.Set opt_heat,
+        " colour by how many times each span was reached (requires a model built with -c_coverage_counts)"
+      );
+      ( "--hottest",
+        Arg.Int (fun n -> opt_hottest := Some n),
+        "<int> print a table of the most frequently reached functions, branches, and branch targets"
+      );
       ("--werror", Arg.Set opt_werror, " turn warnings into errors");
     ]
 
@@ -148,7 +158,151 @@ let add_span spans file l1 c1 l2 c2 =
     )
     spans
 
-let read_more_coverage filename spans =
+(* Hit counts for each kind of span (F, B, or T) in each file, summed
+   over all the taken files. Coverage files produced without
+   -c_coverage_counts count each span as a single hit. *)
+let hits : (char * string * span, int) Hashtbl.t = Hashtbl.create 4096
+
+(* Function names from the all branches file, so we can name them in the --hottest table *)
+let function_names : (string * span, string) Hashtbl.t = Hashtbl.create 1024
+
+let add_hits kind file l1 c1 l2 c2 count =
+  let key = (kind, Filename.basename file, { l1; c1; l2; c2 }) in
+  Hashtbl.replace hits key (count + Option.value ~default:0 (Hashtbl.find_opt hits key))
+
+let parse_hits rest = try Scanf.sscanf rest ", %d" (fun n -> n) with Scanf.Scan_failure _ | End_of_file | Failure _ -> 1
+
+(* The file and span for each function, branch, and branch target id
+   in the all branches file, used to decode binary coverage files *)
+let span_ids : (char * int, string * span) Hashtbl.t = Hashtbl.create 4096
+
+let add_span_id kind id file l1 c1 l2 c2 = Hashtbl.replace span_ids (kind, id) (file, { l1; c1; l2; c2 })
+
+(* The binary coverage format written by the coverage library, see
+   lib/coverage/src/lib.rs for a description. Each table is the number
+   of ids and either a bitmap or an array of hit counts. *)
+type binary_coverage = { counting : bool; table_hash : Int64.t; tables : (int * Int64.t array) array }
+
+let binary_magic = "SAILCOV1"
+
+let binary_kinds = ['F'; 'B'; 'T']
+
+let is_binary_coverage filename =
+  let chan = open_in_bin filename in
+  let magic = try really_input_string chan 8 with End_of_file -> "" in
+  close_in chan;
+  magic = binary_magic
+
+let read_binary_coverage filename =
+  let chan = open_in_bin filename in
+  let data = Bytes.create (in_channel_length chan) in
+  really_input chan data 0 (Bytes.length data);
+  close_in chan;
+  try
+    let pos = ref 24 in
+    let read_word () =
+      let word = Bytes.get_int64_le data !pos in
+      pos := !pos + 8;
+      word
+    in
+    let counting = Int32.logand (Bytes.get_int32_le data 8) 1l <> 0l in
+    let read_table () =
+      let len = Int64.to_int (read_word ()) in
+      (len, Array.init (if counting then len else (len + 63) / 64) (fun _ -> read_word ()))
+    in
+    let functions = read_table () in
+    let branches = read_table () in
+    let branch_targets = read_table () in
+    { counting; table_hash = Bytes.get_int64_le data 16; tables = [| functions; branches; branch_targets |] }
+  with Invalid_argument _ ->
+    prerr_endline ("Error: truncated coverage file " ^ filename);
+    exit 1
+
+let table_hits counting (_, words) id =
+  if counting then words.(id)
+  else Int64.logand (Int64.shift_right_logical words.(id / 64) (id mod 64)) 1L
+
+let table_counts counting ((len, _) as table) =
+  if counting then table else (len, Array.init len (fun id -> table_hits false table id))
+
+let table_bits counting ((len, _) as table) =
+  if not counting then table
+  else (
+    let words = Array.make ((len + 63) / 64) 0L in
+    for id = 0 to len - 1 do
+      if table_hits true table id <> 0L then
+        words.(id / 64) <- Int64.logor words.(id / 64) (Int64.shift_left 1L (id mod 64))
+    done;
+    (len, words)
+  )
+
+(* A FNV-1a hash of the span tables, computed in the same way as the
+   coverage library so we can check a binary coverage file belongs to
+   the all branches file we are using. *)
+let spans_hash_cache = ref None
+
+let compute_spans_hash () =
+  let hash = ref 0xcbf29ce484222325L in
+  let add_string str =
+    String.iter (fun c -> hash := Int64.mul (Int64.logxor !hash (Int64.of_int (Char.code c))) 0x100000001b3L) str
+  in
+  let add_int64 n =
+    let bytes = Bytes.create 8 in
+    Bytes.set_int64_le bytes 0 n;
+    add_string (Bytes.to_string bytes)
+  in
+  let add_int32 n =
+    let bytes = Bytes.create 4 in
+    Bytes.set_int32_le bytes 0 (Int32.of_int n);
+    add_string (Bytes.to_string bytes)
+  in
+  List.iter
+    (fun kind ->
+      let len = Hashtbl.fold (fun (k, id) _ len -> if k = kind then max len (id + 1) else len) span_ids 0 in
+      add_int64 (Int64.of_int len);
+      for id = 0 to len - 1 do
+        match Hashtbl.find_opt span_ids (kind, id) with
+        | Some (file, span) ->
+            add_string file;
+            add_string "\000";
+            List.iter add_int32 [span.l1; span.c1; span.l2; span.c2]
+        | None -> ()
+      done
+    )
+    binary_kinds;
+  !hash
+
+let spans_hash () =
+  match !spans_hash_cache with
+  | Some hash -> hash
+  | None ->
+      let hash = compute_spans_hash () in
+      spans_hash_cache := Some hash;
+      hash
+
+let read_more_binary_coverage filename spans =
+  let coverage = read_binary_coverage filename in
+  if coverage.table_hash <> spans_hash () then
+    Printf.ksprintf warn "%s was not produced by the model described by %s\n" filename !opt_all;
+  let spans = ref spans in
+  List.iteri
+    (fun i kind ->
+      let ((len, _) as table) = coverage.tables.(i) in
+      for id = 0 to len - 1 do
+        let count = table_hits coverage.counting table id in
+        if count <> 0L then (
+          match Hashtbl.find_opt span_ids (kind, id) with
+          | Some (file, { l1; c1; l2; c2 }) ->
+              add_hits kind file l1 c1 l2 c2 (Int64.to_int count);
+              spans := add_span !spans file l1 c1 l2 c2
+          | None -> Printf.ksprintf warn "%c %d in %s not found in %s\n" kind id filename !opt_all
+        )
+      done
+    )
+    binary_kinds;
+  !spans
+
+let read_more_text_coverage filename spans =
   let spans = ref spans in
   let chan = open_in filename in
   try
@@ -159,15 +313,19 @@ let read_more_coverage filename spans =
           try
             match Scanf.sscanf line "%c" (fun c -> c) with
             | 'T' ->
-                Scanf.sscanf line "%c %d, %d, %S, %d, %d, %d, %d" (fun _type _bid _tid file l1 c1 l2 c2 ->
+                Scanf.sscanf line "%c %d, %d, %S, %d, %d, %d, %d" (fun _type _bid tid file l1 c1 l2 c2 ->
+                    add_span_id 'T' tid file l1 c1 l2 c2;
                     add_span !spans file l1 c1 l2 c2
                 )
             | 'B' ->
-                Scanf.sscanf line "%c %d, %S, %d, %d, %d, %d" (fun _type _bid file l1 c1 l2 c2 ->
+                Scanf.sscanf line "%c %d, %S, %d, %d, %d, %d" (fun _type bid file l1 c1 l2 c2 ->
+                    add_span_id 'B' bid file l1 c1 l2 c2;
                     add_span !spans file l1 c1 l2 c2
                 )
             | 'F' ->
-                Scanf.sscanf line "%c %d, %S, %S, %d, %d, %d, %d" (fun _type _fid _id file l1 c1 l2 c2 ->
+                Scanf.sscanf line "%c %d, %S, %S, %d, %d, %d, %d" (fun _type fid id file l1 c1 l2 c2 ->
+                    add_span_id 'F' fid file l1 c1 l2 c2;
+                    Hashtbl.replace function_names (Filename.basename file, { l1; c1; l2; c2 }) id;
                     add_span !spans file l1 c1 l2 c2
                 )
             | _ ->
@@ -175,7 +333,11 @@ let read_more_coverage filename spans =
                 !spans
             (* The file produced by the executable does not contain the function ids, so we parse it slightly differently *)
           with Scanf.Scan_failure _ ->
-            Scanf.sscanf line "%c %S, %d, %d, %d, %d" (fun _type file l1 c1 l2 c2 -> add_span !spans file l1 c1 l2 c2)
+            (* which may be followed by a hit count *)
+            Scanf.sscanf line "%c %S, %d, %d, %d, %d%[^\n]" (fun kind file l1 c1 l2 c2 rest ->
+                add_hits kind file l1 c1 l2 c2 (parse_hits rest);
+                add_span !spans file l1 c1 l2 c2
+            )
         end;
       loop ()
     in
@@ -184,8 +346,124 @@ let read_more_coverage filename spans =
     close_in chan;
     !spans
 
+let read_more_coverage filename spans =
+  if is_binary_coverage filename then read_more_binary_coverage filename spans
+  else read_more_text_coverage filename spans
+
 let read_coverage filename = read_more_coverage filename StringMap.empty
 
+let write_binary_coverage filename coverage =
+  let buf = Buffer.create 4096 in
+  Buffer.add_string buf binary_magic;
+  Buffer.add_int32_le buf (if coverage.counting then 1l else 0l);
+  Buffer.add_int32_le buf 0l;
+  Buffer.add_int64_le buf coverage.table_hash;
+  Array.iter
+    (fun (len, words) ->
+      Buffer.add_int64_le buf (Int64.of_int len);
+      Array.iter (Buffer.add_int64_le buf) words
+    )
+    coverage.tables;
+  (* Like the coverage library, write to a temporary file and rename it so the output appears atomically *)
+  let tmp = Printf.sprintf "%s.tmp.%d" filename (Unix.getpid ()) in
+  let chan = open_out_bin tmp in
+  Buffer.output_buffer chan buf;
+  close_out chan;
+  Sys.rename tmp filename
+
+(* Either OR together the bitmaps of two coverage files, or sum their hit counts. *)
+let merge_binary_coverage sum c1 c2 =
+  if c1.table_hash <> c2.table_hash then (
+    prerr_endline "Error: cannot merge coverage files produced by different models";
+    exit 1
+  );
+  let merge_tables convert combine =
+    Array.map2
+      (fun t1 t2 ->
+        let len, w1 = convert c1.counting t1 in
+        let _, w2 = convert c2.counting t2 in
+        (len, Array.map2 combine w1 w2)
+      )
+      c1.tables c2.tables
+  in
+  if sum then { c1 with counting = true; tables = merge_tables table_counts Int64.add }
+  else { c1 with counting = false; tables = merge_tables table_bits Int64.logor }
+
+let opt_merge_output = ref None
+let opt_merge_sum = ref false
+let opt_merge_jobs = ref 1
+let opt_merge_files = ref ([] : string list)
+
+let merge_options =
+  Arg.align
+    [
+      ("-o", Arg.String (fun str -> opt_merge_output := Some str), "<file> write the merged coverage to file");
+      ("--sum", Arg.Set opt_merge_sum, " sum hit counts rather than combining which locations were reached");
+      ("-j", Arg.Int (fun n -> opt_merge_jobs := max 1 n), "<int> number of processes to merge with (default: 1)");
+    ]
+
+let merge_files sum = function
+  | [] -> None
+  | file :: files ->
+      let merge acc file = merge_binary_coverage sum acc (read_binary_coverage file) in
+      Some (List.fold_left merge (read_binary_coverage file) files)
+
+(* Split the files between jobs child processes, each of which writes
+   a partial result that we then merge. *)
+let parallel_merge_files output sum jobs files =
+  let chunks = Array.make jobs [] in
+  List.iteri (fun i file -> chunks.(i mod jobs) <- file :: chunks.(i mod jobs)) files;
+  let parts =
+    Array.to_list chunks
+    |> List.filter (fun chunk -> chunk <> [])
+    |> List.mapi (fun i chunk ->
+           let part = Printf.sprintf "%s.part%d.%d" output i (Unix.getpid ()) in
+           match Unix.fork () with
+           | 0 ->
+               Option.iter (write_binary_coverage part) (merge_files sum chunk);
+               exit 0
+           | pid -> (pid, part)
+       )
+  in
+  List.iter
+    (fun (pid, _) ->
+      match Unix.waitpid [] pid with
+      | _, Unix.WEXITED 0 -> ()
+      | _ ->
+          prerr_endline "Error: failed to merge coverage files";
+          exit 1
+    )
+    parts;
+  let merged = merge_files sum (List.map snd parts) in
+  List.iter (fun (_, part) -> Sys.remove part) parts;
+  merged
+
+let merge_main () =
+  let usage_msg = "usage: sailcov merge [--sum] [-j <n>] -o <file> <binary coverage files>\n" in
+  begin
+    let anon_fun s = opt_merge_files := s :: !opt_merge_files in
+    try Arg.parse_argv ~current:(ref 1) Sys.argv merge_options anon_fun usage_msg with
+    | Arg.Bad msg ->
+        prerr_string msg;
+        exit 2
+    | Arg.Help msg ->
+        print_string msg;
+        exit 0
+  end;
+  let files = List.rev !opt_merge_files in
+  match !opt_merge_output with
+  | None ->
+      prerr_string (Arg.usage_string merge_options usage_msg);
+      exit 2
+  | Some output -> (
+      let merged =
+        if !opt_merge_jobs > 1 && List.length files > !opt_merge_jobs then
+          parallel_merge_files output !opt_merge_sum !opt_merge_jobs files
+        else merge_files !opt_merge_sum files
+      in
+      match merged with Some coverage -> write_binary_coverage output coverage | None -> ()
+    )
+
 (** We color the source either red (bad) or green (good) if it's
    covered vs uncovered. If we have nested uncovered branches, they
    will be increasingly bad, whereas nested covered branches will be
@@ -397,9 +675,47 @@ let get_file_spans filename all taken =
   let taken = Option.value ~default:SpanMap.empty (StringMap.find_opt file taken) in
   (all, taken)
 
+(* The hit count for each span in a file. A span can be both a branch
+   and a branch target, so we take the largest count of any kind. *)
+let file_hits file =
+  let file = Filename.basename file in
+  Hashtbl.fold
+    (fun (_, hit_file, span) count m ->
+      if hit_file = file then SpanMap.update span (function None -> Some count | Some n -> Some (max n count)) m
+      else m
+    )
+    hits SpanMap.empty
+
+(* Colour hot code red and rarely reached code blue, on a log scale *)
+let heat_color count max_count =
+  let ratio =
+    if max_count <= 1 then 1.0 else Float.log (1.0 +. Float.of_int count) /. Float.log (1.0 +. Float.of_int max_count)
+  in
+  Printf.sprintf "hsl(%d, %d%%, 70%%)" (240 - Float.to_int (240.0 *. ratio)) (!opt_good_color).saturation
+
+let print_hottest n =
+  let kind_name = function 'F' -> "function" | 'B' -> "branch" | 'T' -> "target" | _ -> "unknown" in
+  let sorted = Hashtbl.fold (fun key count acc -> (count, key) :: acc) hits [] in
+  let sorted = List.stable_sort (fun (c1, _) (c2, _) -> compare c2 c1) (List.sort compare sorted) in
+  Printf.printf "%20s | %-8s | %s\n" "Hits" "Kind" "Location";
+  List.iteri
+    (fun i (count, (kind, file, span)) ->
+      if i < n then (
+        let name =
+          match (kind, Hashtbl.find_opt function_names (file, span)) with
+          | 'F', Some name -> " " ^ name
+          | _ -> ""
+        in
+        Printf.printf "%20d | %-8s | %s%s\n" count (kind_name kind) (string_of_span file span) name
+      )
+    )
+    sorted
+
 let main () =
   let all = read_coverage !opt_all in
   let taken = read_taken_files all in
+  let max_hits = Hashtbl.fold (fun _ count m -> max m count) hits 0 in
+  Option.iter print_hottest !opt_hottest;
   List.iter
     (fun file ->
       let all, taken = get_file_spans file all taken in
@@ -443,7 +759,8 @@ let main () =
       output_string chan (Printf.sprintf "<h1>%s</h1>\n" desc);
       output_string chan "<code style=\"display: block\">\n";
 
-      if !opt_colour_count then (
+      if !opt_colour_count || !opt_heat then (
+        let taken = if !opt_heat then file_hits file else taken in
         let combined =
           SpanMap.merge
             (fun span present count ->
@@ -501,8 +818,13 @@ let main () =
               (stack, line, char)
             end
             else begin
-              let colour = if count = 0 then html_color !opt_bad_color 0 else html_color !opt_good_color count in
-              output_string chan (Printf.sprintf "<span title=\"%d\" style=\"background-color: %s\">" count colour);
+              let colour =
+                if count = 0 then html_color !opt_bad_color 0
+                else if !opt_heat then heat_color count max_hits
+                else html_color !opt_good_color count
+              in
+              let title = if !opt_heat then Printf.sprintf "%d hits" count else string_of_int count in
+              output_string chan (Printf.sprintf "<span title=\"%s\" style=\"background-color: %s\">" title colour);
               (span :: stack, line, char)
             end
           )
@@ -651,6 +973,14 @@ let read_taken_lists () =
     !opt_taken_list
 
 let _ =
+  if Array.length Sys.argv > 1 && Sys.argv.(1) = "merge" then (
+    try
+      merge_main ();
+      exit 0
+    with Sys_error msg ->
+      prerr_endline msg;
+      exit 1
+  );
   Arg.parse options (fun s -> opt_files := !opt_files @ [s]) usage_msg;
   read_taken_lists ();
   begin
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""Convert `perf script` output for a Sail generated C emulator into
+folded stacks of Sail functions, suitable for flamegraph.pl or
+speedscope.
+
+Each generated C function is looked up in the table written by
+`sail -c -c_symbol_map <file>`. Frames that are not generated Sail
+functions, such as the C runtime library, are attributed to the
+nearest Sail function that called them unless --keep-runtime is
+given.
+"""
+
+import argparse
+import collections
+import re
+import sys
+
+def read_symbol_map(filename):
+    symbols = {}
+    with open(filename) as f:
+        for line in f:
+            fields = line.rstrip('\n').split('\t')
+            if len(fields) != 5:
+                continue
+            c_name, sail_name, sail_file, l1, l2 = fields
+            symbols[c_name] = (sail_name, sail_file, int(l1), int(l2))
+    return symbols
+
+# A stack frame line in perf script output, e.g.
+#     55d0c2e1a2b4 zexecute+0x34 (/path/to/emulator)
+frame_re = re.compile(r'^\s+[0-9a-f]+\s+(.*?)(\+0x[0-9a-f]+)?\s+\((.*)\)$')
+
+def strip_suffix(symbol):
+    # Remove compiler generated suffixes such as .isra.0 or .constprop.1
+    return symbol.split('.')[0]
+
+def read_stacks(chan):
+    stack = []
+    for line in chan:
+        if line.strip() == '':
+            if stack:
+                yield stack
+            stack = []
+            continue
+        m = frame_re.match(line)
+        if m:
+            stack.append(m.group(1))
+    if stack:
+        yield stack
+
+def fold(stack, symbols, keep_runtime, with_locations):
+    # perf prints the innermost frame first
+    folded = []
+    for symbol in reversed(stack):
+        entry = symbols.get(strip_suffix(symbol))
+        if entry is not None:
+            sail_name, sail_file, l1, l2 = entry
+            if with_locations and sail_file != '':
+                folded.append('{} ({}:{}-{})'.format(sail_name, sail_file, l1, l2))
+            else:
+                folded.append(sail_name)
+        elif keep_runtime:
+            folded.append('[c] ' + symbol)
+    return ';'.join(folded)
+
+def main():
+    parser = argparse.ArgumentParser(description='Fold perf script output into Sail level stacks')
+    parser.add_argument('symbol_map', help='symbol map written by sail -c_symbol_map')
+    parser.add_argument('perf_script', nargs='?', help='output of perf script (default: stdin)')
+    parser.add_argument('--keep-runtime', action='store_true', help='keep frames for non-Sail C functions')
+    parser.add_argument('--locations', action='store_true', help='include Sail source locations in frame names')
+    args = parser.parse_args()
+
+    symbols = read_symbol_map(args.symbol_map)
+    chan = open(args.perf_script) if args.perf_script else sys.stdin
+
+    counts = collections.Counter()
+    for stack in read_stacks(chan):
+        folded = fold(stack, symbols, args.keep_runtime, args.locations)
+        counts[folded if folded != '' else '[unknown]'] += 1
+
+    for stack, count in sorted(counts.items()):
+        print('{} {}'.format(stack, count))
+
+if __name__ == '__main__':
+    main()
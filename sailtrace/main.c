@@ -0,0 +1,290 @@
+/****************************************************************************/
+/*     Sail                                                                 */
+/*                                                                          */
+/*  Sail and the Sail architecture models here, comprising all files and    */
+/*  directories except the ASL-derived Sail code in the aarch64 directory,  */
+/*  are subject to the BSD two-clause licence below.                        */
+/*                                                                          */
+/*  The ASL derived parts of the ARMv8.3 specification in                   */
+/*  aarch64/no_vector and aarch64/full are copyright ARM Ltd.               */
+/*                                                                          */
+/*  Copyright (c) 2013-2021                                                 */
+/*    Kathyrn Gray                                                          */
+/*    Shaked Flur                                                           */
+/*    Stephen Kell                                                          */
+/*    Gabriel Kerneis                                                       */
+/*    Robert Norton-Wright                                                  */
+/*    Christopher Pulte                                                     */
+/*    Peter Sewell                                                          */
+/*    Alasdair Armstrong                                                    */
+/*    Brian Campbell                                                        */
+/*    Thomas Bauereiss                                                      */
+/*    Anthony Fox                                                           */
+/*    Jon French                                                            */
+/*    Dominic Mulligan                                                      */
+/*    Stephen Kell                                                          */
+/*    Mark Wassell                                                          */
+/*    Alastair Reid (Arm Ltd)                                               */
+/*                                                                          */
+/*  All rights reserved.                                                    */
+/*                                                                          */
+/*  This work was partially supported by EPSRC grant EP/K008528/1 <a        */
+/*  href="http://www.cl.cam.ac.uk/users/pes20/rems">REMS: Rigorous          */
+/*  Engineering for Mainstream Systems</a>, an ARM iCASE award, EPSRC IAA   */
+/*  KTF funding, and donations from Arm.  This project has received         */
+/*  funding from the European Research Council (ERC) under the European     */
+/*  Union’s Horizon 2020 research and innovation programme (grant           */
+/*  agreement No 789108, ELVER).                                            */
+/*                                                                          */
+/*  This software was developed by SRI International and the University of  */
+/*  Cambridge Computer Laboratory (Department of Computer Science and       */
+/*  Technology) under DARPA/AFRL contracts FA8650-18-C-7809 ("CIFV")        */
+/*  and FA8750-10-C-0237 ("CTSRD").                                         */
+/*                                                                          */
+/*  Redistribution and use in source and binary forms, with or without      */
+/*  modification, are permitted provided that the following conditions      */
+/*  are met:                                                                */
+/*  1. Redistributions of source code must retain the above copyright       */
+/*     notice, this list of conditions and the following disclaimer.        */
+/*  2. Redistributions in binary form must reproduce the above copyright    */
+/*     notice, this list of conditions and the following disclaimer in      */
+/*     the documentation and/or other materials provided with the           */
+/*     distribution.                                                        */
+/*                                                                          */
+/*  THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''      */
+/*  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED       */
+/*  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A         */
+/*  PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR     */
+/*  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,            */
+/*  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT        */
+/*  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF        */
+/*  USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND     */
+/*  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,      */
+/*  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT      */
+/*  OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF      */
+/*  SUCH DAMAGE.                                                            */
+/****************************************************************************/
+
+/*
+ * Decode a binary trace written by a Sail model run with
+ * --trace-file, printing the same text the model would have printed
+ * to stderr without it, or an instruction retire trace written with
+ * --retire-trace. Compressed traces are decompressed as they are
+ * read.
+ */
+
+#include<inttypes.h>
+#include<stdbool.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<zlib.h>
+
+#include "sail_trace.h"
+
+static char **names = NULL;
+static uint32_t names_size = 0;
+
+static bool read_varint(gzFile in, uint64_t *value)
+{
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = gzgetc(in);
+    if (c == -1) return false;
+    *value |= (uint64_t)(c & 0x7F) << shift;
+    if (!(c & 0x80)) return true;
+  }
+  return false;
+}
+
+static char *read_string(gzFile in)
+{
+  uint64_t len;
+  char *str = NULL;
+  if (!read_varint(in, &len) || (str = (char *)malloc(len + 1)) == NULL
+      || (len > 0 && gzread(in, str, len) != (int)len)) {
+    free(str);
+    return NULL;
+  }
+  str[len] = '\0';
+  return str;
+}
+
+static void print_indent(FILE *out, uint64_t depth)
+{
+  fputs("[TRACE] ", out);
+  for (uint64_t i = 0; i < depth; ++i) {
+    fputs("|   ", out);
+  }
+}
+
+static void print_bits(FILE *out, uint64_t len, uint64_t bits)
+{
+  if (len % 4 == 0) {
+    fputs("0x", out);
+    for (uint64_t i = len / 4; i > 0; --i) {
+      fputc("0123456789ABCDEF"[(bits >> (4 * (i - 1))) & 0xF], out);
+    }
+  } else {
+    fputs("0b", out);
+    for (uint64_t i = len; i > 0; --i) {
+      fputc('0' + ((bits >> (i - 1)) & 1), out);
+    }
+  }
+}
+
+/*
+ * Print count values separated by commas, returning false if the
+ * trace ends early or contains something other than a value.
+ */
+static bool decode_values(gzFile in, FILE *out, int count)
+{
+  uint64_t a, b;
+  char *str;
+
+  for (int i = 0; i < count; ++i) {
+    if (i > 0) fputs(", ", out);
+    int tag = gzgetc(in);
+    switch (tag) {
+    case SAIL_TRACE_UNIT:
+      fputs("()", out);
+      break;
+    case SAIL_TRACE_UNKNOWN:
+      fputs("?", out);
+      break;
+    case SAIL_TRACE_FALSE:
+      fputs("false", out);
+      break;
+    case SAIL_TRACE_TRUE:
+      fputs("true", out);
+      break;
+    case SAIL_TRACE_FBITS:
+      if (!read_varint(in, &a)) return false;
+      fprintf(out, "0x%" PRIx64, a);
+      break;
+    case SAIL_TRACE_BITS:
+      if (!read_varint(in, &a) || !read_varint(in, &b)) return false;
+      print_bits(out, a, b);
+      break;
+    case SAIL_TRACE_INT:
+      if (!read_varint(in, &a)) return false;
+      fprintf(out, "%" PRId64, (int64_t)(a >> 1) ^ -(int64_t)(a & 1));
+      break;
+    case SAIL_TRACE_STRING:
+      if ((str = read_string(in)) == NULL) return false;
+      fputs(str, out);
+      free(str);
+      break;
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+static int decode_calls(gzFile in, FILE *out)
+{
+  int tag, count;
+  uint64_t id, depth;
+
+  while ((tag = gzgetc(in)) != -1) {
+    switch (tag) {
+    case SAIL_TRACE_NAME:
+      if (!read_varint(in, &id) || id > UINT32_MAX) goto invalid;
+      if (id >= names_size) {
+        uint32_t old_size = names_size;
+        names_size = id < 2 * (uint64_t)names_size ? 2 * names_size : (uint32_t)id + 256;
+        names = (char **)realloc(names, names_size * sizeof(char *));
+        memset(names + old_size, 0, (names_size - old_size) * sizeof(char *));
+      }
+      free(names[id]);
+      if ((names[id] = read_string(in)) == NULL) goto invalid;
+      break;
+    case SAIL_TRACE_START:
+      if (!read_varint(in, &id) || !read_varint(in, &depth) || (count = gzgetc(in)) == -1) goto invalid;
+      print_indent(out, depth);
+      fprintf(out, "%s(", id < names_size && names[id] ? names[id] : "?");
+      if (!decode_values(in, out, count)) goto invalid;
+      fputs(")\n", out);
+      break;
+    case SAIL_TRACE_END:
+      if (!read_varint(in, &depth) || (count = gzgetc(in)) == -1) goto invalid;
+      print_indent(out, depth);
+      if (!decode_values(in, out, count)) goto invalid;
+      fputs("\n", out);
+      break;
+    default:
+      goto invalid;
+    }
+  }
+  return 0;
+
+invalid:
+  fprintf(stderr, "Truncated or invalid trace file\n");
+  return 1;
+}
+
+static int decode_retire(gzFile in, FILE *out)
+{
+  int tag;
+  uint64_t a, b, c;
+
+  while ((tag = gzgetc(in)) != -1) {
+    switch (tag) {
+    case SAIL_RETIRE_INSTR:
+      if (!read_varint(in, &a) || !read_varint(in, &b)) goto truncated;
+      fprintf(out, "0x%016" PRIx64 " (0x%08" PRIx64 ")\n", a, b);
+      break;
+    case SAIL_RETIRE_REG_WRITE:
+      if (!read_varint(in, &a) || !read_varint(in, &b)) goto truncated;
+      fprintf(out, "  r%" PRIu64 " <- 0x%016" PRIx64 "\n", a, b);
+      break;
+    case SAIL_RETIRE_MEM_READ:
+    case SAIL_RETIRE_MEM_WRITE:
+      if (!read_varint(in, &a) || !read_varint(in, &b) || !read_varint(in, &c)) goto truncated;
+      fprintf(out, "  mem[0x%016" PRIx64 "] %s 0x%0*" PRIx64 "\n", a, tag == SAIL_RETIRE_MEM_READ ? "->" : "<-",
+              (int)(2 * b), c);
+      break;
+    default:
+      fprintf(stderr, "Unknown retire trace record %d\n", tag);
+      return 1;
+    }
+  }
+  return 0;
+
+truncated:
+  fprintf(stderr, "Truncated trace file\n");
+  return 1;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc != 2) {
+    fprintf(stderr, "usage: sailtrace <trace file>\n");
+    return 1;
+  }
+
+  gzFile in = gzopen(argv[1], "rb");
+  if (in == NULL) {
+    fprintf(stderr, "Could not open %s\n", argv[1]);
+    return 1;
+  }
+
+  static char out_buffer[1 << 20];
+  setvbuf(stdout, out_buffer, _IOFBF, sizeof(out_buffer));
+
+  char magic[8];
+  int result;
+  if (gzread(in, magic, 8) != 8) {
+    result = 1;
+  } else if (memcmp(magic, SAIL_TRACE_MAGIC, 8) == 0) {
+    result = decode_calls(in, stdout);
+  } else if (memcmp(magic, SAIL_RETIRE_MAGIC, 8) == 0) {
+    result = decode_retire(in, stdout);
+  } else {
+    fprintf(stderr, "Not a Sail trace file\n");
+    result = 1;
+  }
+  gzclose(in);
+  return result;
+}
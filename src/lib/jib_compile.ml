@@ -194,6 +194,103 @@ let rec is_pure_aexp ctx (AE_aux (aexp, { uannot; _ })) =
 
 let is_pure_case ctx (_, guard, body) = is_pure_aexp ctx guard && is_pure_aexp ctx body
 
+let min_decision_tree_cases = 4
+
+(** A decode function will typically match a fixed-width bitvector
+   against hundreds of cases, each of which fixes some of its bits,
+   e.g. the opcode field of an instruction. After the literal and
+   bitvector pattern rewrites (and primop optimization in the C
+   backend), such a case has a variable pattern and a guard that
+   compares slices of that variable against bitvector literals.
+
+   For each case we find the bits of the scrutinee that must have a
+   fixed value for the case to match, as an array with the most
+   significant bit first and BU for unconstrained bits. We only look
+   at the prefix of the guard that is evaluated before anything we
+   don't understand, so a case that fails these constraints would
+   have failed its guard without evaluating anything with a
+   side-effect, and can therefore be skipped entirely. **)
+let case_fixed_bits n (AP_aux (apat, _, _), guard, _) =
+  let fixed = Array.make n Sail2_values.BU in
+  let fix_bits lo bits =
+    let len = List.length bits in
+    if lo >= 0 && lo + len <= n then
+      List.iteri (fun i bit -> if bit <> Sail2_values.BU then fixed.(n - lo - len + i) <- bit) bits
+  in
+  let rec resolve subst = function
+    | V_id (id, _) as v -> ( match NameMap.find_opt id subst with Some v' -> resolve subst v' | None -> v)
+    | v -> v
+  in
+  let slice_lo x subst v =
+    match resolve subst v with
+    | V_id (id, CT_fbits m) when Name.compare id x = 0 && m = n -> Some 0
+    | V_call (Slice _, [vec; V_lit (VL_int lo, _)]) -> begin
+        match resolve subst vec with
+        | V_id (id, CT_fbits m) when Name.compare id x = 0 && m = n -> Some (Big_int.to_int lo)
+        | _ -> None
+      end
+    | _ -> None
+  in
+  let rec conjunct x subst v =
+    match resolve subst v with
+    | V_call (Band, vs) -> List.iter (conjunct x subst) vs
+    | V_call (Eq, [v1; v2]) -> begin
+        match (slice_lo x subst v1, resolve subst v2, resolve subst v1, slice_lo x subst v2) with
+        | Some lo, V_lit (VL_bits bits, _), _, _ | _, _, V_lit (VL_bits bits, _), Some lo -> fix_bits lo bits
+        | _ -> ()
+      end
+    | _ -> ()
+  in
+  let aval_cval = function AV_cval (v, _) -> Some v | AV_id (id, _) -> Some (V_id (name id, CT_bool)) | _ -> None in
+  let rec guard_prefix x subst (AE_aux (aexp, _)) =
+    match aexp with
+    | AE_val aval -> Option.iter (conjunct x subst) (aval_cval aval)
+    | AE_typ (aexp, _) -> guard_prefix x subst aexp
+    | AE_let (Immutable, id, _, AE_aux (AE_val (AV_cval (v, _)), _), body, _) when Name.compare (name id) x <> 0 ->
+        guard_prefix x (NameMap.add (name id) v subst) body
+    | AE_short_circuit (SC_and, aval, rest) ->
+        Option.iter (conjunct x subst) (aval_cval aval);
+        guard_prefix x subst rest
+    | _ -> ()
+  in
+  begin
+    match apat with AP_id (x, _) -> guard_prefix (name x) NameMap.empty guard | _ -> ()
+  end;
+  fixed
+
+(** No value can match both patterns, because they contain different
+   constructors or enumeration members in the same position. **)
+let rec apats_disjoint (AP_aux (aux1, env1, _) as apat1) (AP_aux (aux2, env2, _) as apat2) =
+  let is_enum_member env id = match Env.lookup_id id env with Enum _ -> true | _ -> false in
+  match (aux1, aux2) with
+  | AP_as (apat1, _, _), _ -> apats_disjoint apat1 apat2
+  | _, AP_as (apat2, _, _) -> apats_disjoint apat1 apat2
+  | AP_app (ctor1, apat1, _), AP_app (ctor2, apat2, _) -> Id.compare ctor1 ctor2 <> 0 || apats_disjoint apat1 apat2
+  | AP_tuple apats1, AP_tuple apats2 when List.length apats1 = List.length apats2 ->
+      List.exists2 apats_disjoint apats1 apats2
+  | AP_cons _, AP_nil _ | AP_nil _, AP_cons _ -> true
+  | AP_cons (hd1, tl1), AP_cons (hd2, tl2) -> apats_disjoint hd1 hd2 || apats_disjoint tl1 tl2
+  | AP_id (id1, _), AP_id (id2, _) -> is_enum_member env1 id1 && is_enum_member env2 id2 && Id.compare id1 id2 <> 0
+  | _ -> false
+
+(** Two match cases are disjoint if their patterns are, or if they
+   fix some bit of the scrutinee to different values (see
+   [case_fixed_bits]). Either way, whichever case is tested first
+   fails before evaluating anything with a side-effect whenever the
+   other would match, so disjoint cases can be tested in any
+   order. **)
+let cases_disjoint (fixed1, (apat1, _, _)) (fixed2, (apat2, _, _)) =
+  apats_disjoint apat1 apat2
+  ||
+  match (fixed1, fixed2) with
+  | Some fixed1, Some fixed2 ->
+      let conflict = ref false in
+      Array.iteri
+        (fun i b -> if b <> Sail2_values.BU && fixed2.(i) <> Sail2_values.BU && b <> fixed2.(i) then conflict := true)
+        fixed1;
+      !conflict
+  | _ -> false
+
 let initial_ctx ?for_target env effect_info =
   let initial_valspecs =
     [
@@ -291,6 +388,10 @@ module type CONFIG = sig
   val track_throw : bool
   val use_void : bool
   val eager_control_flow : bool
+  val match_decision_trees : bool
+  val setjmp_exceptions : bool
+  val branch_hints : bool
+  val profile_count : char -> l -> int option
 end
 
 module IdGraph = Graph.Make (Id)
@@ -324,6 +425,15 @@ module Make (C : CONFIG) = struct
   let coverage_branch_target_count = ref 0
   let coverage_function_count = ref 0
 
+  (* The location of each ID, most recent first, so the C backend can
+     generate static tables indexed by ID. *)
+  let coverage_branch_spans = ref []
+  let coverage_branch_target_spans = ref []
+  let coverage_function_spans = ref []
+
+  let coverage_spans () =
+    (List.rev !coverage_function_spans, List.rev !coverage_branch_spans, List.rev !coverage_branch_target_spans)
+
   let coverage_loc_args l =
     match Reporting.simp_loc l with
     (* Scattered definitions may not have a known location but we still want
@@ -343,7 +453,8 @@ module Make (C : CONFIG) = struct
         incr coverage_branch_count;
         let args = coverage_loc_args l in
         Printf.fprintf out "%s\n" ("B " ^ string_of_int branch_id ^ ", " ^ args);
-        (branch_id, [iraw (Printf.sprintf "sail_branch_reached(%d, %s);" branch_id args)])
+        coverage_branch_spans := args :: !coverage_branch_spans;
+        (branch_id, [iraw (Printf.sprintf "sail_branch_reached_id(%d);" branch_id)])
       end
     | _ -> (0, [])
 
@@ -368,7 +479,8 @@ module Make (C : CONFIG) = struct
         incr coverage_branch_target_count;
         let args = coverage_loc_args (find_aexp_loc aexp) in
         Printf.fprintf out "%s\n" ("T " ^ string_of_int branch_id ^ ", " ^ string_of_int branch_target_id ^ ", " ^ args);
-        [iraw (Printf.sprintf "sail_branch_target_taken(%d, %d, %s);" branch_id branch_target_id args)]
+        coverage_branch_target_spans := args :: !coverage_branch_target_spans;
+        [iraw (Printf.sprintf "sail_branch_target_taken_id(%d, %d);" branch_id branch_target_id)]
       end
     | _ -> []
 
@@ -381,10 +493,32 @@ module Make (C : CONFIG) = struct
         incr coverage_function_count;
         let args = coverage_loc_args l in
         Printf.fprintf out "%s\n" ("F " ^ string_of_int function_id ^ ", \"" ^ string_of_id id ^ "\", " ^ args);
-        [iraw (Printf.sprintf "sail_function_entry(%d, \"%s\", %s);" function_id (string_of_id id) args)]
+        coverage_function_spans := args :: !coverage_function_spans;
+        [iraw (Printf.sprintf "sail_function_entry_id(%d);" function_id)]
       end
     | _ -> []
 
+  (* With a profile, move each match case ahead of the cases before it
+     that were taken less often, stopping at the first case it is not
+     disjoint from so the first-match semantics are preserved. We
+     only have counts for matches that were measured for coverage. *)
+  let profile_order_cases ctx ctyp cases =
+    let case_count (_, _, body) = if ctx.coverage_override then C.profile_count 'T' (find_aexp_loc body) else None in
+    let counts = List.map case_count cases in
+    if List.exists Option.is_none counts then cases
+    else (
+      let fixed case = match ctyp with CT_fbits n -> Some (case_fixed_bits n case) | _ -> None in
+      let rec insert (count, case) = function
+        | (count', case') :: rest when count' < count && cases_disjoint case case' ->
+            (count', case') :: insert (count, case) rest
+        | rest -> (count, case) :: rest
+      in
+      List.map2 (fun count case -> (Option.get count, (fixed case, case))) counts cases
+      |> List.fold_left (fun acc case -> insert case acc) []
+      |> List.rev
+      |> List.map (fun (_, (_, case)) -> case)
+    )
+
   let rec compile_aval l ctx = function
     | AV_cval (cval, typ) ->
         let ctyp = cval_ctyp cval in
@@ -776,6 +910,10 @@ module Make (C : CONFIG) = struct
   let rec compile_aexp ctx (AE_aux (aexp_aux, { env; loc = l; uannot })) =
     let ctx = { ctx with local_env = env } in
     match aexp_aux with
+    | _ when C.branch_hints && Option.is_some (get_attribute "cold" uannot) ->
+        let uannot = remove_attribute "cold" uannot in
+        let setup, call, cleanup = compile_aexp ctx (AE_aux (aexp_aux, { env; loc = l; uannot })) in
+        (iraw "sail_cold_path();" :: setup, call, cleanup)
     | AE_let (mut, id, binding_typ, binding, (AE_aux (_, { env = body_env; _ }) as body), body_typ) ->
         let binding_ctyp = ctyp_of_typ { ctx with local_env = body_env } binding_typ in
         let setup, call, cleanup = compile_aexp ctx binding in
@@ -853,6 +991,7 @@ module Make (C : CONFIG) = struct
         let ctx = update_coverage_override uannot ctx in
         let ctyp = ctyp_of_typ ctx typ in
         let aval_setup, cval, aval_cleanup = compile_aval l ctx aval in
+        let cases = profile_order_cases ctx (cval_ctyp cval) cases in
         (* Get the number of cases, because we don't want to check branch
            coverage for matches with only a single case. *)
         let num_cases = List.length cases in
@@ -896,9 +1035,77 @@ module Make (C : CONFIG) = struct
             [iblock case_instrs; ilabel case_label]
           )
         in
+        (* Each compiled case jumps to finish_match_label if it
+           matches, and otherwise falls through. For a run of cases
+           that all fix some bits of the scrutinee which haven't
+           already been decided, we dispatch on those bits to a
+           bucket containing just the cases that could match, in
+           their original order. Cases in different buckets are
+           mutually exclusive, so this preserves the first-match
+           semantics. Buckets are themselves split in the same way
+           using the remaining bits. *)
+        let rec compile_cases n decided cases =
+          let common_bits decided fixed = Array.mapi (fun i b -> b <> Sail2_values.BU && not decided.(i)) fixed in
+          let rec take_run mask run = function
+            | (fixed, case) :: rest ->
+                let mask' = Array.map2 ( && ) mask (common_bits decided fixed) in
+                if Array.exists Fun.id mask' then take_run mask' ((fixed, case) :: run) rest
+                else (mask, List.rev run, (fixed, case) :: rest)
+            | [] -> (mask, List.rev run, [])
+          in
+          match cases with
+          | [] -> []
+          | (_, case) :: cases' -> (
+              match take_run (Array.make n true) [] cases with
+              | mask, run, rest when List.length run >= min_decision_tree_cases ->
+                  compile_decision n decided mask run @ compile_cases n decided rest
+              | _ -> compile_case case @ compile_cases n decided cases'
+            )
+        and compile_decision n decided mask run =
+          let key_bits fixed = Array.mapi (fun i b -> if mask.(i) then b else Sail2_values.B0) fixed |> Array.to_list in
+          let buckets =
+            List.sort_uniq compare (List.map (fun (fixed, _) -> key_bits fixed) run)
+            |> List.map (fun key ->
+                   (key, label "decision_", List.filter (fun (fixed, _) -> key_bits fixed = key) run)
+               )
+          in
+          let decided = Array.map2 ( || ) decided mask in
+          let key_id = ngensym () in
+          let key_ctyp = CT_fbits n in
+          let mask_bits = Array.to_list (Array.map (fun m -> if m then Sail2_values.B1 else Sail2_values.B0) mask) in
+          let decision_end_label = label "decision_end_" in
+          [
+            iblock
+              ([
+                 idecl l key_ctyp key_id;
+                 icopy l (CL_id (key_id, key_ctyp)) (V_call (Bvand, [cval; V_lit (VL_bits mask_bits, key_ctyp)]));
+               ]
+              @ List.map
+                  (fun (key, bucket_label, _) ->
+                    ijump l (V_call (Eq, [V_id (key_id, key_ctyp); V_lit (VL_bits key, key_ctyp)])) bucket_label
+                  )
+                  buckets
+              @ [igoto decision_end_label]
+              @ List.concat
+                  (List.map
+                     (fun (_, bucket_label, bucket) ->
+                       [ilabel bucket_label; iblock (compile_cases n decided bucket @ [igoto decision_end_label])]
+                     )
+                     buckets
+                  )
+              );
+            ilabel decision_end_label;
+          ]
+        in
+        let compiled_cases =
+          match cval_ctyp cval with
+          | CT_fbits n when C.match_decision_trees && n <= 64 && num_cases >= min_decision_tree_cases ->
+              compile_cases n (Array.make n false) (List.map (fun case -> (case_fixed_bits n case, case)) cases)
+          | _ -> List.concat (List.map compile_case cases)
+        in
         ( aval_setup @ on_reached
           @ [idecl l ctyp case_return_id]
-          @ List.concat (List.map compile_case cases)
+          @ compiled_cases
           @ (if Option.is_some (get_attribute "complete" uannot) then [] else [imatch_failure l])
           @ [ilabel finish_match_label],
           (fun clexp -> icopy l clexp (V_id (case_return_id, ctyp))),
@@ -952,7 +1159,10 @@ module Make (C : CONFIG) = struct
           @ List.concat (List.map compile_case cases)
           @ [
               (* fallthrough *)
-              icopy l (CL_id (have_exception, CT_bool)) (V_lit (VL_bool true, CT_bool));
+              ( if C.setjmp_exceptions then
+                  ithrow l (V_id (current_exception, ctyp_of_typ ctx (mk_typ (Typ_id (mk_id "exception")))))
+                else icopy l (CL_id (have_exception, CT_bool)) (V_lit (VL_bool true, CT_bool))
+              );
               ilabel post_exception_handlers_label;
             ],
           (fun clexp -> icopy l clexp (V_id (try_return_id, ctyp))),
@@ -1347,7 +1557,7 @@ module Make (C : CONFIG) = struct
     |> List.filter (fun (id, _) -> not (NameSet.mem id cleaned))
     |> List.map snd
 
-  let fix_exception_block ?(return = None) ctx instrs =
+  let fix_exception_block ?(return = None) ?(toplevel = false) ctx instrs =
     let end_block_label = label "end_block_exception_" in
     let is_exception_stop (I_aux (instr, _)) =
       match instr with I_throw _ | I_if _ | I_block _ | I_funcall _ -> true | _ -> false
@@ -1366,13 +1576,17 @@ module Make (C : CONFIG) = struct
           before
           @ [iif l cval (rewrite_exception historic then_instrs) (rewrite_exception historic else_instrs) ctyp]
           @ rewrite_exception historic after
+      | before, (I_aux (I_throw _, _) as throw) :: after when toplevel && C.setjmp_exceptions ->
+          (* The backend unwinds to the nearest enclosing try block in
+             some caller, cleaning up heap-allocated locals as it goes *)
+          before @ (throw :: rewrite_exception (historic @ before) after)
       | before, I_aux (I_throw cval, (_, l)) :: after ->
+          (* A try block rethrows the current exception if no case matches *)
+          let rethrow = match cval with V_id (Current_exception _, _) -> true | _ -> false in
           before
-          @ [
-              icopy l (CL_id (current_exception, cval_ctyp cval)) cval;
-              icopy l (CL_id (have_exception, CT_bool)) (V_lit (VL_bool true, CT_bool));
-            ]
-          @ ( if C.track_throw then (
+          @ (if rethrow then [] else [icopy l (CL_id (current_exception, cval_ctyp cval)) cval])
+          @ [icopy l (CL_id (have_exception, CT_bool)) (V_lit (VL_bool true, CT_bool))]
+          @ ( if C.track_throw && not rethrow then (
                 let loc_string = Reporting.short_loc_to_string l in
                 [icopy l (CL_id (throw_location, CT_string)) (V_lit (VL_string loc_string, CT_string))]
               )
@@ -1388,7 +1602,7 @@ module Make (C : CONFIG) = struct
             (* Constructors and back-end built-in value operations might not be present *)
             | None -> Effects.EffectSet.empty
           in
-          if Effects.throws effects then
+          if Effects.throws effects && not C.setjmp_exceptions then
             before
             @ [
                 funcall;
@@ -1420,7 +1634,7 @@ module Make (C : CONFIG) = struct
 
   let fix_exception ?(return = None) ctx instrs =
     let instrs = List.map (map_try_block (fix_exception_block ctx)) instrs in
-    fix_exception_block ~return ctx instrs
+    fix_exception_block ~return ~toplevel:true ctx instrs
 
   let rec compile_arg_pat ctx label (P_aux (p_aux, (l, _)) as pat) ctyp =
     match p_aux with
@@ -1633,6 +1847,13 @@ module Make (C : CONFIG) = struct
     let instrs = unique_names instrs in
     let instrs = fix_exception ~return:(Some ret_ctyp) ctx instrs in
     let instrs = coverage_function_entry ctx id (exp_loc exp) @ instrs in
+    let def_annot =
+      match C.profile_count 'F' (exp_loc exp) with
+      | Some count when ctx.coverage_override ->
+          let l = gen_loc (exp_loc exp) in
+          add_def_attribute l "profile_count" (Some (AD_aux (AD_num (Big_int.of_int count), l))) def_annot
+      | _ -> def_annot
+    in
 
     if Option.is_some debug_attr then (
       prerr_endline Util.("IR for " ^ string_of_id id ^ ":" |> yellow |> bold |> clear);
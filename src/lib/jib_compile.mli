@@ -186,6 +186,31 @@ module type CONFIG = sig
       control-flow like this is useful for the Sail->SV and Sail->SMT
       backends. *)
   val eager_control_flow : bool
+
+  (** Compile runs of match cases that fix some common bits of a
+      fixed-width bitvector into a decision tree that dispatches on
+      those bits, rather than testing each case in turn. *)
+  val match_decision_trees : bool
+
+  (** Exceptions propagate out of functions non-locally (as the C
+      backend does with setjmp and longjmp), so don't check
+      have_exception after each call that can throw, and leave
+      throws outside of any try block in the function as I_throw for
+      the backend to implement. *)
+  val setjmp_exceptions : bool
+
+  (** Start expressions with the [cold] attribute with a call to
+      sail_cold_path, which tells the C compiler that they are
+      unlikely to be executed. *)
+  val branch_hints : bool
+
+  (** The number of times the function entry (['F']) or branch
+      target (['T']) at a location was reached in a profiling run, if
+      we have a profile covering that location. Match cases are
+      reordered by these counts where that can't change which case
+      matches, and function definitions are given a [profile_count]
+      attribute for the backend. *)
+  val profile_count : char -> l -> int option
 end
 
 module IdGraph : sig
@@ -202,6 +227,12 @@ module Make (C : CONFIG) : sig
   val compile_def : int -> int -> ctx -> typed_def -> cdef list * ctx
 
   val compile_ast : ctx -> typed_ast -> cdef list * ctx
+
+  (** The locations of the functions, branches, and branch targets
+      instrumented for coverage by [C.branch_coverage], each as a
+      list indexed by ID. Each location is a C initializer for the
+      [struct sail_coverage_span] type in sail_coverage.h. *)
+  val coverage_spans : unit -> string list * string list * string list
 end
 
 (** Adds some special functions to the environment that are used to
@@ -239,7 +239,11 @@ let string_of_op = function
   | Bvxor -> "@bvxor"
   | Bvadd -> "@bvadd"
   | Bvsub -> "@bvsub"
+  | Bvadd_lanes n -> "@bvadd_lanes::<" ^ string_of_int n ^ ">"
+  | Bvsub_lanes n -> "@bvsub_lanes::<" ^ string_of_int n ^ ">"
   | Bvaccess -> "@bvaccess"
+  | Bvshl -> "@bvshl"
+  | Bvlshr -> "@bvlshr"
   | Ilt -> "@lt"
   | Igt -> "@gt"
   | Ilteq -> "@lteq"
@@ -971,6 +975,8 @@ let rec infer_call op vs =
   | Bvnot, [v] -> cval_ctyp v
   | Bvaccess, _ -> CT_bit
   | (Bvor | Bvand | Bvxor | Bvadd | Bvsub), [v; _] -> cval_ctyp v
+  | (Bvadd_lanes _ | Bvsub_lanes _), [v; _] -> cval_ctyp v
+  | (Bvshl | Bvlshr), [v; _] -> cval_ctyp v
   | (Ilt | Igt | Ilteq | Igteq), _ -> CT_bool
   | (Iadd | Isub), _ -> CT_fint 64
   | (Unsigned n | Signed n), _ -> CT_fint n
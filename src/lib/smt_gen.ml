@@ -356,6 +356,7 @@ module Make (Config : CONFIG) (Primop_gen : PRIMOP_GEN) = struct
     | Sslice _, _ -> failwith "sslice"
     | Set_slice, _ -> failwith "set_slice"
     | Replicate _, _ -> failwith "replicate"
+    | (Bvadd_lanes _ | Bvsub_lanes _), _ -> failwith "lanes"
     | List_hd, [arg] -> Fn ("hd", [arg])
     | op, _ -> failwith (string_of_op op)
 
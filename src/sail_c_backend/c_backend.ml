@@ -91,6 +91,16 @@ let opt_prefix = ref "z"
 let opt_extra_params = ref None
 let opt_extra_arguments = ref None
 let opt_branch_coverage = ref None
+let opt_coverage_counts = ref false
+let opt_line_directives = ref false
+let opt_shadow_stack = ref false
+let opt_symbol_map = ref None
+let opt_decode_cache = ref IdSet.empty
+let opt_setjmp_exceptions = ref false
+let opt_profile = ref None
+let opt_split = ref None
+let opt_register_struct = ref false
+let opt_unroll = ref None
 
 let extra_params () = match !opt_extra_params with Some str -> str ^ ", " | _ -> ""
 
@@ -103,6 +113,27 @@ let optimize_struct_updates = ref false
 let optimize_alias = ref false
 let optimize_fixed_int = ref false
 let optimize_fixed_bits = ref false
+let optimize_fbits128 = ref false
+let optimize_stack_variants = ref false
+
+(* The largest bitvector we can represent with the fixed bits type
+   fbits, either a uint64_t or an unsigned __int128 with -Ofbits128. *)
+let max_fbits () = if !optimize_fbits128 then 128 else 64
+
+let optimize_wide_bits = ref false
+
+(* With -Owide_bits, bitvectors with a static length up to this size
+   are also represented as fixed bits, stored on the stack as an array
+   of 64-bit words (the wbits types in sail.h). *)
+let max_wide_bits = 2048
+
+let is_wide_fbits n = n > max_fbits ()
+
+(* The runtime only provides wide bitvector types for a few word
+   counts, so round up to the nearest one. *)
+let wide_fbits_name n =
+  let words = (n + 63) / 64 in
+  "wbits" ^ string_of_int (List.find (fun size -> words <= size) [2; 4; 8; 16; 32])
 
 let gensym, _ = symbol_generator "cb"
 let ngensym () = name (gensym ())
@@ -136,10 +167,11 @@ let rec is_stack_ctyp ctyp =
   | CT_lbits -> false
   | CT_real | CT_string | CT_list _ | CT_vector _ | CT_fvector _ -> false
   | CT_struct (_, fields) -> List.for_all (fun (_, ctyp) -> is_stack_ctyp ctyp) fields
-  | CT_variant (_, _) ->
-      false
-      (* List.for_all (fun (_, ctyp) -> is_stack_ctyp ctyp) ctors *)
-      (* FIXME *)
+  (* The exception type stays on the heap, as current_exception is a
+     pointer to it *)
+  | CT_variant (id, ctors) when !optimize_stack_variants && string_of_id id <> "exception" ->
+      List.for_all (fun (_, ctyp) -> is_stack_ctyp ctyp) ctors
+  | CT_variant (_, _) -> false
   | CT_tup ctyps -> List.for_all is_stack_ctyp ctyps
   | CT_ref _ -> true
   | CT_poly _ -> true
@@ -149,6 +181,11 @@ let rec is_stack_ctyp ctyp =
 
 let v_mask_lower i = V_lit (VL_bits (Util.list_init i (fun _ -> Sail2_values.B1)), CT_fbits i)
 
+(* A mask with the top bit of every lane of an n-bit bitvector set *)
+let v_lane_high n lane =
+  let bit j = if (n - j) mod lane = 0 then Sail2_values.B1 else Sail2_values.B0 in
+  V_lit (VL_bits (Util.list_init n bit), CT_fbits n)
+
 let hex_char =
   let open Sail2_values in
   function
@@ -190,6 +227,8 @@ let rec sgen_ctyp_name = function
   | CT_unit -> "unit"
   | CT_bit -> "fbits"
   | CT_bool -> "bool"
+  | CT_fbits n when is_wide_fbits n -> wide_fbits_name n
+  | CT_fbits n when n > 64 -> "fbits128"
   | CT_fbits _ -> "fbits"
   | CT_sbits _ -> "sbits"
   | CT_fint _ -> "mach_int"
@@ -256,8 +295,53 @@ let c_if_else cond then_block else_block =
 
 let c_return exp = string "return" ^^ space ^^ exp ^^ semi
 
+(* The counts in a coverage file, keyed by the kind of each line
+   ('F', 'B', or 'T') and its span. Lines are summed, so the files
+   from several runs can be concatenated. A file without counts
+   counts each line as reached once. *)
+type profile = {
+  counts : (char * string * int * int * int * int, int) Hashtbl.t;
+  files : (string, unit) Hashtbl.t;
+}
+
+let read_profile filename =
+  let profile = { counts = Hashtbl.create 4096; files = Hashtbl.create 16 } in
+  let chan = try open_in filename with Sys_error msg -> c_error ("Could not open profile " ^ msg) in
+  let add kind file l1 c1 l2 c2 rest =
+    let count = try Scanf.sscanf rest ", %d" (fun n -> n) with Scanf.Scan_failure _ | End_of_file -> 1 in
+    let key = (kind, file, l1, c1, l2, c2) in
+    let count = count + Option.value ~default:0 (Hashtbl.find_opt profile.counts key) in
+    Hashtbl.replace profile.counts key count;
+    Hashtbl.replace profile.files file ()
+  in
+  let rec loop () =
+    match input_line chan with
+    | "" -> loop ()
+    | line ->
+        begin
+          try Scanf.sscanf line "%c %S, %d, %d, %d, %d%[^\n]" add
+          with Scanf.Scan_failure _ | End_of_file | Failure _ ->
+            close_in chan;
+            c_error ("Could not parse line in profile " ^ filename ^ ": " ^ line)
+        end;
+        loop ()
+    | exception End_of_file -> close_in chan
+  in
+  loop ();
+  profile
+
+(* Spans in files the profile doesn't mention were not measured, as
+   opposed to never being reached. *)
+let profile_count profile kind l =
+  match Reporting.simp_loc l with
+  | Some (p1, p2) when Hashtbl.mem profile.files p1.pos_fname ->
+      let key = (kind, p1.pos_fname, p1.pos_lnum, p1.pos_cnum - p1.pos_bol, p2.pos_lnum, p2.pos_cnum - p2.pos_bol) in
+      Some (Option.value ~default:0 (Hashtbl.find_opt profile.counts key))
+  | _ -> None
+
 module C_config (Opts : sig
   val branch_coverage : out_channel option
+  val profile : profile option
 end) : CONFIG = struct
   (** Convert a sail type into a C-type. This function can be quite
      slow, because it uses ctx.local_env and SMT to analyse the Sail
@@ -302,11 +386,17 @@ end) : CONFIG = struct
     | Typ_app (id, [A_aux (A_typ typ, _)]) when string_of_id id = "list" -> CT_list (ctyp_suprema (convert_typ ctx typ))
     (* When converting a sail bitvector type into C, we have three options in order of efficiency:
        - If the length is obviously static and smaller than 64, use the fixed bits type (aka uint64_t), fbits.
+         With -Ofbits128 static lengths up to 128 also use fbits, represented as an unsigned __int128,
+         and with -Owide_bits static lengths up to 2048 use fbits, represented as an array of words.
        - If the length is less than 64, then use a small bits type, sbits.
        - If the length may be larger than 64, use a large bits type lbits. *)
     | Typ_app (id, [A_aux (A_nexp n, _)]) when string_of_id id = "bitvector" -> begin
         match nexp_simp n with
-        | Nexp_aux (Nexp_constant n, _) when Big_int.less_equal n (Big_int.of_int 64) -> CT_fbits (Big_int.to_int n)
+        | Nexp_aux (Nexp_constant n, _) when Big_int.less_equal n (Big_int.of_int (max_fbits ())) ->
+            CT_fbits (Big_int.to_int n)
+        | Nexp_aux (Nexp_constant n, _)
+          when !optimize_wide_bits && Big_int.less_equal n (Big_int.of_int max_wide_bits) ->
+            CT_fbits (Big_int.to_int n)
         | n when prove __POS__ ctx.local_env (nc_lteq n (nint 64)) -> CT_sbits 64
         | _ -> CT_lbits
       end
@@ -478,6 +568,10 @@ end) : CONFIG = struct
     in
     AE_aux (aexp, annot)
 
+  (* Slices of wide bitvectors are only optimized when the result fits in a uint64_t *)
+  let wide_slice_ok vec_ctyp n =
+    match vec_ctyp with CT_fbits m when is_wide_fbits m -> n <= 64 | _ -> not (is_wide_fbits n)
+
   let analyze_primop' ctx id args typ =
     let no_change = AE_app (id, args, typ) in
     let args = List.map (c_aval ctx) args in
@@ -499,7 +593,7 @@ end) : CONFIG = struct
     | "zeros", [_] -> begin
         match destruct_vector ctx.tc_env typ with
         | Some (Nexp_aux (Nexp_constant n, _), Typ_aux (Typ_id id, _))
-          when string_of_id id = "bit" && Big_int.less_equal n (Big_int.of_int 64) ->
+          when string_of_id id = "bit" && Big_int.less_equal n (Big_int.of_int (max_fbits ())) ->
             let n = Big_int.to_int n in
             AE_val (AV_cval (V_lit (VL_bits (Util.list_init n (fun _ -> Sail2_values.B0)), CT_fbits n), typ))
         | _ -> no_change
@@ -507,14 +601,14 @@ end) : CONFIG = struct
     | "zero_extend", [AV_cval (v, _); _] -> begin
         match destruct_vector ctx.tc_env typ with
         | Some (Nexp_aux (Nexp_constant n, _), Typ_aux (Typ_id id, _))
-          when string_of_id id = "bit" && Big_int.less_equal n (Big_int.of_int 64) ->
+          when string_of_id id = "bit" && Big_int.less_equal n (Big_int.of_int (max_fbits ())) ->
             AE_val (AV_cval (V_call (Zero_extend (Big_int.to_int n), [v]), typ))
         | _ -> no_change
       end
     | "sign_extend", [AV_cval (v, _); _] -> begin
         match destruct_vector ctx.tc_env typ with
         | Some (Nexp_aux (Nexp_constant n, _), Typ_aux (Typ_id id, _))
-          when string_of_id id = "bit" && Big_int.less_equal n (Big_int.of_int 64) ->
+          when string_of_id id = "bit" && Big_int.less_equal n (Big_int.of_int (max_fbits ())) ->
             AE_val (AV_cval (V_call (Sign_extend (Big_int.to_int n), [v]), typ))
         | _ -> no_change
       end
@@ -524,6 +618,13 @@ end) : CONFIG = struct
     | "gt", [AV_cval (v1, _); AV_cval (v2, _)] -> AE_val (AV_cval (V_call (Igt, [v1; v2]), typ))
     | "append", [AV_cval (v1, _); AV_cval (v2, _)] -> begin
         match convert_typ ctx typ with
+        | CT_fbits n when is_wide_fbits n -> no_change
+        | CT_fbits n when n > 64 -> begin
+            (* Only fixed bits appends can produce a 128-bit result *)
+            match (cval_ctyp v1, cval_ctyp v2) with
+            | CT_fbits _, CT_fbits _ -> AE_val (AV_cval (V_call (Concat, [v1; v2]), typ))
+            | _ -> no_change
+          end
         | CT_fbits _ | CT_sbits _ -> AE_val (AV_cval (V_call (Concat, [v1; v2]), typ))
         | _ -> no_change
       end
@@ -538,18 +639,46 @@ end) : CONFIG = struct
         AE_val (AV_cval (V_call (Bvor, [v1; v2]), typ))
     | "xor_bits", [AV_cval (v1, _); AV_cval (v2, _)] when ctyp_equal (cval_ctyp v1) (cval_ctyp v2) ->
         AE_val (AV_cval (V_call (Bvxor, [v1; v2]), typ))
+    | ("add_lanes" | "sub_lanes"), [AV_cval (v1, _); AV_cval (v2, _); AV_cval (_, ltyp)]
+      when ctyp_equal (cval_ctyp v1) (cval_ctyp v2) -> begin
+        let op lane = if extern = "add_lanes" then Bvadd_lanes lane else Bvsub_lanes lane in
+        match (cval_ctyp v1, destruct_atom_nexp ctx.local_env ltyp) with
+        | CT_fbits n, Some (Nexp_aux (Nexp_constant lane, _))
+          when List.exists (fun l -> Big_int.equal lane (Big_int.of_int l)) [8; 16; 32; 64] ->
+            (* Lanes must tile the bitvector exactly, so no carry can reach the bits above its length *)
+            let lane = Big_int.to_int lane in
+            if n > 0 && n mod lane = 0 then AE_val (AV_cval (V_call (op lane, [v1; v2]), typ)) else no_change
+        | _ -> no_change
+      end
     | "vector_subrange", [AV_cval (vec, _); AV_cval (_, _); AV_cval (t, _)] -> begin
         match convert_typ ctx typ with
+        | CT_fbits n when not (wide_slice_ok (cval_ctyp vec) n) -> no_change
         | CT_fbits n -> AE_val (AV_cval (V_call (Slice n, [vec; t]), typ))
         | _ -> no_change
       end
     | "slice", [AV_cval (vec, _); AV_cval (start, _); AV_cval (len, _)] -> begin
         match convert_typ ctx typ with
+        | CT_fbits n when not (wide_slice_ok (cval_ctyp vec) n) -> no_change
         | CT_fbits n -> AE_val (AV_cval (V_call (Slice n, [vec; start]), typ))
         | CT_sbits 64 -> AE_val (AV_cval (V_call (Sslice 64, [vec; start; len]), typ))
         | _ -> no_change
       end
     | "vector_access", [AV_cval (vec, _); AV_cval (n, _)] -> AE_val (AV_cval (V_call (Bvaccess, [vec; n]), typ))
+    | "vector_update_subrange", [AV_cval (vec, _); _; AV_cval (lo, _); AV_cval (slice, _)] -> begin
+        match (cval_ctyp vec, cval_ctyp slice) with
+        | CT_fbits _, CT_fbits m when m <= 64 -> AE_val (AV_cval (V_call (Set_slice, [vec; lo; slice]), typ))
+        | _ -> no_change
+      end
+    | "shiftl", [AV_cval (vec, _); AV_cval (n, _)] -> begin
+        match (cval_ctyp vec, cval_ctyp n) with
+        | CT_fbits _, (CT_fint _ | CT_constant _) -> AE_val (AV_cval (V_call (Bvshl, [vec; n]), typ))
+        | _ -> no_change
+      end
+    | "shiftr", [AV_cval (vec, _); AV_cval (n, _)] -> begin
+        match (cval_ctyp vec, cval_ctyp n) with
+        | CT_fbits _, (CT_fint _ | CT_constant _) -> AE_val (AV_cval (V_call (Bvlshr, [vec; n]), typ))
+        | _ -> no_change
+      end
     | "add_int", [AV_cval (op1, _); AV_cval (op2, _)] -> begin
         match destruct_range ctx.local_env typ with
         | None -> no_change
@@ -568,7 +697,7 @@ end) : CONFIG = struct
     | "replicate_bits", [AV_cval (vec, vtyp); _] -> begin
         match (destruct_vector ctx.tc_env typ, destruct_vector ctx.tc_env vtyp) with
         | Some (Nexp_aux (Nexp_constant n, _), _), Some (Nexp_aux (Nexp_constant m, _), _)
-          when Big_int.less_equal n (Big_int.of_int 64) ->
+          when Big_int.less_equal n (Big_int.of_int (max_fbits ())) ->
             let times = Big_int.div n m in
             if Big_int.equal (Big_int.mul m times) n then
               AE_val (AV_cval (V_call (Replicate (Big_int.to_int times), [vec]), typ))
@@ -583,7 +712,52 @@ end) : CONFIG = struct
     let no_change = AE_app (id, args, typ) in
     if !optimize_primops then (try analyze_primop' ctx id args typ with Failure _ -> no_change) else no_change
 
-  let optimize_anf ctx aexp = analyze_functions ctx analyze_primop (c_literals ctx aexp)
+  (* Unroll a foreach loop with constant bounds and at most limit
+     iterations into a block that binds the loop variable to each
+     index in turn. The C compiler can then fold the index into each
+     copy of the body, and vectorise the resulting straight-line
+     operations on separate lanes. Every iteration is its own block,
+     so the copies of the body's locals do not clash. *)
+  let unroll_foreach limit =
+    let constant (AE_aux (aexp, { env; _ }) as full) =
+      match aexp with
+      | AE_val (AV_lit (L_aux (L_num n, _), _)) -> Some n
+      | _ -> (
+          match destruct_atom_nexp env (aexp_typ full) with Some (Nexp_aux (Nexp_constant n, _)) -> Some n | _ -> None
+        )
+    in
+    function
+    | AE_aux (AE_for (id, from_aexp, to_aexp, by_aexp, Ord_aux (ord, _), body), annot) as aexp -> begin
+        match (constant from_aexp, constant to_aexp, constant by_aexp) with
+        | Some from, Some upto, Some by when Big_int.greater by Big_int.zero ->
+            let first, last = match ord with Ord_inc -> (from, upto) | Ord_dec -> (upto, from) in
+            let count =
+              if Big_int.less last first then Big_int.zero
+              else Big_int.succ (Big_int.div (Big_int.sub last first) by)
+            in
+            if Big_int.greater count (Big_int.of_int limit) then aexp
+            else (
+              let l = gen_loc annot.loc in
+              let new_annot = { annot with loc = l; uannot = empty_uannot } in
+              let iteration n =
+                let i =
+                  match ord with
+                  | Ord_inc -> Big_int.add from (Big_int.mul (Big_int.of_int n) by)
+                  | Ord_dec -> Big_int.sub from (Big_int.mul (Big_int.of_int n) by)
+                in
+                let index = AE_aux (AE_val (AV_lit (L_aux (L_num i, l), atom_typ (nconstant i))), new_annot) in
+                AE_aux (AE_let (Immutable, id, atom_typ (nconstant i), index, body, unit_typ), new_annot)
+              in
+              let unit_aexp = AE_aux (AE_val (AV_lit (L_aux (L_unit, l), unit_typ)), new_annot) in
+              AE_aux (AE_block (List.init (Big_int.to_int count) iteration, unit_aexp, unit_typ), new_annot)
+            )
+        | _ -> aexp
+      end
+    | aexp -> aexp
+
+  let optimize_anf ctx aexp =
+    let aexp = match !opt_unroll with Some limit -> fold_aexp (unroll_foreach limit) aexp | None -> aexp in
+    analyze_functions ctx analyze_primop (c_literals ctx aexp)
 
   let unroll_loops = None
   let make_call_precise _ _ _ _ = true
@@ -595,6 +769,10 @@ end) : CONFIG = struct
   let track_throw = true
   let use_void = false
   let eager_control_flow = false
+  let match_decision_trees = true
+  let setjmp_exceptions = !opt_setjmp_exceptions
+  let branch_hints = true
+  let profile_count kind l = Option.bind Opts.profile (fun profile -> profile_count profile kind l)
 end
 
 (** Functions that have heap-allocated return types are implemented by
@@ -903,7 +1081,16 @@ let optimize recursive_functions cdefs =
 (**************************************************************************)
 
 let sgen_uid uid = zencode_uid uid
-let sgen_name id = string_of_name ~deref_current_exception:true ~zencode:true id
+
+(* With -c_register_struct, registers are fields of the global struct
+   sail_regs rather than separate global variables. *)
+let struct_registers = ref IdSet.empty
+
+let sgen_register id = if IdSet.mem id !struct_registers then "sail_regs." ^ sgen_id id else sgen_id id
+
+let sgen_name = function
+  | Name (id, _) when IdSet.mem id !struct_registers -> sgen_register id
+  | id -> string_of_name ~deref_current_exception:true ~zencode:true id
 let codegen_id id = string (sgen_id id)
 
 let sgen_function_id id =
@@ -920,6 +1107,8 @@ let rec sgen_ctyp = function
   | CT_unit -> "unit"
   | CT_bit -> "fbits"
   | CT_bool -> "bool"
+  | CT_fbits n when is_wide_fbits n -> wide_fbits_name n
+  | CT_fbits n when n > 64 -> "fbits128"
   | CT_fbits _ -> "uint64_t"
   | CT_sbits _ -> "sbits"
   | CT_fint _ -> "int64_t"
@@ -942,17 +1131,23 @@ let rec sgen_ctyp = function
 
 let sgen_const_ctyp = function CT_string -> "const_sail_string" | ty -> sgen_ctyp ty
 
-let sgen_mask n =
+let rec sgen_mask n =
   if n = 0 then "UINT64_C(0)"
   else if n <= 64 then (
     let chars_F = String.make (n / 4) 'F' in
     let first = match n mod 4 with 0 -> "" | 1 -> "1" | 2 -> "3" | 3 -> "7" | _ -> assert false in
     "UINT64_C(0x" ^ first ^ chars_F ^ ")"
   )
-  else failwith "Tried to create a mask literal for a vector greater than 64 bits."
+  else if n <= 128 then "FBITS128_C(" ^ sgen_mask (n - 64) ^ ", UINT64_MAX)"
+  else failwith "Tried to create a mask literal for a vector greater than 128 bits."
 
-let sgen_value = function
+let rec sgen_value = function
   | VL_bits [] -> "UINT64_C(0)"
+  | VL_bits bs when List.length bs > 64 ->
+      let hi_len = List.length bs - 64 in
+      Printf.sprintf "FBITS128_C(%s, %s)"
+        (sgen_value (VL_bits (Util.take hi_len bs)))
+        (sgen_value (VL_bits (Util.drop hi_len bs)))
   | VL_bits bs -> "UINT64_C(" ^ Sail2_values.show_bitlist bs ^ ")"
   | VL_int i -> if Big_int.equal i (min_int 64) then "INT64_MIN" else "INT64_C(" ^ Big_int.to_string i ^ ")"
   | VL_bool true -> "true"
@@ -964,7 +1159,7 @@ let sgen_value = function
   | VL_real str -> str
   | VL_string str -> "\"" ^ str ^ "\""
   | VL_enum element -> Util.zencode_string element
-  | VL_ref r -> "&" ^ Util.zencode_string r
+  | VL_ref r -> "&" ^ sgen_register (mk_id r)
   | VL_undefined -> Reporting.unreachable Parse_ast.Unknown __POS__ "Cannot generate C value for an undefined literal"
 
 let rec sgen_cval = function
@@ -993,11 +1188,14 @@ and sgen_call op cvals =
   | Eq, [v1; v2] -> begin
       match cval_ctyp v1 with
       | CT_sbits _ -> sprintf "eq_sbits(%s, %s)" (sgen_cval v1) (sgen_cval v2)
+      | CT_fbits n when is_wide_fbits n -> sprintf "eq_%s(%s, %s)" (wide_fbits_name n) (sgen_cval v1) (sgen_cval v2)
       | _ -> sprintf "(%s == %s)" (sgen_cval v1) (sgen_cval v2)
     end
   | Neq, [v1; v2] -> begin
       match cval_ctyp v1 with
       | CT_sbits _ -> sprintf "neq_sbits(%s, %s)" (sgen_cval v1) (sgen_cval v2)
+      | CT_fbits n when is_wide_fbits n ->
+          sprintf "!eq_%s(%s, %s)" (wide_fbits_name n) (sgen_cval v1) (sgen_cval v2)
       | _ -> sprintf "(%s != %s)" (sgen_cval v1) (sgen_cval v2)
     end
   | Ilt, [v1; v2] -> sprintf "(%s < %s)" (sgen_cval v1) (sgen_cval v2)
@@ -1012,48 +1210,95 @@ and sgen_call op cvals =
     end
   | Bvand, [v1; v2] -> begin
       match cval_ctyp v1 with
+      | CT_fbits n when is_wide_fbits n -> sprintf "and_%s(%s, %s)" (wide_fbits_name n) (sgen_cval v1) (sgen_cval v2)
       | CT_fbits _ -> sprintf "(%s & %s)" (sgen_cval v1) (sgen_cval v2)
       | CT_sbits _ -> sprintf "and_sbits(%s, %s)" (sgen_cval v1) (sgen_cval v2)
       | _ -> assert false
     end
   | Bvnot, [v] -> begin
       match cval_ctyp v with
+      | CT_fbits n when is_wide_fbits n -> sprintf "not_%s(%s, %d)" (wide_fbits_name n) (sgen_cval v) n
       | CT_fbits n -> sprintf "(~(%s) & %s)" (sgen_cval v) (sgen_cval (v_mask_lower n))
       | CT_sbits _ -> sprintf "not_sbits(%s)" (sgen_cval v)
       | _ -> assert false
     end
   | Bvor, [v1; v2] -> begin
       match cval_ctyp v1 with
+      | CT_fbits n when is_wide_fbits n -> sprintf "or_%s(%s, %s)" (wide_fbits_name n) (sgen_cval v1) (sgen_cval v2)
       | CT_fbits _ -> sprintf "(%s | %s)" (sgen_cval v1) (sgen_cval v2)
       | CT_sbits _ -> sprintf "or_sbits(%s, %s)" (sgen_cval v1) (sgen_cval v2)
       | _ -> assert false
     end
   | Bvxor, [v1; v2] -> begin
       match cval_ctyp v1 with
+      | CT_fbits n when is_wide_fbits n -> sprintf "xor_%s(%s, %s)" (wide_fbits_name n) (sgen_cval v1) (sgen_cval v2)
       | CT_fbits _ -> sprintf "(%s ^ %s)" (sgen_cval v1) (sgen_cval v2)
       | CT_sbits _ -> sprintf "xor_sbits(%s, %s)" (sgen_cval v1) (sgen_cval v2)
       | _ -> assert false
     end
   | Bvadd, [v1; v2] -> begin
       match cval_ctyp v1 with
+      | CT_fbits n when is_wide_fbits n ->
+          sprintf "add_%s(%s, %s, %d)" (wide_fbits_name n) (sgen_cval v1) (sgen_cval v2) n
       | CT_fbits n -> sprintf "((%s + %s) & %s)" (sgen_cval v1) (sgen_cval v2) (sgen_cval (v_mask_lower n))
       | CT_sbits _ -> sprintf "add_sbits(%s, %s)" (sgen_cval v1) (sgen_cval v2)
       | _ -> assert false
     end
   | Bvsub, [v1; v2] -> begin
       match cval_ctyp v1 with
+      | CT_fbits n when is_wide_fbits n ->
+          sprintf "sub_%s(%s, %s, %d)" (wide_fbits_name n) (sgen_cval v1) (sgen_cval v2) n
       | CT_fbits n -> sprintf "((%s - %s) & %s)" (sgen_cval v1) (sgen_cval v2) (sgen_cval (v_mask_lower n))
       | CT_sbits _ -> sprintf "sub_sbits(%s, %s)" (sgen_cval v1) (sgen_cval v2)
       | _ -> assert false
     end
+  | Bvadd_lanes lane, [v1; v2] -> begin
+      match cval_ctyp v1 with
+      | CT_fbits n when is_wide_fbits n ->
+          sprintf "add_lanes_%s(%s, %s, %d)" (wide_fbits_name n) (sgen_cval v1) (sgen_cval v2) lane
+      | CT_fbits n ->
+          let high = sgen_cval (v_lane_high n lane) in
+          sprintf "(((%s & ~%s) + (%s & ~%s)) ^ ((%s ^ %s) & %s))" (sgen_cval v1) high (sgen_cval v2) high
+            (sgen_cval v1) (sgen_cval v2) high
+      | _ -> assert false
+    end
+  | Bvsub_lanes lane, [v1; v2] -> begin
+      match cval_ctyp v1 with
+      | CT_fbits n when is_wide_fbits n ->
+          sprintf "sub_lanes_%s(%s, %s, %d)" (wide_fbits_name n) (sgen_cval v1) (sgen_cval v2) lane
+      | CT_fbits n ->
+          let high = sgen_cval (v_lane_high n lane) in
+          sprintf "(((%s | %s) - (%s & ~%s)) ^ (~(%s ^ %s) & %s))" (sgen_cval v1) high (sgen_cval v2) high
+            (sgen_cval v1) (sgen_cval v2) high
+      | _ -> assert false
+    end
+  | Bvshl, [vec; n] -> begin
+      match cval_ctyp vec with
+      | CT_fbits m when is_wide_fbits m ->
+          sprintf "shl_%s(%s, %s, %d)" (wide_fbits_name m) (sgen_cval vec) (sgen_cval n) m
+      | CT_fbits m when m > 64 -> sprintf "(safe_lshift128(%s, %s) & %s)" (sgen_cval vec) (sgen_cval n) (sgen_mask m)
+      | CT_fbits m -> sprintf "(safe_lshift(%s, %s) & %s)" (sgen_cval vec) (sgen_cval n) (sgen_mask m)
+      | _ -> assert false
+    end
+  | Bvlshr, [vec; n] -> begin
+      match cval_ctyp vec with
+      | CT_fbits m when is_wide_fbits m -> sprintf "lshr_%s(%s, %s)" (wide_fbits_name m) (sgen_cval vec) (sgen_cval n)
+      | CT_fbits m when m > 64 -> sprintf "safe_rshift128(%s, %s)" (sgen_cval vec) (sgen_cval n)
+      | CT_fbits _ -> sprintf "safe_rshift(%s, %s)" (sgen_cval vec) (sgen_cval n)
+      | _ -> assert false
+    end
   | Bvaccess, [vec; n] -> begin
       match cval_ctyp vec with
+      | CT_fbits m when is_wide_fbits m -> sprintf "access_%s(%s, %s)" (wide_fbits_name m) (sgen_cval vec) (sgen_cval n)
       | CT_fbits _ -> sprintf "(UINT64_C(1) & (%s >> %s))" (sgen_cval vec) (sgen_cval n)
       | CT_sbits _ -> sprintf "(UINT64_C(1) & (%s.bits >> %s))" (sgen_cval vec) (sgen_cval n)
       | _ -> assert false
     end
   | Slice len, [vec; start] -> begin
       match cval_ctyp vec with
+      | CT_fbits n when is_wide_fbits n ->
+          sprintf "extract_%s(%s, %s, %d)" (wide_fbits_name n) (sgen_cval vec) (sgen_cval start) len
+      | CT_fbits _ when len > 64 -> sprintf "(%s & (%s >> %s))" (sgen_mask len) (sgen_cval vec) (sgen_cval start)
       | CT_fbits _ -> sprintf "(safe_rshift(UINT64_MAX, 64 - %d) & (%s >> %s))" len (sgen_cval vec) (sgen_cval start)
       | CT_sbits _ ->
           sprintf "(safe_rshift(UINT64_MAX, 64 - %d) & (%s.bits >> %s))" len (sgen_cval vec) (sgen_cval start)
@@ -1061,12 +1306,20 @@ and sgen_call op cvals =
     end
   | Sslice 64, [vec; start; len] -> begin
       match cval_ctyp vec with
+      | CT_fbits n when is_wide_fbits n ->
+          sprintf "sslice_%s(%s, %s, %s)" (wide_fbits_name n) (sgen_cval vec) (sgen_cval start) (sgen_cval len)
+      | CT_fbits n when n > 64 -> sprintf "sslice128(%s, %s, %s)" (sgen_cval vec) (sgen_cval start) (sgen_cval len)
       | CT_fbits _ -> sprintf "sslice(%s, %s, %s)" (sgen_cval vec) (sgen_cval start) (sgen_cval len)
       | CT_sbits _ -> sprintf "sslice(%s.bits, %s, %s)" (sgen_cval vec) (sgen_cval start) (sgen_cval len)
       | _ -> assert false
     end
   | Set_slice, [vec; start; slice] -> begin
       match (cval_ctyp vec, cval_ctyp slice) with
+      | CT_fbits n, CT_fbits m when is_wide_fbits n ->
+          sprintf "insert_%s(%s, %s, %s, %d)" (wide_fbits_name n) (sgen_cval vec) (sgen_cval start) (sgen_cval slice) m
+      | CT_fbits n, CT_fbits m when n > 64 ->
+          sprintf "((%s & ~((fbits128) %s << %s)) | ((fbits128) %s << %s))" (sgen_cval vec) (sgen_mask m)
+            (sgen_cval start) (sgen_cval slice) (sgen_cval start)
       | CT_fbits _, CT_fbits m ->
           sprintf "((%s & ~(%s << %s)) | (%s << %s))" (sgen_cval vec) (sgen_mask m) (sgen_cval start) (sgen_cval slice)
             (sgen_cval start)
@@ -1080,12 +1333,15 @@ and sgen_call op cvals =
     end
   | Sign_extend n, [v] -> begin
       match cval_ctyp v with
+      | CT_fbits m when n > 64 -> sprintf "fast_sign_extend128(%s, %d, %d)" (sgen_cval v) m n
       | CT_fbits m -> sprintf "fast_sign_extend(%s, %d, %d)" (sgen_cval v) m n
+      | CT_sbits _ when n > 64 -> sprintf "fast_sign_extend128(%s.bits, %s.len, %d)" (sgen_cval v) (sgen_cval v) n
       | CT_sbits _ -> sprintf "fast_sign_extend2(%s, %d)" (sgen_cval v) n
       | _ -> assert false
     end
   | Replicate n, [v] -> begin
       match cval_ctyp v with
+      | CT_fbits m when m * n > 64 -> sprintf "fast_replicate_bits128(UINT64_C(%d), %s, %d)" m (sgen_cval v) n
       | CT_fbits m -> sprintf "fast_replicate_bits(UINT64_C(%d), %s, %d)" m (sgen_cval v) n
       | _ -> assert false
     end
@@ -1094,6 +1350,8 @@ and sgen_call op cvals =
          appends, where the result is guaranteed to be smaller than 64. *)
       match (cval_ctyp v1, cval_ctyp v2) with
       | CT_fbits 0, CT_fbits _ -> sgen_cval v2
+      | CT_fbits n1, CT_fbits n2 when n1 + n2 > 64 ->
+          sprintf "(((fbits128) %s << %d) | %s)" (sgen_cval v1) n2 (sgen_cval v2)
       | CT_fbits _, CT_fbits n2 -> sprintf "(%s << %d) | %s" (sgen_cval v1) n2 (sgen_cval v2)
       | CT_sbits 64, CT_fbits n2 -> sprintf "append_sf(%s, %s, %d)" (sgen_cval v1) (sgen_cval v2) n2
       | CT_fbits n1, CT_sbits 64 -> sprintf "append_fs(%s, %d, %s)" (sgen_cval v1) n1 (sgen_cval v2)
@@ -1115,7 +1373,7 @@ let rec sgen_clexp l = function
   | CL_id (Throw_location _, _) -> "throw_location"
   | CL_id (Channel _, _) -> Reporting.unreachable l __POS__ "CL_id Channel should not appear in C backend"
   | CL_id (Return _, _) -> Reporting.unreachable l __POS__ "CL_id Return should have been removed"
-  | CL_id (Name (id, _), _) -> "&" ^ sgen_id id
+  | CL_id (Name (id, _), _) -> "&" ^ sgen_register id
   | CL_field (clexp, field) -> "&((" ^ sgen_clexp l clexp ^ ")->" ^ zencode_id field ^ ")"
   | CL_tuple (clexp, n) -> "&((" ^ sgen_clexp l clexp ^ ")->ztup" ^ string_of_int n ^ ")"
   | CL_addr clexp -> "(*(" ^ sgen_clexp l clexp ^ "))"
@@ -1128,7 +1386,7 @@ let rec sgen_clexp_pure l = function
   | CL_id (Throw_location _, _) -> "throw_location"
   | CL_id (Channel _, _) -> Reporting.unreachable l __POS__ "CL_id Channel should not appear in C backend"
   | CL_id (Return _, _) -> Reporting.unreachable l __POS__ "CL_id Return should have been removed"
-  | CL_id (Name (id, _), _) -> sgen_id id
+  | CL_id (Name (id, _), _) -> sgen_register id
   | CL_field (clexp, field) -> sgen_clexp_pure l clexp ^ "." ^ zencode_id field
   | CL_tuple (clexp, n) -> sgen_clexp_pure l clexp ^ ".ztup" ^ string_of_int n
   | CL_addr clexp -> "(*(" ^ sgen_clexp_pure l clexp ^ "))"
@@ -1213,35 +1471,144 @@ let rec codegen_conversion l clexp cval =
 let squash_empty docs = List.filter (fun doc -> requirement doc > 0) docs
 let sq_separate_map sep f xs = separate sep (squash_empty (List.map f xs))
 
+(** The decision trees Jib_compile generates for large matches on
+   bitvectors dispatch using a sequence of jumps that compare the same
+   variable against distinct literals. We turn such a sequence into a
+   switch statement, which the C compiler can implement as a jump
+   table or a binary search, rather than a chain of comparisons. **)
+let min_switch_cases = 3
+
+let switch_jumps' instrs =
+  let rec take_cases id seen = function
+    | I_aux (I_jump (V_call (Eq, [V_id (id', _); V_lit (VL_bits bs, _)]), label), _) :: instrs
+      when Name.compare id id' = 0 && not (List.mem bs seen) ->
+        let cases, instrs = take_cases id (bs :: seen) instrs in
+        ((bs, label) :: cases, instrs)
+    | instrs -> ([], instrs)
+  in
+  let codegen_switch id cases =
+    let codegen_case (bs, label) = Printf.sprintf "  case %s: goto %s;" (sgen_value (VL_bits bs)) label in
+    Printf.sprintf "switch (%s) {\n%s\n  }" (sgen_name id) (Util.string_of_list "\n" codegen_case cases)
+  in
+  let switch_var = function
+    | I_aux (I_jump (V_call (Eq, [V_id (id, CT_fbits n); V_lit _]), _), (_, l)) when n <= 64 -> Some (id, l)
+    | _ -> None
+  in
+  let rec go = function
+    | instr :: instrs -> begin
+        match switch_var instr with
+        | Some (id, l) -> begin
+            match take_cases id [] (instr :: instrs) with
+            | cases, rest when List.length cases >= min_switch_cases -> iraw ~loc:l (codegen_switch id cases) :: go rest
+            | _ -> instr :: go instrs
+          end
+        | None -> instr :: go instrs
+      end
+    | [] -> []
+  in
+  go instrs
+
+let switch_jumps instrs =
+  match map_instrs switch_jumps' (iblock instrs) with I_aux (I_block instrs, _) -> instrs | _ -> assert false
+
+(* With -c_setjmp_exceptions, heap-allocated locals are kept on the
+   RTS cleanup stack while they are live, so sail_throw can kill them
+   when it unwinds past them. The stack holds a sail_cleanup_kill_T
+   function for each local, defined in rts.h for the builtin types and
+   alongside KILL(T) for generated types. *)
+let cleanup_push ctyp id =
+  if !opt_setjmp_exceptions then
+    hardline
+    ^^ Printf.ksprintf string "  sail_cleanup_push(&%s, sail_cleanup_kill_%s);" (sgen_name id) (sgen_ctyp_name ctyp)
+  else empty
+
+let cleanup_pop id =
+  if !opt_setjmp_exceptions then Printf.ksprintf string "  sail_cleanup_pop(&%s);" (sgen_name id) ^^ hardline
+  else empty
+
+(* With -c_setjmp_exceptions, a local declared outside a try block
+   and changed inside it can be read again after sail_throw longjmps
+   back to the try block. Its value is then indeterminate unless it is
+   volatile (C11 7.13.2.1). Heap-allocated locals are only changed
+   through the pointer registered on the cleanup stack, so they live
+   in memory anyway and only stack-allocated locals are marked. *)
+let setjmp_volatile_locals = ref NameSet.empty
+
+let find_setjmp_volatile_locals instrs =
+  let volatile = ref NameSet.empty in
+  let changed body =
+    let writes = ref NameSet.empty in
+    let decls = ref NameSet.empty in
+    List.iter
+      (iter_instr (function
+        | I_aux ((I_decl (_, id) | I_init (_, id, _)), _) -> decls := NameSet.add id !decls
+        | instr -> writes := NameSet.union (instr_writes instr) !writes
+        )
+        )
+      body;
+    NameSet.diff !writes !decls
+  in
+  let rec find (I_aux (instr, _)) =
+    match instr with
+    | I_try_block body ->
+        volatile := NameSet.union (changed body) !volatile;
+        List.iter find body
+    | I_if (_, then_instrs, else_instrs, _) ->
+        List.iter find then_instrs;
+        List.iter find else_instrs
+    | I_block body -> List.iter find body
+    | _ -> ()
+  in
+  if !opt_setjmp_exceptions then List.iter find instrs;
+  !volatile
+
+let sgen_volatile id = if NameSet.mem id !setjmp_volatile_locals then "volatile " else ""
+
+(* Exceptions are rare, so tell the C compiler that branches on
+   have_exception are unlikely to be taken. *)
+let sgen_branch_cval = function
+  | V_id (Have_exception _, _) as cval -> Printf.sprintf "SAIL_UNLIKELY(%s)" (sgen_cval cval)
+  | V_call (Bnot, [V_id (Have_exception _, _)]) as cval -> Printf.sprintf "SAIL_LIKELY(%s)" (sgen_cval cval)
+  | cval -> sgen_cval cval
+
 let rec codegen_instr fid ctx (I_aux (instr, (_, l))) =
   let open Printf in
   match instr with
-  | I_decl (ctyp, id) when is_stack_ctyp ctyp -> ksprintf string "  %s %s;" (sgen_ctyp ctyp) (sgen_name id)
+  | I_decl (ctyp, id) when is_stack_ctyp ctyp ->
+      ksprintf string "  %s%s %s;" (sgen_volatile id) (sgen_ctyp ctyp) (sgen_name id)
   | I_decl (ctyp, id) ->
       ksprintf string "  %s %s;" (sgen_ctyp ctyp) (sgen_name id)
       ^^ hardline
       ^^ sail_create ~prefix:"  " ~suffix:";" (sgen_ctyp_name ctyp) "&%s" (sgen_name id)
+      ^^ cleanup_push ctyp id
   | I_copy (clexp, cval) -> codegen_conversion l clexp cval
-  | I_jump (cval, label) -> ksprintf string "  if (%s) goto %s;" (sgen_cval cval) label
+  | I_jump (cval, label) -> ksprintf string "  if (%s) goto %s;" (sgen_branch_cval cval) label
   | I_if (cval, [], else_instrs, ctyp) -> codegen_instr fid ctx (iif l (V_call (Bnot, [cval])) else_instrs [] ctyp)
   | I_if (cval, [then_instr], [], _) ->
-      ksprintf string "  if (%s)" (sgen_cval cval)
+      ksprintf string "  if (%s)" (sgen_branch_cval cval)
       ^^ space
       ^^ surround 2 0 lbrace (codegen_instr fid ctx then_instr) (twice space ^^ rbrace)
   | I_if (cval, then_instrs, [], _) ->
       string "  if" ^^ space
-      ^^ parens (string (sgen_cval cval))
+      ^^ parens (string (sgen_branch_cval cval))
       ^^ space
       ^^ surround 2 0 lbrace (separate_map hardline (codegen_instr fid ctx) then_instrs) (twice space ^^ rbrace)
   | I_if (cval, then_instrs, else_instrs, _) ->
       string "  if" ^^ space
-      ^^ parens (string (sgen_cval cval))
+      ^^ parens (string (sgen_branch_cval cval))
       ^^ space
       ^^ surround 2 0 lbrace (sq_separate_map hardline (codegen_instr fid ctx) then_instrs) (twice space ^^ rbrace)
       ^^ space ^^ string "else" ^^ space
       ^^ surround 2 0 lbrace (sq_separate_map hardline (codegen_instr fid ctx) else_instrs) (twice space ^^ rbrace)
   | I_block instrs ->
       string "  {" ^^ jump 2 2 (sq_separate_map hardline (codegen_instr fid ctx) instrs) ^^ hardline ^^ string "  }"
+  | I_try_block instrs when !opt_setjmp_exceptions ->
+      string "  { /* try */"
+      ^^ jump 2 2
+           (string "  SAIL_TRY_FRAME(sail_try);" ^^ hardline ^^ string "  if (sail_setjmp(sail_try.buf) == 0)" ^^ space
+           ^^ surround 2 0 lbrace (sq_separate_map hardline (codegen_instr fid ctx) instrs) (twice space ^^ rbrace)
+           )
+      ^^ hardline ^^ string "  }"
   | I_try_block instrs ->
       string "  { /* try */"
       ^^ jump 2 2 (sq_separate_map hardline (codegen_instr fid ctx) instrs)
@@ -1260,6 +1627,14 @@ let rec codegen_instr fid ctx (I_aux (instr, (_, l))) =
         else if ctx_is_extern (fst f) ctx then ctx_get_extern (fst f) ctx
         else sgen_function_uid f
       in
+      (* The runtime only updates fixed width bitvectors in decreasing
+         order, so count an increasing index from the other end *)
+      let c_args =
+        match (fname, ctyp, args) with
+        | "vector_update_inc", CT_fbits n, [vec; m; bit] ->
+            Printf.sprintf "%s, %d - %s, %s" (sgen_cval vec) (n - 1) (sgen_cval m) (sgen_cval bit)
+        | _ -> c_args
+      in
       let fname =
         match (fname, ctyp) with
         | "internal_pick", _ -> Printf.sprintf "pick_%s" (sgen_ctyp_name ctyp)
@@ -1290,25 +1665,33 @@ let rec codegen_instr fid ctx (I_aux (instr, (_, l))) =
         | "vector_update_subrange_inc", _ -> Printf.sprintf "vector_update_subrange_inc_%s" (sgen_ctyp_name ctyp)
         | "vector_subrange", _ -> Printf.sprintf "vector_subrange_%s" (sgen_ctyp_name ctyp)
         | "vector_subrange_inc", _ -> Printf.sprintf "vector_subrange_inc_%s" (sgen_ctyp_name ctyp)
+        | "vector_update", CT_fbits n when is_wide_fbits n -> "update_" ^ wide_fbits_name n
+        | "vector_update", CT_fbits n when n > 64 -> "update_fbits128"
         | "vector_update", CT_fbits _ -> "update_fbits"
         | "vector_update", CT_lbits -> "update_lbits"
         | "vector_update", _ -> Printf.sprintf "vector_update_%s" (sgen_ctyp_name ctyp)
-        | "vector_update_inc", CT_fbits _ -> "update_fbits_inc"
+        | "vector_update_inc", CT_fbits n when is_wide_fbits n -> "update_" ^ wide_fbits_name n
+        | "vector_update_inc", CT_fbits n when n > 64 -> "update_fbits128"
+        | "vector_update_inc", CT_fbits _ -> "update_fbits"
         | "vector_update_inc", CT_lbits -> "update_lbits_inc"
         | "string_of_bits", _ -> begin
             match cval_ctyp (List.nth args 0) with
+            | CT_fbits n when n > 64 -> "string_of_fbits128"
             | CT_fbits _ -> "string_of_fbits"
             | CT_lbits -> "string_of_lbits"
             | _ -> assert false
           end
         | "decimal_string_of_bits", _ -> begin
             match cval_ctyp (List.nth args 0) with
+            | CT_fbits n when n > 64 -> "decimal_string_of_fbits128"
             | CT_fbits _ -> "decimal_string_of_fbits"
             | CT_lbits -> "decimal_string_of_lbits"
             | _ -> assert false
           end
         | "internal_vector_update", _ -> Printf.sprintf "internal_vector_update_%s" (sgen_ctyp_name ctyp)
         | "internal_vector_init", _ -> Printf.sprintf "internal_vector_init_%s" (sgen_ctyp_name ctyp)
+        | "undefined_bitvector", CT_fbits n when is_wide_fbits n -> Printf.sprintf "UNDEFINED(%s)" (wide_fbits_name n)
+        | "undefined_bitvector", CT_fbits n when n > 64 -> "UNDEFINED(fbits128)"
         | "undefined_bitvector", CT_fbits _ -> "UNDEFINED(fbits)"
         | "undefined_bitvector", CT_lbits -> "UNDEFINED(lbits)"
         | "undefined_bit", _ -> "UNDEFINED(fbits)"
@@ -1323,14 +1706,30 @@ let rec codegen_instr fid ctx (I_aux (instr, (_, l))) =
         string (Printf.sprintf "  %s = %s(%s%s);" (sgen_clexp_pure l x) fname (extra_arguments is_extern) c_args)
       else string (Printf.sprintf "  %s(%s%s, %s);" fname (extra_arguments is_extern) (sgen_clexp l x) c_args)
   | I_clear (ctyp, _) when is_stack_ctyp ctyp -> empty
-  | I_clear (ctyp, id) -> sail_kill ~prefix:"  " ~suffix:";" (sgen_ctyp_name ctyp) "&%s" (sgen_name id)
+  | I_clear (ctyp, id) ->
+      cleanup_pop id ^^ sail_kill ~prefix:"  " ~suffix:";" (sgen_ctyp_name ctyp) "&%s" (sgen_name id)
   | I_init (ctyp, id, cval) ->
       codegen_instr fid ctx (idecl l ctyp id) ^^ hardline ^^ codegen_conversion l (CL_id (id, ctyp)) cval
   | I_reinit (ctyp, id, cval) ->
       codegen_instr fid ctx (ireset l ctyp id) ^^ hardline ^^ codegen_conversion l (CL_id (id, ctyp)) cval
-  | I_reset (ctyp, id) when is_stack_ctyp ctyp -> string (Printf.sprintf "  %s %s;" (sgen_ctyp ctyp) (sgen_name id))
+  | I_reset (ctyp, id) when is_stack_ctyp ctyp ->
+      string (Printf.sprintf "  %s%s %s;" (sgen_volatile id) (sgen_ctyp ctyp) (sgen_name id))
   | I_reset (ctyp, id) -> sail_recreate ~prefix:"  " ~suffix:";" (sgen_ctyp_name ctyp) "&%s" (sgen_name id)
   | I_return cval -> twice space ^^ c_return (string (sgen_cval cval))
+  | I_throw cval when !opt_setjmp_exceptions ->
+      (* A try block with no matching case rethrows current_exception *)
+      let rethrow = match cval with V_id (Current_exception _, _) -> true | _ -> false in
+      ( if rethrow then empty
+        else
+          codegen_conversion l (CL_id (current_exception, cval_ctyp cval)) cval
+          ^^ hardline
+          ^^ codegen_conversion l
+               (CL_id (throw_location, CT_string))
+               (V_lit (VL_string (Reporting.short_loc_to_string l), CT_string))
+          ^^ hardline
+      )
+      ^^ codegen_conversion l (CL_id (have_exception, CT_bool)) (V_lit (VL_bool true, CT_bool))
+      ^^ hardline ^^ string "  sail_throw(*throw_location);"
   | I_throw _ -> c_error ~loc:l "I_throw reached code generator"
   | I_undefined ctyp ->
       let rec codegen_exn_return ctyp =
@@ -1339,6 +1738,7 @@ let rec codegen_instr fid ctx (I_aux (instr, (_, l))) =
         | CT_bit -> ("UINT64_C(0)", [])
         | CT_fint _ -> ("INT64_C(0xdeadc0de)", [])
         | CT_lint when !optimize_fixed_int -> ("((sail_int) 0xdeadc0de)", [])
+        | CT_fbits n when is_wide_fbits n -> (Printf.sprintf "UNDEFINED(%s)(UNIT)" (wide_fbits_name n), [])
         | CT_fbits _ -> ("UINT64_C(0xdeadc0de)", [])
         | CT_sbits _ -> ("undefined_sbits()", [])
         | CT_lbits when !optimize_fixed_bits -> ("undefined_lbits(false)", [])
@@ -1374,6 +1774,17 @@ let rec codegen_instr fid ctx (I_aux (instr, (_, l))) =
               ]
               @ prev
             )
+        | CT_variant (_, (ctor_id, ctor_ctyp) :: _) when is_stack_ctyp ctyp ->
+            let gs = ngensym () in
+            let init, prev = codegen_exn_return ctor_ctyp in
+            ( sgen_name gs,
+              [
+                Printf.sprintf "%s.%s = %s;" (sgen_name gs) (sgen_id ctor_id) init;
+                Printf.sprintf "%s.kind = Kind_%s;" (sgen_name gs) (sgen_id ctor_id);
+                Printf.sprintf "struct %s %s;" (sgen_ctyp_name ctyp) (sgen_name gs);
+              ]
+              @ prev
+            )
         | CT_ref _ -> ("NULL", [])
         | ctyp -> c_error ("Cannot create undefined value for type: " ^ string_of_ctyp ctyp)
       in
@@ -1389,6 +1800,16 @@ let rec codegen_instr fid ctx (I_aux (instr, (_, l))) =
   | I_end _ -> assert false
   | I_exit _ -> string ("  sail_match_failure(\"" ^ String.escaped (string_of_id fid) ^ "\");")
 
+(* Calling KILL(T) through a function pointer cast to take a void
+   pointer would be undefined behaviour, so the cleanup stack uses a
+   wrapper for each type. *)
+let cleanup_kill_def name c_type =
+  if !opt_setjmp_exceptions then
+    twice hardline
+    ^^ Printf.ksprintf string "static void sail_cleanup_kill_%s(void *value) { KILL(%s)((%s *)value); }" name name
+         c_type
+  else empty
+
 let codegen_type_def =
   let open Printf in
   function
@@ -1447,7 +1868,9 @@ let codegen_type_def =
       ^^ surround 2 0 lbrace (separate_map (semi ^^ hardline) struct_field ctors ^^ semi) rbrace
       ^^ semi ^^ twice hardline ^^ struct_copy
       ^^ ( if not (is_stack_ctyp struct_ctyp) then
-             twice hardline ^^ separate (twice hardline) [derive sail_create; derive sail_recreate; derive sail_kill]
+             twice hardline
+             ^^ separate (twice hardline) [derive sail_create; derive sail_recreate; derive sail_kill]
+             ^^ cleanup_kill_def (sgen_id id) (sgen_ctyp struct_ctyp)
            else empty
          )
       ^^ twice hardline ^^ struct_eq
@@ -1493,6 +1916,21 @@ let codegen_type_def =
         let n = sgen_id id in
         c_function ~return:"static void" (sail_kill n "struct %s *op" n) [each_ctor "op->" (clear_field "op") tus]
       in
+      let is_stack_variant = is_stack_ctyp (CT_variant (id, tus)) in
+      (* Constructors for stack allocated variants return by value, as
+         the generated code assigns their result directly *)
+      let codegen_stack_ctor (ctor_id, ctyp) =
+        let n = sgen_id id in
+        c_function
+          ~return:(Printf.sprintf "static struct %s" n)
+          (ksprintf string "%s(%s%s op)" (sgen_function_id ctor_id) (extra_params ()) (sgen_const_ctyp ctyp))
+          [
+            ksprintf c_stmt "struct %s rop" n;
+            ksprintf c_stmt "rop.kind = Kind_%s" (sgen_id ctor_id);
+            ksprintf c_stmt "rop.%s = op" (sgen_id ctor_id);
+            c_return (string "rop");
+          ]
+      in
       let codegen_ctor (ctor_id, ctyp) =
         let ctor_args = Printf.sprintf "%s op" (sgen_const_ctyp ctyp) in
         c_function ~return:"static void"
@@ -1555,35 +1993,46 @@ let codegen_type_def =
            ]
       ^^ twice hardline
       ^^ separate (twice hardline)
-           [
-             string "struct" ^^ space ^^ codegen_id id ^^ space
-             ^^ surround 2 0 lbrace
-                  (separate space [string "enum"; string ("kind_" ^ sgen_id id); string "kind" ^^ semi]
-                  ^^ hardline ^^ string "union" ^^ space
-                  ^^ surround 2 0 lbrace (separate_map (semi ^^ hardline) codegen_tu tus ^^ semi) rbrace
-                  ^^ semi
-                  )
-                  rbrace
-             ^^ semi;
-             codegen_init;
-             codegen_reinit;
-             codegen_clear;
-             codegen_setter;
-             codegen_eq;
-           ]
+           (( string "struct" ^^ space ^^ codegen_id id ^^ space
+            ^^ surround 2 0 lbrace
+                 (separate space [string "enum"; string ("kind_" ^ sgen_id id); string "kind" ^^ semi]
+                 ^^ hardline ^^ string "union" ^^ space
+                 ^^ surround 2 0 lbrace (separate_map (semi ^^ hardline) codegen_tu tus ^^ semi) rbrace
+                 ^^ semi
+                 )
+                 rbrace
+            ^^ semi
+            )
+           :: ( if is_stack_variant then []
+                else
+                  [
+                    codegen_init;
+                    codegen_reinit;
+                    codegen_clear ^^ cleanup_kill_def (sgen_id id) ("struct " ^ sgen_id id);
+                  ]
+              )
+           @ [codegen_setter; codegen_eq]
+           )
       ^^ twice hardline
-      ^^ separate_map (twice hardline) codegen_ctor tus
-      (* If this is the exception type, then we setup up some global variables to deal with exceptions. *)
-      ^^
-      if string_of_id id = "exception" then
-        twice hardline
-        ^^ separate hardline
-             [
-               string "struct zexception *current_exception = NULL;";
-               string "bool have_exception = false;";
-               string "sail_string *throw_location = NULL;";
-             ]
-      else empty
+      ^^ separate_map (twice hardline) (if is_stack_variant then codegen_stack_ctor else codegen_ctor) tus
+
+(* If this is the exception type, then we setup up some global
+   variables to deal with exceptions. With -c_split these are declared
+   extern in the shared header and defined in the main file. *)
+let exception_globals ~extern ctype_def =
+  if string_of_id (ctype_def_id ctype_def) <> "exception" then []
+  else if extern then
+    [
+      "extern struct zexception *current_exception;";
+      "extern bool have_exception;";
+      "extern sail_string *throw_location;";
+    ]
+  else
+    [
+      "struct zexception *current_exception = NULL;";
+      "bool have_exception = false;";
+      "sail_string *throw_location = NULL;";
+    ]
 
 (** GLOBAL: because C doesn't have real anonymous tuple types
    (anonymous structs don't quite work the way we need) every tuple
@@ -1716,7 +2165,7 @@ let codegen_list ctyp =
         codegen_list_init;
         codegen_inc_reference_count;
         codegen_dec_reference_count;
-        codegen_list_clear;
+        codegen_list_clear ^^ cleanup_kill_def (sgen_id id) (sgen_id id);
         codegen_list_recreate;
         codegen_list_copy;
         codegen_cons;
@@ -1882,7 +2331,7 @@ let codegen_vector ctyp =
     let vector_length =
       c_function ~return:"static void"
         (ksprintf string "length_%s(sail_int *rop, %s op)" (sgen_id id) (sgen_id id))
-        [c_stmt "mpz_set_ui(*rop, (unsigned long int)(op.len))"]
+        [c_stmt "sail_int_set_ui(rop, (uint64_t)(op.len))"]
     in
     begin
       generated := IdSet.add id !generated;
@@ -1890,7 +2339,7 @@ let codegen_vector ctyp =
         [
           vector_typedef;
           vector_decl;
-          vector_clear;
+          vector_clear ^^ cleanup_kill_def (sgen_id id) (sgen_id id);
           vector_init;
           vector_reinit;
           vector_undefined;
@@ -1917,7 +2366,202 @@ let codegen_alloc = function
   | I_aux (I_decl (ctyp, id), _) -> sail_create ~prefix:"  " ~suffix:";" (sgen_ctyp_name ctyp) "&%s" (sgen_name id)
   | _ -> assert false
 
-let codegen_def' ctx (CDEF_aux (aux, _)) =
+(* Put a #line directive before every instruction with a known
+   location, so debuggers and profilers attribute the generated code
+   to the Sail source it came from. *)
+let rec add_line_directives instrs = List.concat (List.map add_line_directive instrs)
+
+and add_line_directive (I_aux (aux, (n, l))) =
+  let aux =
+    match aux with
+    | I_if (cval, then_instrs, else_instrs, ctyp) ->
+        I_if (cval, add_line_directives then_instrs, add_line_directives else_instrs, ctyp)
+    | I_block instrs -> I_block (add_line_directives instrs)
+    | I_try_block instrs -> I_try_block (add_line_directives instrs)
+    | aux -> aux
+  in
+  match Reporting.simp_loc l with
+  | Some (p1, _) when p1.pos_fname <> "" ->
+      [iraw (Printf.sprintf "#line %d \"%s\"" p1.pos_lnum (String.escaped p1.pos_fname)); I_aux (aux, (n, l))]
+  | _ -> [I_aux (aux, (n, l))]
+
+(* After a function body with #line directives, this marker is
+   replaced by a #line directive pointing back at the generated C
+   file, once we know which line of which file it ends up on. *)
+let line_restore_marker = "#line __SAIL_RESTORE_LINE__"
+
+let restore_line_directives filename contents =
+  if not !opt_line_directives then contents
+  else
+    String.split_on_char '\n' contents
+    |> List.mapi (fun n line ->
+           if line = line_restore_marker then Printf.sprintf "#line %d \"%s\"" (n + 2) (String.escaped filename)
+           else line
+       )
+    |> String.concat "\n"
+
+(* With -c_shadow_stack, each generated function pushes its id onto
+   the RTS shadow stack for the sampling profiler. The ids index a
+   table of Sail function names emitted after the definitions. *)
+let shadow_stack_ids = ref Bindings.empty
+
+let shadow_stack_table cdefs =
+  let functions =
+    List.filter_map (function CDEF_aux (CDEF_fundef (id, _, _, _), _) -> Some id | _ -> None) cdefs
+  in
+  shadow_stack_ids := List.mapi (fun n id -> (id, n)) functions |> List.to_seq |> Bindings.of_seq;
+  ( ["static const char *const sail_shadow_stack_names[] = {"]
+    @ List.map (fun id -> Printf.sprintf "  \"%s\"," (String.escaped (string_of_id id))) functions
+    @ ["};"],
+    [Printf.sprintf "  sail_shadow_stack_init(sail_shadow_stack_names, %d);" (List.length functions)]
+  )
+
+(* Functions with the decode_cache attribute, or named with
+   -c_decode_cache, are compiled as [f]_uncached, and [f] becomes a
+   wrapper that memoizes the result in a direct-mapped cache indexed
+   by the bitvector argument. Entries belong to an epoch, so the RTS
+   can invalidate every cache at once with decode_cache_flush. *)
+let decode_cache_ids = ref IdSet.empty
+
+let decode_cache_functions ctx cdefs =
+  let marked, defined =
+    List.fold_left
+      (fun (marked, defined) (CDEF_aux (aux, def_annot)) ->
+        let has_attr = Option.is_some (get_def_attribute "decode_cache" def_annot) in
+        match aux with
+        | CDEF_val (id, _, _, _) when has_attr -> (IdSet.add id marked, defined)
+        | CDEF_fundef (id, _, _, _) -> ((if has_attr then IdSet.add id marked else marked), IdSet.add id defined)
+        | _ -> (marked, defined)
+      )
+      (!opt_decode_cache, IdSet.empty) cdefs
+  in
+  IdSet.iter
+    (fun id ->
+      if not (IdSet.mem id defined) then
+        Reporting.warn "Decode cache" (id_loc id)
+          ("No definition for " ^ string_of_id id ^ " was found, so it will not be cached")
+      else (
+        begin
+          match Bindings.find_opt id ctx.valspecs with
+          | Some (_, [CT_fbits n], _, _) when n <= 64 -> ()
+          | _ ->
+              c_error ~loc:(id_loc id)
+                ("Cannot cache " ^ string_of_id id ^ ", as it does not take a single bitvector of at most 64 bits")
+        end;
+        (* A cached call skips the body entirely, so any side effects
+           such as register accesses only happen on a miss *)
+        if not (Effects.function_is_pure id ctx.effect_info) then
+          Reporting.warn "Decode cache" (id_loc id)
+            (string_of_id id
+           ^ " has side effects, which will only happen when its result is not already cached. Call \
+              decode_cache_flush when any state it reads changes."
+            )
+      )
+    )
+    marked;
+  decode_cache_ids := IdSet.inter marked defined;
+  IdSet.elements !decode_cache_ids
+
+let decode_cache_wrapper id heap_return ret_ctyp =
+  let open Printf in
+  let fn = sgen_function_id id in
+  let value_ctyp = sgen_ctyp ret_ctyp in
+  let ctyp_name = sgen_ctyp_name ret_ctyp in
+  let lookup =
+    [
+      sprintf "  struct %s_cache_entry *entry = &%s_cache[sail_decode_cache_index(key)];" fn fn;
+      "  if (entry->epoch == sail_decode_cache_epoch && entry->key == key) {";
+    ]
+  in
+  [
+    sprintf "struct %s_cache_entry {" fn;
+    "  uint64_t key;";
+    "  uint64_t epoch;";
+    sprintf "  %s value;" value_ctyp;
+    "};";
+    "";
+    sprintf "static struct %s_cache_entry %s_cache[SAIL_DECODE_CACHE_SIZE];" fn fn;
+    "";
+  ]
+  @
+  if heap_return then
+    [sprintf "%svoid %s(%s%s *rop, uint64_t key)" (static ()) fn (extra_params ()) value_ctyp; "{"]
+    @ lookup
+    @ [
+        sprintf "    COPY(%s)(rop, entry->value);" ctyp_name;
+        "    return;";
+        "  }";
+        sprintf "  %s_uncached(%srop, key);" fn (extra_arguments false);
+        "  if (SAIL_UNLIKELY(have_exception)) return;";
+        sprintf "  if (entry->epoch == 0) CREATE(%s)(&entry->value);" ctyp_name;
+        sprintf "  COPY(%s)(&entry->value, *rop);" ctyp_name;
+        "  entry->key = key;";
+        "  entry->epoch = sail_decode_cache_epoch;";
+        "}";
+        "";
+        sprintf "%svoid %s_cache_kill(void)" (static ()) fn;
+        "{";
+        "  for (size_t i = 0; i < SAIL_DECODE_CACHE_SIZE; i++) {";
+        sprintf "    if (%s_cache[i].epoch != 0) KILL(%s)(&%s_cache[i].value);" fn ctyp_name fn;
+        sprintf "    %s_cache[i].epoch = 0;" fn;
+        "  }";
+        "}";
+      ]
+  else
+    [sprintf "%s%s %s(%suint64_t key)" (static ()) value_ctyp fn (extra_params ()); "{"]
+    @ lookup
+    @ [
+        "    return entry->value;";
+        "  }";
+        sprintf "  %s result = %s_uncached(%skey);" value_ctyp fn (extra_arguments false);
+        "  if (SAIL_UNLIKELY(have_exception)) return result;";
+        "  entry->key = key;";
+        "  entry->epoch = sail_decode_cache_epoch;";
+        "  entry->value = result;";
+        "  return result;";
+        "}";
+      ]
+
+(* Functions with the cold attribute are optimized for size and
+   placed out of line, and the C compiler treats calls to them as
+   unlikely. *)
+(* With -c_profile, jib_compile gives each function that was
+   measured a profile_count attribute. Functions that were never
+   called are marked cold, and those called at least 1% as often as
+   the most frequently called function are marked hot. *)
+let profile_hot = ref IdSet.empty
+let profile_cold = ref IdSet.empty
+
+let profile_functions cdefs =
+  let counts =
+    List.filter_map
+      (function
+        | CDEF_aux (CDEF_fundef (id, _, _, _), def_annot) -> begin
+            match get_def_attribute "profile_count" def_annot with
+            | Some (_, Some (AD_aux (AD_num n, _))) -> Some (id, Big_int.to_int n)
+            | _ -> None
+          end
+        | _ -> None
+        )
+      cdefs
+  in
+  let max_count = List.fold_left (fun m (_, n) -> max m n) 0 counts in
+  let select p = List.filter (fun (_, n) -> p n) counts |> List.map fst |> IdSet.of_list in
+  profile_cold := select (fun n -> n = 0);
+  profile_hot := select (fun n -> n > 0 && n >= max_count / 100)
+
+let function_prefix ctx id def_annot =
+  let valspec_cold =
+    match Bindings.find_opt id ctx.valspecs with
+    | Some (_, _, _, uannot) -> Option.is_some (get_attribute "cold" uannot)
+    | None -> false
+  in
+  if valspec_cold || Option.is_some (get_def_attribute "cold" def_annot) || IdSet.mem id !profile_cold then
+    "SAIL_COLD "
+  else if IdSet.mem id !profile_hot then "SAIL_HOT "
+  else ""
+
+let codegen_def' ctx (CDEF_aux (aux, def_annot)) =
   match aux with
   | CDEF_register (id, ctyp, _) ->
       string (Printf.sprintf "// register %s" (string_of_id id))
@@ -1927,13 +2571,14 @@ let codegen_def' ctx (CDEF_aux (aux, _)) =
       if ctx_is_extern id ctx then empty
       else if is_stack_ctyp ret_ctyp then
         string
-          (Printf.sprintf "%s%s %s(%s%s);" (static ()) (sgen_ctyp ret_ctyp) (sgen_function_id id) (extra_params ())
+          (Printf.sprintf "%s%s%s %s(%s%s);" (function_prefix ctx id def_annot) (static ()) (sgen_ctyp ret_ctyp)
+             (sgen_function_id id) (extra_params ())
              (Util.string_of_list ", " sgen_const_ctyp arg_ctyps)
           )
       else
         string
-          (Printf.sprintf "%svoid %s(%s%s *rop, %s);" (static ()) (sgen_function_id id) (extra_params ())
-             (sgen_ctyp ret_ctyp)
+          (Printf.sprintf "%s%svoid %s(%s%s *rop, %s);" (function_prefix ctx id def_annot) (static ())
+             (sgen_function_id id) (extra_params ()) (sgen_ctyp ret_ctyp)
              (Util.string_of_list ", " sgen_const_ctyp arg_ctyps)
           )
   | CDEF_fundef (id, ret_arg, args, instrs) ->
@@ -1953,32 +2598,56 @@ let codegen_def' ctx (CDEF_aux (aux, _)) =
           )
       else ();
 
-      let instrs = add_local_labels instrs in
+      let instrs =
+        match Bindings.find_opt id !shadow_stack_ids with
+        | Some n when !opt_shadow_stack -> iraw (Printf.sprintf "SAIL_SHADOW_FRAME(%d);" n) :: instrs
+        | _ -> instrs
+      in
+      let instrs = add_local_labels (switch_jumps instrs) in
+      let instrs = if !opt_line_directives then add_line_directives instrs else instrs in
       let args =
         Util.string_of_list ", "
           (fun x -> x)
           (List.map2 (fun ctyp arg -> sgen_const_ctyp ctyp ^ " " ^ sgen_id arg) arg_ctyps args)
       in
+      let cached = IdSet.mem id !decode_cache_ids in
+      let function_id, is_static =
+        if cached then (string (sgen_function_id id ^ "_uncached"), true) else (codegen_function_id id, !opt_static)
+      in
       let function_header =
         match ret_arg with
         | None ->
             assert (is_stack_ctyp ret_ctyp);
-            (if !opt_static then string "static " else empty)
+            string (function_prefix ctx id def_annot)
+            ^^ (if is_static then string "static " else empty)
             ^^ string (sgen_ctyp ret_ctyp)
-            ^^ space ^^ codegen_function_id id
+            ^^ space ^^ function_id
             ^^ parens (string (extra_params ()) ^^ string args)
             ^^ hardline
         | Some gs ->
             assert (not (is_stack_ctyp ret_ctyp));
-            (if !opt_static then string "static " else empty)
-            ^^ string "void" ^^ space ^^ codegen_function_id id
+            string (function_prefix ctx id def_annot)
+            ^^ (if is_static then string "static " else empty)
+            ^^ string "void" ^^ space ^^ function_id
             ^^ parens (string (extra_params ()) ^^ string (sgen_ctyp ret_ctyp ^ " *" ^ sgen_id gs ^ ", ") ^^ string args)
             ^^ hardline
       in
+      setjmp_volatile_locals := find_setjmp_volatile_locals instrs;
+      let body = separate_map hardline (codegen_instr id ctx) instrs in
+      setjmp_volatile_locals := NameSet.empty;
       function_header ^^ string "{"
-      ^^ jump 0 2 (separate_map hardline (codegen_instr id ctx) instrs)
+      ^^ jump 0 2 body
+      ^^ (if !opt_line_directives then hardline ^^ string line_restore_marker else empty)
       ^^ hardline ^^ string "}"
-  | CDEF_type ctype_def -> codegen_type_def ctype_def
+      ^^
+      if cached then
+        twice hardline ^^ separate_map hardline string (decode_cache_wrapper id (Option.is_some ret_arg) ret_ctyp)
+      else empty
+  | CDEF_type ctype_def -> begin
+      match exception_globals ~extern:false ctype_def with
+      | [] -> codegen_type_def ctype_def
+      | globals -> codegen_type_def ctype_def ^^ twice hardline ^^ separate_map hardline string globals
+    end
   | CDEF_startup (id, instrs) ->
       let startup_header = string (Printf.sprintf "%svoid startup_%s(void)" (static ()) (sgen_function_id id)) in
       separate_map hardline codegen_decl instrs
@@ -2038,7 +2707,7 @@ let codegen_ctg = function
 
 (** When we generate code for a definition, we need to first generate
    any auxillary type definitions that are required. *)
-let codegen_def ctx def =
+let codegen_deps def =
   let ctyps = cdef_ctyps def |> CTSet.elements in
   (* We should have erased any polymorphism introduced by variants at this point! *)
   if List.exists is_polymorphic ctyps then (
@@ -2050,9 +2719,11 @@ let codegen_def ctx def =
   )
   else (
     let deps = List.concat (List.map ctyp_dependencies ctyps) in
-    separate_map hardline codegen_ctg deps ^^ codegen_def' ctx def
+    separate_map hardline codegen_ctg deps
   )
 
+let codegen_def ctx def = codegen_deps def ^^ codegen_def' ctx def
+
 let is_cdef_startup = function CDEF_aux (CDEF_startup _, _) -> true | _ -> false
 
 let sgen_startup = function
@@ -2074,45 +2745,295 @@ let get_recursive_functions cdefs =
   List.fold_left (fun rf component -> match component with [_] -> rf | mutual -> mutual @ rf) rf (IdGraph.scc graph)
   |> IdSet.of_list
 
-let jib_of_ast env effect_info ast =
+(* With -c_split, assign each function to one of n files. Mutually
+   recursive functions are kept together, and components are placed
+   largest first into whichever file has the fewest instructions so
+   far, to balance the work for the C compiler. *)
+let split_functions n cdefs =
+  let functions =
+    List.filter_map
+      (function
+        | CDEF_aux (CDEF_fundef (id, _, _, body), _) ->
+            let size = ref 0 in
+            List.iter (iter_instr (fun _ -> incr size)) body;
+            Some (id, !size)
+        | _ -> None
+        )
+      cdefs
+  in
+  let sizes = List.to_seq functions |> Bindings.of_seq in
+  let component_size component = List.fold_left (fun total id -> total + Bindings.find id sizes) 0 component in
+  let components =
+    IdGraph.scc ~original_order:(List.map fst functions) (Jib_compile.callgraph cdefs)
+    |> List.map (List.filter (fun id -> Bindings.mem id sizes))
+    |> List.filter (fun component -> component <> [])
+    |> List.stable_sort (fun c1 c2 -> compare (component_size c2) (component_size c1))
+  in
+  let loads = Array.make n 0 in
+  List.fold_left
+    (fun assignment component ->
+      let file = ref 0 in
+      Array.iteri (fun i load -> if load < loads.(!file) then file := i) loads;
+      loads.(!file) <- loads.(!file) + component_size component;
+      List.fold_left (fun assignment id -> Bindings.add id !file assignment) assignment component
+    )
+    Bindings.empty components
+
+(* Order the fields of the register struct so frequently used
+   registers share cache lines. Registers that a let binding collects
+   into a vector of references, such as a general purpose register
+   file, are kept together in that order. Each group is weighted by
+   the number of instructions that use its registers or its let
+   binding, scaled by the profile count of the function when we have
+   one, and groups with a [hot] register come first and groups where
+   every register is [cold] come last. *)
+let register_struct_layout cdefs =
+  let registers =
+    List.filter_map
+      (function
+        | CDEF_aux (CDEF_register (id, ctyp, _), def_annot) ->
+            let has_attr attr = Option.is_some (get_def_attribute attr def_annot) in
+            Some (id, (ctyp, has_attr "hot", has_attr "cold"))
+        | _ -> None
+        )
+      cdefs
+  in
+  let info = List.to_seq registers |> Bindings.of_seq in
+  let weights = ref Bindings.empty in
+  let add_weight id n = weights := Bindings.update id (fun w -> Some (n + Option.value ~default:0 w)) !weights in
+  List.iter
+    (function
+      | CDEF_aux (CDEF_fundef (_, _, _, body), def_annot) ->
+          let scale =
+            match get_def_attribute "profile_count" def_annot with
+            | Some (_, Some (AD_aux (AD_num n, _))) -> Big_int.to_int n
+            | _ -> 1
+          in
+          List.iter
+            (iter_instr (fun instr ->
+                 NameSet.iter (function Name (id, _) -> add_weight id scale | _ -> ()) (instr_ids instr)
+             )
+            )
+            body
+      | _ -> ()
+      )
+    cdefs;
+  let weight id = Option.value ~default:0 (Bindings.find_opt id !weights) in
+  let rec cval_refs = function
+    | V_lit (VL_ref r, _) -> [mk_id r]
+    | V_call (_, cvals) | V_tuple (cvals, _) -> List.concat (List.map cval_refs cvals)
+    | V_struct (fields, _) -> List.concat (List.map (fun (_, cval) -> cval_refs cval) fields)
+    | _ -> []
+  in
+  let instr_refs instrs =
+    let refs = ref [] in
+    List.iter
+      (iter_instr (function
+        | I_aux (I_funcall (_, _, _, cvals), _) -> refs := !refs @ List.concat (List.map cval_refs cvals)
+        | I_aux ((I_copy (_, cval) | I_init (_, _, cval)), _) -> refs := !refs @ cval_refs cval
+        | _ -> ()
+        )
+        )
+      instrs;
+    !refs
+  in
+  let grouped, groups =
+    List.fold_left
+      (fun (grouped, groups) cdef ->
+        match cdef with
+        | CDEF_aux (CDEF_let (_, bindings, instrs), _) ->
+            let add_member (grouped', members) id =
+              if Bindings.mem id info && not (IdSet.mem id grouped') then (IdSet.add id grouped', id :: members)
+              else (grouped', members)
+            in
+            let grouped', members = List.fold_left add_member (grouped, []) (instr_refs instrs) in
+            if List.length members > 1 then
+              (grouped', (List.rev members, List.fold_left (fun w (id, _) -> w + weight id) 0 bindings) :: groups)
+            else (grouped, groups)
+        | _ -> (grouped, groups)
+      )
+      (IdSet.empty, []) cdefs
+  in
+  let groups =
+    List.rev groups
+    @ List.filter_map (fun (id, _) -> if IdSet.mem id grouped then None else Some ([id], 0)) registers
+  in
+  let ctyp_of id =
+    let ctyp, _, _ = Bindings.find id info in
+    ctyp
+  in
+  let rank (members, let_weight) =
+    let is_hot id =
+      let _, hot, _ = Bindings.find id info in
+      hot
+    in
+    let is_cold id =
+      let _, _, cold = Bindings.find id info in
+      cold
+    in
+    let temperature = if List.exists is_hot members then 0 else if List.for_all is_cold members then 2 else 1 in
+    (temperature, -List.fold_left (fun w id -> w + weight id) let_weight members)
+  in
+  List.stable_sort (fun g1 g2 -> compare (rank g1) (rank g2)) groups
+  |> List.map (fun (members, _) -> List.map (fun id -> (id, ctyp_of id)) members)
+  |> List.concat
+
+let jib_of_ast_with_coverage env effect_info ast =
   let module Jibc = Make (C_config (struct
     let branch_coverage = !opt_branch_coverage
+    let profile = Option.map read_profile !opt_profile
   end)) in
   let env, effect_info = add_special_functions env effect_info in
   let ctx = initial_ctx env effect_info in
-  Jibc.compile_ast ctx ast
+  let cdefs, ctx = Jibc.compile_ast ctx ast in
+  (cdefs, ctx, Jibc.coverage_spans ())
 
-let compile_ast env effect_info output_chan c_includes ast =
+let jib_of_ast env effect_info ast =
+  let cdefs, ctx, _ = jib_of_ast_with_coverage env effect_info ast in
+  (cdefs, ctx)
+
+(* Static tables of the source locations for each coverage ID, which
+   are registered with the coverage library in model_init. With
+   -c_coverage_counts the library counts hits rather than just
+   recording that an ID was seen. *)
+let coverage_tables (functions, branches, branch_targets) =
+  let table name = function
+    | [] -> ([], "NULL")
+    | spans ->
+        ( [Printf.sprintf "static const struct sail_coverage_span %s[] = {" name]
+          @ List.map (fun span -> Printf.sprintf "  {%s}," span) spans
+          @ ["};"],
+          name
+        )
+  in
+  let functions_def, functions_ptr = table "sail_coverage_functions" functions in
+  let branches_def, branches_ptr = table "sail_coverage_branches" branches in
+  let branch_targets_def, branch_targets_ptr = table "sail_coverage_branch_targets" branch_targets in
+  ( functions_def @ branches_def @ branch_targets_def,
+    [
+      Printf.sprintf "  %s(%s, %d, %s, %d, %s, %d);"
+        (if !opt_coverage_counts then "sail_coverage_init_counts" else "sail_coverage_init")
+        functions_ptr (List.length functions) branches_ptr (List.length branches) branch_targets_ptr
+        (List.length branch_targets);
+    ]
+  )
+
+let compile_ast ?basename env effect_info output_chan c_includes ast =
   try
-    let cdefs, ctx = jib_of_ast env effect_info ast in
+    let cdefs, ctx, coverage_spans = jib_of_ast_with_coverage env effect_info ast in
     (* let cdefs', _ = Jib_optimize.remove_tuples cdefs ctx in *)
     let cdefs = insert_heap_returns Bindings.empty cdefs in
 
+    if !opt_setjmp_exceptions && !opt_no_rts then c_error "-c_setjmp_exceptions requires the RTS";
+    if Option.is_some !opt_split && !opt_static then c_error "-c_split cannot be used with -static";
+    if Option.is_some !opt_split && Option.is_none basename then c_error "-c_split requires an output file name";
+
     let recursive_functions = get_recursive_functions cdefs in
     let cdefs = optimize recursive_functions cdefs in
+    profile_functions cdefs;
+
+    let register_fields = if !opt_register_struct then register_struct_layout cdefs else [] in
+    struct_registers := IdSet.of_list (List.map fst register_fields);
+    let register_struct =
+      if register_fields = [] then []
+      else
+        ["struct sail_registers {"]
+        @ List.map (fun (id, ctyp) -> Printf.sprintf "  %s %s;" (sgen_ctyp ctyp) (sgen_id id)) register_fields
+        @ ["};"]
+    in
+
+    (* Must happen before we generate any functions, so they know their ids *)
+    let shadow_stack_defs, shadow_stack_init =
+      if !opt_shadow_stack then (
+        let table, init = shadow_stack_table cdefs in
+        if !opt_no_rts then (table @ [""; "void model_shadow_stack_init(void)"; "{"] @ init @ ["}"], [])
+        else (table, init)
+      )
+      else ([], [])
+    in
+
+    let decode_cache_killed =
+      decode_cache_functions ctx cdefs
+      |> List.filter (fun id ->
+             match Bindings.find_opt id ctx.valspecs with
+             | Some (_, _, ret_ctyp, _) -> not (is_stack_ctyp ret_ctyp)
+             | None -> false
+         )
+    in
+    let decode_cache_kill fmt = List.map (fun id -> Printf.sprintf fmt (sgen_function_id id)) decode_cache_killed in
+    let decode_cache_fini = decode_cache_kill "  %s_cache_kill();" in
+
+    (* With -c_split the type definitions are generated in the header
+       instead. The register struct must come after the types it uses
+       and before any function, so with -c_register_struct the type
+       definitions and prototypes are generated first. *)
+    let docs =
+      if Option.is_some !opt_split then empty
+      else if register_struct = [] then separate_map (hardline ^^ hardline) (codegen_def ctx) cdefs
+      else (
+        let is_decl = function CDEF_aux ((CDEF_type _ | CDEF_val _), _) -> true | _ -> false in
+        let is_register = function CDEF_aux (CDEF_register _, _) -> true | _ -> false in
+        let decls, rest = List.partition is_decl cdefs in
+        let registers, rest = List.partition is_register rest in
+        let decls_doc = separate_map (hardline ^^ hardline) (codegen_def ctx) decls in
+        let registers_doc = separate_map hardline codegen_deps registers in
+        let rest_doc = separate_map (hardline ^^ hardline) (codegen_def ctx) rest in
+        decls_doc ^^ hardline ^^ hardline ^^ registers_doc ^^ hardline
+        ^^ separate_map hardline string (register_struct @ [static () ^ "struct sail_registers sail_regs;"])
+        ^^ hardline ^^ hardline ^^ rest_doc
+      )
+    in
 
-    let docs = separate_map (hardline ^^ hardline) (codegen_def ctx) cdefs in
+    (* Write a table from generated C function names back to the Sail
+       functions they implement, for tools that post-process profiles. *)
+    Option.iter
+      (fun chan ->
+        List.iter
+          (function
+            | CDEF_aux (CDEF_fundef (id, _, _, _), def_annot) -> begin
+                match Reporting.simp_loc def_annot.loc with
+                | Some (p1, p2) ->
+                    Printf.fprintf chan "%s\t%s\t%s\t%d\t%d\n" (sgen_function_id id) (string_of_id id) p1.pos_fname
+                      p1.pos_lnum p2.pos_lnum
+                | None -> Printf.fprintf chan "%s\t%s\t\t0\t0\n" (sgen_function_id id) (string_of_id id)
+              end
+            | _ -> ()
+          )
+          cdefs;
+        close_out chan
+      )
+      !opt_symbol_map;
 
-    let coverage_include =
+    let coverage_header, coverage_hooks =
       let header = string "#include \"sail_coverage.h\"" in
-      (* Generate a hook for the RTS to call if we have coverage
+      (* Generate hooks for the RTS to call if we have coverage
          enabled, so it can set the output file with an option. *)
-      let coverage_hook = string "void (*sail_rts_set_coverage_file)(const char *) = &sail_set_coverage_file;" in
-      let no_coverage_hook = string "void (*sail_rts_set_coverage_file)(const char *) = NULL;" in
+      let coverage_hook =
+        [
+          string "void (*sail_rts_set_coverage_file)(const char *) = &sail_set_coverage_file;";
+          string "void (*sail_rts_set_coverage_binary_file)(const char *) = &sail_set_coverage_binary_file;";
+        ]
+      in
+      let no_coverage_hook =
+        [
+          string "void (*sail_rts_set_coverage_file)(const char *) = NULL;";
+          string "void (*sail_rts_set_coverage_binary_file)(const char *) = NULL;";
+        ]
+      in
       match !opt_branch_coverage with
-      | Some _ -> if !opt_no_rts then [header] else [header; coverage_hook]
-      | None -> if !opt_no_rts then [] else [no_coverage_hook]
+      | Some _ -> ([header], if !opt_no_rts then [] else coverage_hook)
+      | None -> ([], if !opt_no_rts then [] else no_coverage_hook)
     in
 
-    let preamble =
-      separate hardline
-        ((if !opt_no_lib then [] else [string "#include \"sail.h\""])
-        @ (if !opt_no_rts then [] else [string "#include \"rts.h\""; string "#include \"elf.h\""])
-        @ coverage_include
-        @ List.map (fun h -> string (Printf.sprintf "#include \"%s\"" h)) c_includes
-        @ [string "#ifdef __cplusplus"; string "extern \"C\" {"; string "#endif"]
-        )
+    let begin_extern_cpp = [string "#ifdef __cplusplus"; string "extern \"C\" {"; string "#endif"] in
+    let includes =
+      (if !opt_no_lib then [] else [string "#include \"sail.h\""])
+      @ (if !opt_no_rts then [] else [string "#include \"rts.h\""; string "#include \"elf.h\""])
+      @ coverage_header
     in
+    let user_includes = List.map (fun h -> string (Printf.sprintf "#include \"%s\"" h)) c_includes in
+
+    let preamble = separate hardline (includes @ coverage_hooks @ user_includes @ begin_extern_cpp) in
 
     let exn_boilerplate =
       if not (Bindings.mem (mk_id "exception") ctx.variants) then ([], [])
@@ -2144,18 +3065,33 @@ let compile_ast env effect_info output_chan c_includes ast =
     let register_init_clear (id, ctyp, instrs) =
       if is_stack_ctyp ctyp then (List.map (sgen_instr (mk_id "reg") ctx) instrs, [])
       else
-        ( [Printf.sprintf "  CREATE(%s)(&%s);" (sgen_ctyp_name ctyp) (sgen_id id)]
+        ( [Printf.sprintf "  CREATE(%s)(&%s);" (sgen_ctyp_name ctyp) (sgen_register id)]
           @ List.map (sgen_instr (mk_id "reg") ctx) instrs,
-          [Printf.sprintf "  KILL(%s)(&%s);" (sgen_ctyp_name ctyp) (sgen_id id)]
+          [Printf.sprintf "  KILL(%s)(&%s);" (sgen_ctyp_name ctyp) (sgen_register id)]
         )
     in
 
     let init_config_id = mk_id "__InitConfig" in
 
+    (* Without the RTS there is no model_init, so model_coverage_init
+       is a constructor that registers the tables before main runs. A
+       harness can still call it, as registering them twice does
+       nothing. *)
+    let coverage_defs, coverage_init =
+      match !opt_branch_coverage with
+      | Some _ ->
+          let tables, init = coverage_tables coverage_spans in
+          if !opt_no_rts then
+            (tables @ [""; "__attribute__((constructor)) void model_coverage_init(void)"; "{"] @ init @ ["}"], [])
+          else (tables, init)
+      | None -> ([], [])
+    in
+
     let model_init =
       separate hardline
         (List.map string
-           ([Printf.sprintf "%svoid model_init(void)" (static ()); "{"; "  setup_rts();"]
+           ([Printf.sprintf "%svoid model_init(void)" (static ()); "{"]
+           @ coverage_init @ shadow_stack_init @ ["  setup_rts();"]
            @ fst exn_boilerplate @ startup cdefs @ letbind_initializers
            @ List.concat (List.map (fun r -> fst (register_init_clear r)) regs)
            @ (if regs = [] then [] else [Printf.sprintf "  %s(UNIT);" (sgen_function_id (mk_id "initialize_registers"))])
@@ -2174,7 +3110,7 @@ let compile_ast env effect_info output_chan c_includes ast =
            ([Printf.sprintf "%svoid model_fini(void)" (static ()); "{"]
            @ letbind_finalizers
            @ List.concat (List.map (fun r -> snd (register_init_clear r)) regs)
-           @ finish cdefs @ ["  cleanup_rts();"] @ snd exn_boilerplate @ ["}"]
+           @ finish cdefs @ decode_cache_fini @ ["  cleanup_rts();"] @ snd exn_boilerplate @ ["}"]
            )
         )
     in
@@ -2201,12 +3137,18 @@ let compile_ast env effect_info output_chan c_includes ast =
         "{";
         "  model_init();";
         "  if (process_arguments(argc, argv)) exit(EXIT_FAILURE);";
-        Printf.sprintf "  %s(UNIT);" (sgen_function_id (mk_id "main"));
-        "  model_fini();";
-        "  model_pre_exit();";
-        "  return EXIT_SUCCESS;";
-        "}";
       ]
+      @ ( if !opt_setjmp_exceptions then
+            (* An uncaught exception is reported by model_fini *)
+            [
+              "  {";
+              "    SAIL_TRY_FRAME(sail_try);";
+              Printf.sprintf "    if (sail_setjmp(sail_try.buf) == 0) %s(UNIT);" (sgen_function_id (mk_id "main"));
+              "  }";
+            ]
+          else [Printf.sprintf "  %s(UNIT);" (sgen_function_id (mk_id "main"))]
+        )
+      @ ["  model_fini();"; "  model_pre_exit();"; "  return EXIT_SUCCESS;"; "}"]
       |> List.map string |> separate hardline
     in
 
@@ -2219,15 +3161,95 @@ let compile_ast env effect_info output_chan c_includes ast =
     let end_extern_cpp = separate hardline (List.map string [""; "#ifdef __cplusplus"; "}"; "#endif"]) in
     let hlhl = hardline ^^ hardline in
 
-    Document.to_string
-      (preamble ^^ hlhl ^^ docs ^^ hlhl
+    let model_defs =
+      (if coverage_defs = [] then empty else separate_map hardline string coverage_defs ^^ hlhl)
+      ^^ (if shadow_stack_defs = [] then empty else separate_map hardline string shadow_stack_defs ^^ hlhl)
       ^^ ( if not !opt_no_rts then
              model_init ^^ hlhl ^^ model_fini ^^ hlhl ^^ model_pre_exit ^^ hlhl ^^ model_default_main ^^ hlhl
            else empty
          )
       ^^ model_main ^^ hardline ^^ end_extern_cpp ^^ hardline
-      )
-    |> output_string output_chan
+    in
+
+    begin
+      match (!opt_split, basename) with
+      | Some n, Some basename ->
+          (* The header declares everything that is shared between the
+             files, the main file defines the globals and the model_*
+             functions, and each numbered file defines a subset of the
+             generated functions. *)
+          let header_name = Filename.basename basename ^ ".h" in
+          let assignment = split_functions n cdefs in
+          let sections strs = List.filter (fun str -> str <> "") strs |> String.concat "\n\n" in
+          let defs docs = sections (List.map Document.to_string docs) in
+          let extern_decl (id, ctyp) = string (Printf.sprintf "extern %s %s;" (sgen_ctyp ctyp) (sgen_id id)) in
+          let header_def (CDEF_aux (aux, _) as cdef) =
+            codegen_deps cdef
+            ^^
+            match aux with
+            | CDEF_type ctype_def -> begin
+                match exception_globals ~extern:true ctype_def with
+                | [] -> codegen_type_def ctype_def
+                | globals -> codegen_type_def ctype_def ^^ twice hardline ^^ separate_map hardline string globals
+              end
+            | CDEF_val _ -> codegen_def' ctx cdef
+            | CDEF_register (id, ctyp, _) -> if register_struct = [] then extern_decl (id, ctyp) else empty
+            | CDEF_let (_, bindings, _) -> separate_map hardline extern_decl bindings
+            | CDEF_startup (id, _) -> string (Printf.sprintf "void startup_%s(void);" (sgen_function_id id))
+            | CDEF_finish (id, _) -> string (Printf.sprintf "void finish_%s(void);" (sgen_function_id id))
+            | CDEF_fundef _ | CDEF_pragma _ -> empty
+          in
+          let main_def (CDEF_aux (aux, _) as cdef) =
+            match aux with
+            | CDEF_register _ -> if register_struct = [] then codegen_def' ctx cdef else empty
+            | CDEF_let _ -> codegen_def' ctx cdef
+            | CDEF_type ctype_def -> separate_map hardline string (exception_globals ~extern:false ctype_def)
+            | _ -> empty
+          in
+          let function_file = function
+            | CDEF_aux ((CDEF_fundef (id, _, _, _) | CDEF_startup (id, _) | CDEF_finish (id, _)), _) ->
+                Bindings.find_opt id assignment
+            | _ -> None
+          in
+          let write_file filename contents =
+            let chan = open_out filename in
+            output_string chan (restore_line_directives filename (sections contents));
+            output_string chan (Document.to_string end_extern_cpp ^ "\n");
+            close_out chan
+          in
+          let include_header = string (Printf.sprintf "#include \"%s\"" header_name) in
+          let header_preamble = (string "#pragma once" :: includes) @ user_includes @ begin_extern_cpp in
+          write_file (basename ^ ".h")
+            [
+              Document.to_string (separate hardline header_preamble);
+              defs (List.map header_def cdefs);
+              String.concat "\n" register_struct;
+              (if register_struct = [] then "" else "extern struct sail_registers sail_regs;");
+              String.concat "\n" (decode_cache_kill "void %s_cache_kill(void);");
+            ];
+          for i = 0 to n - 1 do
+            write_file
+              (Printf.sprintf "%s_%d.c" basename (i + 1))
+              [
+                Document.to_string (separate hardline (include_header :: begin_extern_cpp));
+                defs (List.filter (fun cdef -> function_file cdef = Some i) cdefs |> List.map (codegen_def' ctx));
+              ]
+          done;
+          sections
+            [
+              Document.to_string (separate hardline ((include_header :: coverage_hooks) @ begin_extern_cpp));
+              (if register_struct = [] then "" else "struct sail_registers sail_regs;");
+              defs (List.map main_def cdefs);
+              Document.to_string model_defs;
+            ]
+          |> restore_line_directives (basename ^ ".c")
+          |> output_string output_chan
+      | _ ->
+          let filename = match basename with Some basename -> basename ^ ".c" | None -> "<stdout>" in
+          Document.to_string (preamble ^^ hlhl ^^ docs ^^ hlhl ^^ model_defs)
+          |> restore_line_directives filename
+          |> output_string output_chan
+    end
   with Type_error.Type_error (l, err) ->
     c_error ~loc:l ("Unexpected type error when compiling to C:\n" ^ fst (Type_error.string_of_type_error err))
 
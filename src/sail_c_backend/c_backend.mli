@@ -110,6 +110,57 @@ val opt_extra_arguments : string option ref
 
 val opt_branch_coverage : out_channel option ref
 
+(** Count how many times each coverage location is reached, rather
+    than just whether it was reached. Only has an effect alongside
+    [opt_branch_coverage]. *)
+val opt_coverage_counts : bool ref
+
+(** Emit #line directives mapping the generated C for each function
+    back to the Sail source. *)
+val opt_line_directives : bool ref
+
+(** Maintain a stack of the Sail functions currently executing for the
+    RTS sampling profiler. *)
+val opt_shadow_stack : bool ref
+
+(** Write a tab separated table of generated C function names, Sail
+    function names, files, and line ranges to a file. *)
+val opt_symbol_map : out_channel option ref
+
+(** Functions to memoize in a decoded-instruction cache, in addition
+    to those with the [decode_cache] attribute. Each must take a
+    single bitvector of at most 64 bits. *)
+val opt_decode_cache : Ast_util.IdSet.t ref
+
+(** Implement exceptions with setjmp and longjmp in the RTS, rather
+    than checking have_exception after every call that can throw. *)
+val opt_setjmp_exceptions : bool ref
+
+(** A coverage file with hit counts, written by a model compiled with
+    [opt_branch_coverage] and [opt_coverage_counts]. Match cases are
+    reordered so the most frequently taken are tested first, functions
+    that were never called are marked cold, and the most frequently
+    called functions are marked hot. *)
+val opt_profile : string option ref
+
+(** Split the generated C into a header, a main file, and this many
+    further files containing the generated functions, so they can be
+    compiled in parallel. Mutually recursive functions are kept in
+    the same file. *)
+val opt_split : int option ref
+
+(** Generate registers as fields of a single global struct rather
+    than as separate globals. Fields are ordered so registers marked
+    [hot], or used most often (weighted by [opt_profile] when given),
+    come first, and registers collected into a vector by a let
+    binding, such as a general purpose register file, are adjacent. *)
+val opt_register_struct : bool ref
+
+(** Unroll foreach loops with constant bounds and at most this many
+    iterations, so the C compiler sees each index as a constant and
+    can vectorise the straight-line code for each lane. *)
+val opt_unroll : int option ref
+
 (** Optimization flags *)
 
 val optimize_primops : bool ref
@@ -119,7 +170,24 @@ val optimize_alias : bool ref
 val optimize_fixed_int : bool ref
 val optimize_fixed_bits : bool ref
 
+(** Allocate unions on the stack when every constructor's type can
+    be, so functions return them by value and their constructors
+    return a new value rather than writing through a pointer. *)
+val optimize_stack_variants : bool ref
+
+(** Use unsigned __int128 (fbits128 in the runtime) for bitvectors
+   with a statically known length of at most 128 bits. *)
+val optimize_fbits128 : bool ref
+
+(** Use fixed size arrays of 64-bit words (wbits in the runtime) for
+   bitvectors with a statically known length of at most 2048 bits. *)
+val optimize_wide_bits : bool ref
+
 val jib_of_ast : Env.t -> Effects.side_effect_info -> typed_ast -> cdef list * Jib_compile.ctx
-val compile_ast : Env.t -> Effects.side_effect_info -> out_channel -> string list -> typed_ast -> unit
+(** Compile to C, writing to the output channel. With [opt_split],
+    the header [basename.h] and the files [basename_1.c] to
+    [basename_n.c] are also written. *)
+val compile_ast :
+  ?basename:string -> Env.t -> Effects.side_effect_info -> out_channel -> string list -> typed_ast -> unit
 
 val compile_ast_clib : Env.t -> Effects.side_effect_info -> typed_ast -> (Jib_compile.ctx -> cdef list -> unit) -> unit
@@ -106,6 +106,55 @@ let c_options =
       Arg.String (fun str -> C_backend.opt_branch_coverage := Some (open_out str)),
       "<file> Turn on coverage tracking and output information about all branches and functions to a file"
     );
+    ( "-c_line_directives",
+      Arg.Set C_backend.opt_line_directives,
+      " emit #line directives so debuggers and profilers report Sail source locations"
+    );
+    ( "-c_shadow_stack",
+      Arg.Set C_backend.opt_shadow_stack,
+      " maintain a stack of the Sail functions being executed, for the sampling profiler (--profile)"
+    );
+    ( "-c_symbol_map",
+      Arg.String (fun str -> C_backend.opt_symbol_map := Some (open_out str)),
+      "<file> write a table mapping generated C function names to Sail functions and source locations"
+    );
+    ( "-c_decode_cache",
+      Arg.String
+        (fun str -> C_backend.opt_decode_cache := Ast_util.IdSet.add (Ast_util.mk_id str) !C_backend.opt_decode_cache),
+      "<function> cache the results of a decode function, keyed by its bitvector argument"
+    );
+    ( "-c_setjmp_exceptions",
+      Arg.Set C_backend.opt_setjmp_exceptions,
+      " propagate exceptions with setjmp/longjmp rather than checking for them after each call (requires the RTS)"
+    );
+    ( "-c_coverage_counts",
+      Arg.Set C_backend.opt_coverage_counts,
+      " record how many times each function, branch, and branch target is reached (use with -c_coverage)"
+    );
+    ( "-c_split",
+      Arg.Int
+        (fun n ->
+          if n < 1 then raise (Arg.Bad "-c_split expects a positive number of files");
+          C_backend.opt_split := Some n
+        ),
+      "<n> split the generated functions across n C files sharing a header, so they can be compiled in parallel"
+    );
+    ( "-c_register_struct",
+      Arg.Set C_backend.opt_register_struct,
+      " generate registers as fields of one struct, with frequently used registers first"
+    );
+    ( "-c_unroll",
+      Arg.Int
+        (fun n ->
+          if n < 1 then raise (Arg.Bad "-c_unroll expects a positive number of iterations");
+          C_backend.opt_unroll := Some n
+        ),
+      "<n> unroll foreach loops with constant bounds and at most n iterations"
+    );
+    ( "-c_profile",
+      Arg.String (fun str -> C_backend.opt_profile := Some str),
+      "<file> reorder match cases and mark functions hot or cold using a coverage file written with -c_coverage_counts"
+    );
     ( "-O",
       Arg.Tuple
         [
@@ -125,6 +174,18 @@ let c_options =
       Arg.Set C_backend.optimize_fixed_bits,
       " assume fixed size bitvectors rather than arbitrary precision bitvectors"
     );
+    ( "-Ostack_variants",
+      Arg.Set C_backend.optimize_stack_variants,
+      " allocate unions whose constructors only contain fixed size types on the stack, and return them by value"
+    );
+    ( "-Ofbits128",
+      Arg.Set C_backend.optimize_fbits128,
+      " use 128-bit integers for bitvectors with a fixed length between 65 and 128 bits"
+    );
+    ( "-Owide_bits",
+      Arg.Set C_backend.optimize_wide_bits,
+      " use stack allocated word arrays for bitvectors with a fixed length of up to 2048 bits"
+    );
     ("-static", Arg.Set C_backend.opt_static, " make generated C functions static");
   ]
 
@@ -162,7 +223,7 @@ let c_rewrites =
 let c_target out_file { ast; effect_info; env; _ } =
   let close, output_chan = match out_file with Some f -> (true, open_out (f ^ ".c")) | None -> (false, stdout) in
   Reporting.opt_warnings := true;
-  C_backend.compile_ast env effect_info output_chan !opt_includes_c ast;
+  C_backend.compile_ast ?basename:out_file env effect_info output_chan !opt_includes_c ast;
   flush output_chan;
   if close then close_out output_chan
 
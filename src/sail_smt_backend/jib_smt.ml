@@ -1325,6 +1325,10 @@ end) : Jib_compile.CONFIG = struct
   let track_throw = false
   let use_void = false
   let eager_control_flow = true
+  let match_decision_trees = false
+  let setjmp_exceptions = false
+  let branch_hints = false
+  let profile_count _ _ = None
 end
 
 (* In order to support register references, we need to build a map
@@ -327,6 +327,10 @@ module Verilog_config (C : JIB_CONFIG) : Jib_compile.CONFIG = struct
   let use_real = false
   let use_void = false
   let eager_control_flow = false
+  let match_decision_trees = false
+  let setjmp_exceptions = false
+  let branch_hints = false
+  let profile_count _ _ = None
 end
 
 let register_types cdefs =
@@ -0,0 +1,27 @@
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Count the calls that reach the body of the cached decode function,
+ * so the test can tell cache hits from misses.
+ */
+
+static int64_t decode_calls_total = 0;
+
+unit count_decode(const unit u)
+{
+  decode_calls_total++;
+  return UNIT;
+}
+
+int64_t decode_calls(const unit u)
+{
+  return decode_calls_total;
+}
+
+#ifdef __cplusplus
+}
+#endif
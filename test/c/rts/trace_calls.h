@@ -0,0 +1,74 @@
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Primitives that trace their arguments and results using the RTS
+ * tracing functions, covering each kind of value. traced_int calls
+ * traced_add before returning, so its result is traced one level
+ * deeper.
+ */
+
+uint64_t traced_add(const uint64_t x, const uint64_t y)
+{
+  trace_start("traced_add");
+  trace_fbits(x);
+  trace_argsep();
+  trace_fbits(y);
+  trace_argend();
+  uint64_t r = (x + y) & UINT64_C(0xFFFFFFFF);
+  trace_end();
+  trace_fbits(r);
+  trace_retend();
+  return r;
+}
+
+void traced_int(sail_int *rop, const sail_int n, const bool b, const_sail_string s)
+{
+  trace_start("traced_int");
+  trace_sail_int(n);
+  trace_argsep();
+  trace_bool(b);
+  trace_argsep();
+  trace_sail_string(s);
+  trace_argend();
+  traced_add(UINT64_C(0xFFFFFFFF), b);
+  if (b) {
+    neg_int(rop, n);
+  } else {
+    COPY(sail_int)(rop, n);
+  }
+  trace_end();
+  trace_sail_int(*rop);
+  trace_retend();
+}
+
+unit traced_bits(const lbits op)
+{
+  trace_start("traced_bits");
+  trace_lbits(op);
+  trace_argend();
+  trace_end();
+  trace_unit(UNIT);
+  trace_retend();
+  return UNIT;
+}
+
+unit traced_unknown(const unit u)
+{
+  trace_start("traced_unknown");
+  trace_unit(u);
+  trace_argsep();
+  trace_unknown();
+  trace_argend();
+  trace_end();
+  trace_unknown();
+  trace_retend();
+  return UNIT;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,6 +4,7 @@ import os
 import re
 import sys
 import hashlib
+import json
 
 mydir = os.path.dirname(__file__)
 os.chdir(mydir)
@@ -76,6 +77,26 @@ def test_c2(name, c_opts, sail_opts, valgrind):
         results.collect(tests)
     return results.finish()
 
+def test_c_split(name, c_opts, sail_opts, files):
+    banner('Testing {} with C options: {} Sail options: {} split into {} files'.format(name, c_opts, sail_opts, files))
+    results = Results(name)
+    for filenames in chunks(os.listdir('.'), parallel()):
+        tests = {}
+        for filename in filenames:
+            basename = os.path.splitext(os.path.basename(filename))[0]
+            parts = ' '.join('{}_{}.c'.format(basename, n) for n in range(1, files + 1))
+            tests[filename] = os.fork()
+            if tests[filename] == 0:
+                step('{} -no_warn -c -c_split {} {} {} -o {}'.format(sail, files, sail_opts, filename, basename))
+                step('cc {} {}.c {} {}/lib/*.c -lgmp -lz -I {}/lib -o {}.bin'.format(c_opts, basename, parts, sail_dir, sail_dir, basename))
+                step('./{}.bin > {}.result 2> {}.err_result'.format(basename, basename, basename), expected_status = 1 if basename.startswith('fail') else 0)
+                step('diff {}.result {}.expect'.format(basename, basename))
+                step('rm {}.c {}.h {} {}.bin {}.result'.format(basename, basename, parts, basename, basename))
+                print_ok(filename)
+                sys.exit()
+        results.collect(tests)
+    return results.finish()
+
 def test_interpreter(name):
     banner('Testing {}'.format(name))
     results = Results(name)
@@ -201,6 +222,121 @@ def test_coq(name):
         results.collect(tests)
     return results.finish()
 
+# The runtime tests each build a program from the rts directory and
+# check what the RTS writes when it is run with some of its command
+# line options. The other runners ignore rts, as these programs call
+# RTS functions directly.
+
+def build_rts(source, name, sail_opts='', libs=''):
+    step('{} -no_warn -c {} rts/{}.sail -o rts/{}'.format(sail, sail_opts, source, name))
+    step('cc rts/{}.c {}/lib/*.c {} -lgmp -lz -I {}/lib -o rts/{}.bin'.format(name, sail_dir, libs, sail_dir, name))
+
+def rts_trace():
+    build_rts('trace', 'trace')
+    step('./rts/trace.bin > rts/trace.result 2> rts/trace.txt')
+    step('diff rts/trace.result rts/trace.expect')
+    for trace in ['trace.trc', 'trace.trc.gz']:
+        step('./rts/trace.bin --trace-file rts/{} > rts/trace.result'.format(trace))
+        step('diff rts/trace.result rts/trace.expect')
+        step('./rts/sailtrace rts/{} | diff - rts/trace.txt'.format(trace))
+    step('rm rts/trace.c rts/trace.bin rts/trace.result rts/trace.txt rts/trace.trc rts/trace.trc.gz')
+
+def rts_retire():
+    build_rts('retire', 'retire')
+    step('./rts/retire.bin | grep -qx disabled')
+    for trace in ['retire.rtr', 'retire.rtr.gz']:
+        step('./rts/retire.bin --retire-trace rts/{} | grep -qx enabled'.format(trace))
+        step('./rts/sailtrace rts/{} | diff - rts/retire.expect'.format(trace))
+    step('rm rts/retire.c rts/retire.bin rts/retire.rtr rts/retire.rtr.gz')
+
+def rts_profile():
+    build_rts('profile', 'profile', sail_opts='-c_shadow_stack')
+    step('./rts/profile.bin --profile rts/profile.folded > rts/profile.result')
+    step('diff rts/profile.result rts/profile.expect')
+    # Each line of the profile is a folded stack and a sample count
+    stacks = {}
+    with open('rts/profile.folded') as folded:
+        for line in folded:
+            stack, count = line.rsplit(' ', 1)
+            stacks[stack] = int(count)
+    # Almost all the time is spent in outer and inner, and every
+    # sample should be inside main
+    if not any(stack.startswith('main;outer') for stack in stacks) or \
+       not all(stack == 'main' or stack.startswith('main;') or stack == '[unknown]' for stack in stacks):
+        print('{}Failed{}: unexpected profile {}'.format(color.FAIL, color.END, stacks))
+        sys.exit(1)
+    step('rm rts/profile.c rts/profile.bin rts/profile.result rts/profile.folded')
+
+def rts_decode_cache():
+    build_rts('decode', 'decode')
+    step('./rts/decode.bin > rts/decode.result')
+    step('diff rts/decode.result rts/decode.expect')
+    step('rm rts/decode.c rts/decode.bin rts/decode.result')
+
+def rts_stats():
+    build_rts('cycles', 'stats')
+    step('./rts/stats.bin --stats --stats-file rts/stats.json --stats-interval 10000 > rts/stats.result 2> rts/stats.txt')
+    step('grep -qx done rts/stats.result')
+    step('grep -qx "\\[Sail\\] cycles: 100000" rts/stats.txt')
+    for line in ['wall time', 'MIPS', 'peak RSS', 'memory blocks']:
+        step('grep -q "^\\[Sail\\] {}: " rts/stats.txt'.format(line))
+    # One line for every 10000 cycles
+    step('test $(grep -c "^\\[Sail\\] [0-9]* cycles, .* MIPS$" rts/stats.txt) -eq 10')
+    with open('rts/stats.json') as stats_file:
+        stats = json.load(stats_file)
+    schema = {
+        'cycles': int,
+        'wall_seconds': float,
+        'init_seconds': float,
+        'load_seconds': float,
+        'run_seconds': float,
+        'mips': float,
+        'peak_rss_kib': int,
+        'memory_blocks': int,
+        'tag_blocks': int,
+    }
+    if set(stats) != set(schema) or \
+       not all(isinstance(stats[key], schema[key]) and stats[key] >= 0 for key in schema) or \
+       stats['cycles'] != 100000:
+        print('{}Failed{}: unexpected statistics {}'.format(color.FAIL, color.END, stats))
+        sys.exit(1)
+    step('rm rts/stats.c rts/stats.bin rts/stats.result rts/stats.txt rts/stats.json')
+
+def rts_limits():
+    build_rts('cycles', 'limit')
+    step('./rts/limit.bin --cyclelimit 1000 > rts/limit.result')
+    step('grep -qx "\\[Sail\\] TIMEOUT: exceeded 1000 cycles" rts/limit.result')
+    step('grep -qx done rts/limit.result', expected_status=1)
+    # Check model_pre_exit runs after the time limit by building with
+    # coverage, which writes the coverage file there
+    if os.path.exists('{}/lib/coverage/libsail_coverage.a'.format(sail_dir)):
+        build_rts('spin', 'spin',
+                  sail_opts='-c_include sail_coverage.h -c_coverage rts/spin.branches',
+                  libs='{}/lib/coverage/libsail_coverage.a -lpthread -ldl'.format(sail_dir))
+        step('./rts/spin.bin --timelimit 1 -c rts/spin.taken > rts/spin.result', expected_status=1)
+        step('grep -q \'^F "rts/spin.sail"\' rts/spin.taken')
+        step('rm rts/spin.branches rts/spin.taken')
+    else:
+        build_rts('spin', 'spin')
+        step('./rts/spin.bin --timelimit 1 > rts/spin.result', expected_status=1)
+    step('grep -qx "\\[Sail\\] TIMEOUT: exceeded 1 seconds" rts/spin.result')
+    step('rm rts/limit.c rts/limit.bin rts/limit.result rts/spin.c rts/spin.bin rts/spin.result')
+
+def test_rts(name, tests):
+    banner('Testing {}'.format(name))
+    results = Results(name)
+    step('cc -O2 -I {}/lib ../../sailtrace/main.c -lz -o rts/sailtrace'.format(sail_dir))
+    pids = {}
+    for test in tests:
+        pids[test.__name__] = os.fork()
+        if pids[test.__name__] == 0:
+            test()
+            print_ok(test.__name__)
+            sys.exit()
+    results.collect(pids)
+    step('rm rts/sailtrace')
+    return results.finish()
+
 xml = '<testsuites>\n'
 
 if 'c' in targets:
@@ -210,8 +346,21 @@ if 'c' in targets:
     xml += test_c('optimized C', '-O2', '-O', True)
     xml += test_c('optimized C with C++ compiler', '-xc++ -O2', '-O', True, compiler='c++')
     xml += test_c('constant folding', '', '-Oconstant_fold', False)
+    xml += test_c('128-bit fixed bitvectors', '-O2', '-O -Ofbits128', False)
+    xml += test_c('wide fixed bitvectors', '-O2', '-O -Owide_bits', False)
+    xml += test_c('stack allocated unions', '-O2', '-O -Ostack_variants', True)
+    xml += test_c('limb lbits', '-O2 -DSAIL_LIMB_LBITS', '-O', True)
+    xml += test_c('hybrid integers', '-O2 -DSAIL_HYBRID_INT', '-O', True)
+    xml += test_c('pool allocator', '-DSAIL_POOL_ALLOC', '', True)
+    xml += test_c('setjmp exceptions', '', '-c_setjmp_exceptions', True)
+    xml += test_c('optimized setjmp exceptions', '-O2', '-O -c_setjmp_exceptions', True)
+    xml += test_c_split('split C', '-O2', '-O', 3)
+    xml += test_c('register struct', '-O2', '-O -c_register_struct', True)
+    xml += test_c('line directives', '-O2', '-O -c_line_directives', False)
+    xml += test_c('unrolled loops', '-O2', '-O -c_unroll 16', True)
     #xml += test_c('monomorphised C', '-O2', '-O -Oconstant_fold -auto_mono', True)
     xml += test_c('undefined behavior sanitised', '-O2 -fsanitize=undefined', '-O', False)
+    xml += test_rts('runtime', [rts_trace, rts_retire, rts_profile, rts_decode_cache, rts_stats, rts_limits])
 
 if 'interpreter' in targets:
     xml += test_interpreter('interpreter')
@@ -0,0 +1,313 @@
+/*
+ * Microbenchmarks for the primitives in the Sail C runtimes.
+ *
+ * The same file is compiled against lib/sail.c (optionally with
+ * SAIL_HYBRID_INT, SAIL_LIMB_LBITS, or SAIL_POOL_ALLOC), lib/int128/sail.c, and
+ * lib/nostd/sail.c, see the Makefile. Each benchmark is run with a
+ * doubling number of iterations until it takes at least
+ * BENCH_MIN_SECONDS, then repeated, and the fastest time per
+ * operation is reported as JSON on stdout.
+ *
+ * The runtimes differ in whether integers and bitvectors are returned
+ * by value or through a pointer, and in which primitives they
+ * provide, so all calls go through the macros below.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(BENCH_NOSTD)
+#include <gmp.h>
+#endif
+
+#include "sail.h"
+
+#if defined(BENCH_NOSTD)
+#include "sail_arena.h"
+#endif
+
+#if defined(BENCH_RAM)
+#include "rts.h"
+#endif
+
+#ifndef BENCH_RUNTIME
+#define BENCH_RUNTIME "unknown"
+#endif
+
+#define BENCH_MIN_SECONDS 0.02
+#define BENCH_REPEATS 5
+
+/*
+ * int128 and the nostd runtime with SAIL_INT64 or SAIL_INT128 return
+ * integers by value, the GMP runtimes use mpz_t.
+ */
+#if defined(BENCH_INT128) || defined(SAIL_INT64) || defined(SAIL_INT128)
+#define INT_DECL(x) sail_int x
+#define INT_SET(x, v) (x = CREATE_OF(sail_int, mach_int)(v))
+#define INT_KILL(x) (void)(x)
+#define INT_OP(f, rop, ...) (rop = f(__VA_ARGS__))
+#else
+#define INT_DECL(x) sail_int x; CREATE(sail_int)(&x)
+#define INT_SET(x, v) CONVERT_OF(sail_int, mach_int)(&x, v)
+#define INT_KILL(x) KILL(sail_int)(&x)
+#define INT_OP(f, rop, ...) f(&rop, __VA_ARGS__)
+#endif
+
+#if !defined(SAIL_INT64)
+#define BENCH_BIG_INT
+#endif
+
+/*
+ * With SAIL_BITS64 the nostd runtime has 64-bit bitvectors that are
+ * returned by value, and no sign_extend.
+ */
+#if defined(SAIL_BITS64)
+#define BITS_DECL(x) lbits x
+#define BITS_SET(x, v, len) (x = CREATE_OF(lbits, fbits)(v, len, true))
+#define BITS_KILL(x) (void)(x)
+#define BITS_OP(f, rop, ...) (rop = f(__VA_ARGS__))
+#define BENCH_MAX_WIDTH 64
+#else
+#define BITS_DECL(x) lbits x; CREATE(lbits)(&x)
+#define BITS_SET(x, v, len) CONVERT_OF(lbits, fbits)(&x, v, len, true)
+#define BITS_KILL(x) KILL(lbits)(&x)
+#define BITS_OP(f, rop, ...) f(&rop, __VA_ARGS__)
+#define BENCH_MAX_WIDTH 512
+#define BENCH_SIGN_EXTEND
+#endif
+
+#if defined(BENCH_RAM) && !defined(BENCH_INT128)
+/* Normally defined by the generated model, and used by lib/rts.c */
+void (*sail_rts_set_coverage_file)(const char *) = NULL;
+void (*sail_rts_set_coverage_binary_file)(const char *) = NULL;
+void model_pre_exit(void) {}
+#endif
+
+static const char *g_filter = NULL;
+static bool g_first_result = true;
+
+/* Prevents the compiler from discarding results that are not otherwise used */
+static volatile uint64_t g_sink;
+
+static double bench_now(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static bool bench_enabled(const char *name)
+{
+  return g_filter == NULL || strstr(name, g_filter) != NULL;
+}
+
+static uint64_t bench_mask(uint64_t value, uint64_t len)
+{
+  return len >= 64 ? value : value & ((UINT64_C(1) << len) - 1);
+}
+
+static void bench_report(const char *name, uint64_t width, uint64_t iterations, double seconds)
+{
+  printf("%s\n    {\"name\": \"%s\", \"width\": %" PRIu64 ", \"iterations\": %" PRIu64 ", \"ns_per_op\": %.3f}",
+         g_first_result ? "" : ",", name, width, iterations, seconds * 1e9 / (double)iterations);
+  fflush(stdout);
+  g_first_result = false;
+}
+
+#define BENCH(name, width, stmt)                                           \
+  do {                                                                     \
+    if (!bench_enabled(name)) break;                                       \
+    uint64_t bench_iterations = 1;                                         \
+    double bench_best;                                                     \
+    for (;;) {                                                             \
+      double bench_start = bench_now();                                    \
+      for (uint64_t bench_i = 0; bench_i < bench_iterations; bench_i++) {  \
+        stmt;                                                              \
+      }                                                                    \
+      bench_best = bench_now() - bench_start;                              \
+      if (bench_best >= BENCH_MIN_SECONDS) break;                          \
+      bench_iterations *= 2;                                               \
+    }                                                                      \
+    for (int bench_r = 1; bench_r < BENCH_REPEATS; bench_r++) {            \
+      double bench_start = bench_now();                                    \
+      for (uint64_t bench_i = 0; bench_i < bench_iterations; bench_i++) {  \
+        stmt;                                                              \
+      }                                                                    \
+      double bench_elapsed = bench_now() - bench_start;                    \
+      if (bench_elapsed < bench_best) bench_best = bench_elapsed;          \
+    }                                                                      \
+    bench_report(name, width, bench_iterations, bench_best);               \
+  } while (0)
+
+static void bench_bits(uint64_t width)
+{
+  BITS_DECL(op1);
+  BITS_DECL(op2);
+  BITS_DECL(piece);
+  BITS_DECL(rop);
+  INT_DECL(start);
+  INT_DECL(len);
+  INT_DECL(hi);
+  INT_DECL(lo);
+  INT_DECL(times);
+
+  // Operands wider than 64 bits are built from appends, as they would
+  // be in generated code.
+  uint64_t chunk = width < 64 ? width : 64;
+  BITS_SET(op1, bench_mask(UINT64_C(0x0123456789ABCDEF), chunk), chunk);
+  BITS_SET(op2, bench_mask(UINT64_C(0xFEDCBA9876543210), chunk), chunk);
+  for (uint64_t w = chunk; w < width; w += 64) {
+    BITS_SET(piece, UINT64_C(0x0123456789ABCDEF) * (w + 1), 64);
+    BITS_OP(append, op1, op1, piece);
+    BITS_SET(piece, UINT64_C(0xFEDCBA9876543210) ^ w, 64);
+    BITS_OP(append, op2, op2, piece);
+  }
+  BITS_SET(piece, bench_mask(UINT64_C(0xA5A5A5A5A5A5A5A5), width / 2), width / 2);
+
+  INT_SET(start, (mach_int)(width / 4));
+  INT_SET(len, (mach_int)(width / 2));
+  INT_SET(hi, (mach_int)(width / 4 + width / 2 - 1));
+  INT_SET(lo, (mach_int)(width / 4));
+  INT_SET(times, (mach_int)(width / 8));
+
+  BENCH("add_bits", width, BITS_OP(add_bits, rop, op1, op2));
+  BENCH("eq_bits", width, g_sink += eq_bits(op1, op2));
+  BENCH("slice", width, BITS_OP(slice, rop, op1, start, len));
+  BENCH("vector_update_subrange_lbits", width, BITS_OP(vector_update_subrange_lbits, rop, op1, hi, lo, piece));
+
+  // A temporary that is created and killed on every iteration, as in
+  // a recursive function where allocations cannot be hoisted
+  BENCH("temporary_add_bits", width, {
+    BITS_DECL(tmp);
+    BITS_OP(add_bits, tmp, op1, op2);
+    g_sink += eq_bits(tmp, op1);
+    BITS_KILL(tmp);
+  });
+
+  BITS_SET(piece, 0xA5, 8);
+  BENCH("replicate_bits", width, BITS_OP(replicate_bits, rop, piece, times));
+
+#ifdef BENCH_SIGN_EXTEND
+  // A negative operand, so the sign bit has to be replicated
+  chunk = width / 2 < 64 ? width / 2 : 64;
+  BITS_SET(piece, bench_mask(UINT64_MAX, chunk), chunk);
+  for (uint64_t w = chunk; w < width / 2; w += 64) {
+    BITS_SET(rop, UINT64_MAX, 64);
+    BITS_OP(append, piece, piece, rop);
+  }
+  INT_SET(len, (mach_int)width);
+  BENCH("sign_extend", width, BITS_OP(sign_extend, rop, piece, len));
+#endif
+
+  BITS_KILL(op1);
+  BITS_KILL(op2);
+  BITS_KILL(piece);
+  BITS_KILL(rop);
+  INT_KILL(start);
+  INT_KILL(len);
+  INT_KILL(hi);
+  INT_KILL(lo);
+  INT_KILL(times);
+}
+
+static void bench_ints(const char *size, mach_int a, mach_int b)
+{
+  INT_DECL(op1);
+  INT_DECL(op2);
+  INT_DECL(rop);
+  char name[64];
+  uint64_t width = 64;
+
+  INT_SET(op1, a);
+  INT_SET(op2, b);
+
+#ifdef BENCH_BIG_INT
+  // The large first operand is just over 100 bits, so that products
+  // with the small second operand still fit in an int128
+  if (strcmp(size, "large") == 0) {
+    INT_OP(mult_int, op1, op1, op1);
+    width = 128;
+  }
+#endif
+
+  snprintf(name, sizeof(name), "add_int_%s", size);
+  BENCH(name, width, INT_OP(add_int, rop, op1, op2));
+  snprintf(name, sizeof(name), "sub_int_%s", size);
+  BENCH(name, width, INT_OP(sub_int, rop, op1, op2));
+  snprintf(name, sizeof(name), "mult_int_%s", size);
+  BENCH(name, width, INT_OP(mult_int, rop, op1, op2));
+  snprintf(name, sizeof(name), "tdiv_int_%s", size);
+  BENCH(name, width, INT_OP(tdiv_int, rop, op1, op2));
+  snprintf(name, sizeof(name), "lt_%s", size);
+  BENCH(name, width, g_sink += lt(op1, op2));
+
+  INT_KILL(op1);
+  INT_KILL(op2);
+  INT_KILL(rop);
+}
+
+#ifdef BENCH_RAM
+static void bench_ram(uint64_t bytes)
+{
+  INT_DECL(addr_size);
+  INT_DECL(data_size);
+  BITS_DECL(hex_ram);
+  BITS_DECL(addr);
+  BITS_DECL(data);
+  BITS_DECL(rop);
+
+  INT_SET(addr_size, 64);
+  INT_SET(data_size, (mach_int)bytes);
+  BITS_SET(hex_ram, 0, 1);
+  BITS_SET(addr, UINT64_C(0x80001000), 64);
+  BITS_SET(data, bench_mask(UINT64_C(0x0123456789ABCDEF), bytes * 8), bytes * 8);
+
+  BENCH("write_ram", bytes * 8, g_sink += write_ram(addr_size, data_size, hex_ram, addr, data));
+  BENCH("read_ram", bytes * 8, read_ram(&rop, addr_size, data_size, hex_ram, addr));
+
+  INT_KILL(addr_size);
+  INT_KILL(data_size);
+  BITS_KILL(hex_ram);
+  BITS_KILL(addr);
+  BITS_KILL(data);
+  BITS_KILL(rop);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+  if (argc > 1) g_filter = argv[1];
+
+  // Only the GMP runtime has library state to set up
+#if defined(BENCH_NOSTD)
+  static unsigned char arena[1 << 16];
+  sail_arena_init(arena, sizeof(arena));
+#elif !defined(BENCH_INT128)
+  setup_library();
+#endif
+
+  printf("{\n  \"runtime\": \"%s\",\n  \"results\": [", BENCH_RUNTIME);
+
+  static const uint64_t widths[] = {8, 32, 64, 128, 512};
+  for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+    if (widths[i] <= BENCH_MAX_WIDTH) bench_bits(widths[i]);
+  }
+
+  bench_ints("small", 123456, 789);
+#ifdef BENCH_BIG_INT
+  bench_ints("large", INT64_C(0x4000000000003), 789);
+#endif
+
+#ifdef BENCH_RAM
+  bench_ram(4);
+  bench_ram(8);
+#endif
+
+  printf("\n  ]\n}\n");
+  return 0;
+}
@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+"""Print the results of bench.c for several runtimes side by side.
+
+Times are in nanoseconds per operation. When a baseline runtime is
+given with --baseline, the other columns also show the speedup
+relative to it.
+"""
+
+import argparse
+import json
+import sys
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('results', nargs='+', help='JSON files written by bench.c')
+    parser.add_argument('--baseline', help='runtime to compare the others against')
+    args = parser.parse_args()
+
+    runtimes = []
+    times = {}
+    benchmarks = []
+    for file in args.results:
+        with open(file) as f:
+            data = json.load(f)
+        runtime = data['runtime']
+        runtimes.append(runtime)
+        for result in data['results']:
+            key = (result['name'], result['width'])
+            if key not in benchmarks:
+                benchmarks.append(key)
+            times[(runtime, key)] = result['ns_per_op']
+
+    if args.baseline is not None and args.baseline not in runtimes:
+        sys.exit('Unknown baseline runtime {}'.format(args.baseline))
+
+    width = max(len('{} ({})'.format(name, w)) for (name, w) in benchmarks)
+    column = max(16, max(len(r) for r in runtimes) + 2)
+    print('benchmark'.ljust(width) + ''.join(r.rjust(column) for r in runtimes))
+    for key in benchmarks:
+        row = '{} ({})'.format(*key).ljust(width)
+        base = times.get((args.baseline, key))
+        for runtime in runtimes:
+            t = times.get((runtime, key))
+            if t is None:
+                cell = '-'
+            elif base is None or runtime == args.baseline:
+                cell = '{:.1f}'.format(t)
+            else:
+                cell = '{:.1f} {:.2f}x'.format(t, base / t)
+            row += cell.rjust(column)
+        print(row)
+
+
+if __name__ == '__main__':
+    main()
@@ -26,6 +26,91 @@ def have_sailcov():
     except FileNotFoundError:
         return False
 
+# The kind and span of each line in an all branches file or a file of
+# taken branches, along with the hit count if the line has one.
+span_line = re.compile(r'^([BFT]) .*?("[^"]*", \d+, \d+, \d+, \d+)(?:, (\d+))?$')
+
+def read_spans(filename, counted=False):
+    spans = {}
+    with open(filename) as spans_file:
+        for line in spans_file:
+            match = span_line.match(line.strip())
+            if match is None or (counted and match.group(3) is None):
+                print('{}Failed{}: bad line in {}: {}'.format(color.FAIL, color.END, filename, line))
+                sys.exit(1)
+            kind, span, count = match.groups()
+            spans[(kind, span)] = spans.get((kind, span), 0) + (1 if count is None else int(count))
+    return spans
+
+# The generated code only passes ids to the coverage library, so check
+# they are turned back into spans from the all branches file.
+def check_taken_spans(basename):
+    all_spans = read_spans('{}.branches'.format(basename))
+    taken = read_spans('{}.taken'.format(basename))
+    functions = [span for (kind, span) in taken if kind == 'F']
+    if not taken or not set(taken) <= set(all_spans) or len(functions) != 1:
+        print('{}Failed{}: {}.taken does not match {}.branches'.format(color.FAIL, color.END, basename, basename))
+        sys.exit(1)
+
+def build_coverage(filename, name, sail_opts=''):
+    step('{} -no_warn -no_memo_z3 -c -c_include sail_coverage.h -c_coverage {}.branches {} {} -o {}'.format(sail, name, sail_opts, filename, name))
+    step('cc {}.c {}/lib/*.c {}/lib/coverage/libsail_coverage.a -lgmp -lz -lpthread -ldl -I {}/lib -o {}.bin'.format(name, sail_dir, sail_dir, sail_dir, name))
+
+# With -c_coverage_counts each line of the coverage file has a hit
+# count, and two runs appending to the same file are summed by sailcov.
+def test_counts(filename, basename):
+    name = '{}_counts'.format(basename)
+    build_coverage(filename, name, sail_opts='-c_coverage_counts')
+    step('./{}.bin -c {}.taken'.format(name, name))
+    step('./{}.bin -c {}.taken'.format(name, name))
+    taken = read_spans('{}.taken'.format(name), counted=True)
+    if set(taken.values()) != {2}:
+        print('{}Failed{}: unexpected counts in {}.taken: {}'.format(color.FAIL, color.END, name, taken))
+        sys.exit(1)
+    # Counts are reported in the same way as reached spans without --heat
+    step('{} --werror --all {}.branches --taken {}.taken --hottest 10 {} > {}.hottest'.format(sailcov, name, name, filename, name))
+    step('diff {}.html {}.expect'.format(basename, basename))
+    step('grep -Eq "^ +2 \\| function +\\| .* main$" {}.hottest'.format(name))
+    step('{} --werror --heat --prefix heat_ --all {}.branches --taken {}.taken {}'.format(sailcov, name, name, filename))
+    step('grep -q \'title="2 hits"\' heat_{}.html'.format(basename))
+    step('rm {}.c {}.taken {}.bin {}.branches {}.hottest heat_{}.html'.format(name, name, name, name, name, basename))
+
+# Write binary coverage files, with a %p in the name so each run gets
+# its own file, and check sailcov merge combines them. Merging should
+# OR together which locations were reached, or sum the hit counts.
+def test_binary(filename, basename):
+    name = '{}_binary'.format(basename)
+    build_coverage(filename, name)
+    for _ in range(2):
+        step('./{}.bin --coverage-binary {}.%p.cov'.format(name, name))
+    step('test $(ls {}.*.cov | wc -l) -eq 2'.format(name))
+    step('{} merge -o {}.cov {}.*.cov'.format(sailcov, name, name))
+    step('{} --werror --all {}.branches --taken {}.cov {}'.format(sailcov, name, name, filename))
+    step('diff {}.html {}.expect'.format(basename, basename))
+
+    sum_name = '{}_sum'.format(basename)
+    build_coverage(filename, sum_name, sail_opts='-c_coverage_counts')
+    for _ in range(3):
+        step('./{}.bin --coverage-binary {}.%p.cov'.format(sum_name, sum_name))
+    step('{} merge --sum -j 2 -o {}.cov {}.*.cov'.format(sailcov, sum_name, sum_name))
+    step('{} --werror --all {}.branches --taken {}.cov --hottest 10 {} > {}.hottest'.format(sailcov, sum_name, sum_name, filename, sum_name))
+    step('diff {}.html {}.expect'.format(basename, basename))
+    step('grep -Eq "^ +3 \\| function +\\| .* main$" {}.hottest'.format(sum_name))
+
+    # A file with a different span table hash must be rejected, both
+    # when merging and when reading it with an all branches file
+    with open('{}.cov'.format(name), 'rb') as cov:
+        data = bytearray(cov.read())
+    data[16] ^= 1
+    with open('{}_other.cov'.format(name), 'wb') as cov:
+        cov.write(data)
+    step('{} merge -o {}_merged.cov {}.cov {}_other.cov'.format(sailcov, name, name, name), expected_status=1)
+    step('{} --werror --all {}.branches --taken {}_other.cov {}'.format(sailcov, name, name, filename), expected_status=1)
+
+    for n in [name, sum_name]:
+        step('rm {}.c {}.bin {}.branches {}.*.cov {}.cov'.format(n, n, n, n, n))
+    step('rm {}_other.cov {}.hottest'.format(name, sum_name))
+
 def test_sailcov():
     banner('Testing sailcov')
     results = Results('sailcov')
@@ -38,20 +123,72 @@ def test_sailcov():
             basename = os.path.splitext(os.path.basename(filename))[0]
             tests[filename] = os.fork()
             if tests[filename] == 0:
-                step('{} -no_warn -no_memo_z3 -c -c_include sail_coverage.h -c_coverage {}.branches {} -o {}'.format(sail, basename, filename, basename))
-                step('cc {}.c {}/lib/*.c {}/lib/coverage/libsail_coverage.a -lgmp -lz -lpthread -ldl -I {}/lib -o {}.bin'.format(basename, sail_dir, sail_dir, sail_dir, basename))
+                build_coverage(filename, basename)
                 step('./{}.bin -c {}.taken'.format(basename, basename))
+                check_taken_spans(basename)
                 step('{} --werror --all {}.branches --taken {}.taken {}'.format(sailcov, basename, basename, filename))
                 step('diff {}.html {}.expect'.format(basename, basename))
                 step('rm {}.taken {}.bin {}.branches'.format(basename, basename, basename))
+                test_counts(filename, basename)
+                test_binary(filename, basename)
                 print_ok(filename)
                 sys.exit()
         results.collect(tests)
     return results.finish()
 
+# The lines of the definition of function in a generated C file, from
+# its header to the closing brace.
+def c_function(c_file, function):
+    with open(c_file) as c:
+        lines = c.read().splitlines()
+    header = re.compile(r'^(SAIL_\w+ )*(static )?.*\b{}\(.*\)$'.format(function))
+    for start, line in enumerate(lines):
+        if header.match(line):
+            return lines[start:lines.index('}', start) + 1]
+    print('{}Failed{}: no definition of {} in {}'.format(color.FAIL, color.END, function, c_file))
+    sys.exit(1)
+
+# Build profile/pgo.sail with hit counts, run it, and use the counts to
+# rebuild it with -c_profile. The result must not change, the hot case
+# of the match in decode should be tested first, and the functions
+# should be marked hot or cold.
+def test_profile():
+    banner('Testing -c_profile')
+    results = Results('profile')
+    if not os.path.exists('{}/lib/coverage/libsail_coverage.a'.format(sail_dir)):
+        print('Skipping because no coverage library found')
+        return results.finish()
+    tests = {}
+    tests['pgo'] = os.fork()
+    if tests['pgo'] == 0:
+        build_coverage('profile/pgo.sail', 'profile/pgo_counts', sail_opts='-c_coverage_counts')
+        step('./profile/pgo_counts.bin -c profile/pgo.taken > profile/pgo_counts.result')
+        step('diff profile/pgo_counts.result profile/pgo.expect')
+        step('{} -no_warn -no_memo_z3 -c -c_profile profile/pgo.taken profile/pgo.sail -o profile/pgo'.format(sail))
+        step('cc profile/pgo.c {}/lib/*.c -lgmp -lz -I {}/lib -o profile/pgo.bin'.format(sail_dir, sail_dir))
+        step('./profile/pgo.bin > profile/pgo.result')
+        step('diff profile/pgo.result profile/pgo.expect')
+        decode = c_function('profile/pgo.c', 'zdecode')
+        body = '\n'.join(decode[1:])
+        hot_case, first_case = body.find('UINT64_C(0xFF)'), body.find('UINT64_C(0x01)')
+        if not decode[0].startswith('SAIL_HOT ') or hot_case < 0 or first_case < 0 or hot_case > first_case:
+            print('{}Failed{}: decode was not optimised using the profile:\n{}'.format(color.FAIL, color.END, '\n'.join(decode)))
+            sys.exit(1)
+        unused = c_function('profile/pgo.c', 'zunused')
+        if not unused[0].startswith('SAIL_COLD '):
+            print('{}Failed{}: unused is not cold: {}'.format(color.FAIL, color.END, unused[0]))
+            sys.exit(1)
+        step('rm profile/pgo_counts.c profile/pgo_counts.bin profile/pgo_counts.branches profile/pgo_counts.result')
+        step('rm profile/pgo.taken profile/pgo.c profile/pgo.bin profile/pgo.result')
+        print_ok('pgo')
+        sys.exit()
+    results.collect(tests)
+    return results.finish()
+
 xml = '<testsuites>\n'
 
 xml += test_sailcov()
+xml += test_profile()
 
 xml += '</testsuites>\n'
 